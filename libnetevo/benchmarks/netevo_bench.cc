@@ -0,0 +1,450 @@
+/*===========================================================================
+ NetEvo Benchmarks
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ Microbenchmarks of the hot paths of NetEvo: evaluating the dynamics of a
+ System, each of the simulators, copying Systems, reading and writing GML,
+ calculating eigenvalues and full EvolveSA iterations. Each is run on small
+ world topologies (see System::smallWorldGraph) of several sizes and average
+ degrees generated from a fixed seed, so runs are reproducible.
+
+ Results are written as CSV (one line per benchmark, size and degree) giving
+ the median rate over several samples. Saving the results of a release and
+ passing them back with --baseline reports any benchmark that has become
+ slower by more than the tolerance and exits with status 1.
+
+ Usage: netevo_bench [--sizes 1000,10000] [--degrees 4,16] [--samples 5]
+                     [--min-time 0.2] [--max-dense 2000] [--only NAME]
+                     [--seed 1] [--output FILE] [--baseline FILE]
+                     [--tolerance 0.1]
+ ============================================================================*/
+
+#include <netevo.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+
+using namespace lemon;
+using namespace netevo;
+using namespace std;
+
+
+// ---------- Settings ----------
+
+struct bench_settings_t {
+   vector<int> sizes;
+   vector<int> degrees;
+   int         samples;
+   double      minTime;
+   int         maxDense;
+   string      only;
+   int         seed;
+   string      output;
+   string      baseline;
+   double      tolerance;
+};
+
+/** Result of one benchmark for a size and degree */
+struct bench_result_t {
+   string name;
+   int    nodes;
+   int    degree;
+   long   ops;
+   double seconds;
+   double rate;
+   string unit;
+};
+
+static vector<int> parseList (const char *s) {
+   vector<int> list;
+   stringstream in(s);
+   string item;
+   while (getline(in, item, ',')) { list.push_back(atoi(item.c_str())); }
+   return list;
+}
+
+static double now () {
+   return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// ---------- Timing ----------
+
+/** Operation timed by a benchmark. run performs the operation once and returns the number of
+ *  units of work done (e.g. RHS evaluations or iterations). */
+class BenchOp {
+public:
+   virtual ~BenchOp () { }
+   virtual long run () = 0;
+};
+
+/** Times an operation (after a warm up run) for samples of at least minTime seconds each and
+ *  keeps the median rate. */
+static bench_result_t measure (bench_settings_t &settings, string name, string unit, System &sys,
+                               int degree, BenchOp &op) {
+   bench_result_t result;
+   result.name = name;
+   result.nodes = sys.nodeCount();
+   result.degree = degree;
+   result.unit = unit;
+   result.ops = 0;
+   result.seconds = 0.0;
+
+   op.run();
+   vector<double> rates;
+   for (int s=0; s<settings.samples; ++s) {
+      long ops = 0;
+      double start = now(), elapsed = 0.0;
+      do {
+         ops += op.run();
+         elapsed = now() - start;
+      } while (elapsed < settings.minTime);
+      rates.push_back(ops / elapsed);
+      result.ops += ops;
+      result.seconds += elapsed;
+   }
+   sort(rates.begin(), rates.end());
+   result.rate = rates[rates.size() / 2];
+   return result;
+}
+
+
+// ---------- Benchmarks ----------
+
+/** Evaluations of System::operator() */
+class RhsOp : public BenchOp {
+   System &mSys;
+   State   mX, mDx;
+public:
+   RhsOp (System &sys, State &x) : mSys(sys), mX(x), mDx(x.size(), 0.0) { }
+   long run () {
+      for (int i=0; i<100; ++i) { mSys(mX, mDx, 0.0); }
+      return 100;
+   }
+};
+
+/** Simulations of a System from the same initial state */
+class SimulateOp : public BenchOp {
+   System   &mSys;
+   Simulate &mSim;
+   State     mInitial;
+   double    mTMax;
+public:
+   SimulateOp (System &sys, Simulate &sim, State &initial, double tMax)
+      : mSys(sys), mSim(sim), mInitial(initial), mTMax(tMax) { }
+   long run () {
+      State x(mInitial);
+      SimObserver obs;
+      ChangeLog logger;
+      mSim.simulate(mSys, mTMax, x, obs, logger);
+      return 1;
+   }
+};
+
+class CopyOp : public BenchOp {
+   System &mSys;
+   System  mCopy;
+public:
+   CopyOp (System &sys) : mSys(sys) { }
+   long run () {
+      mCopy.copySystem(mSys);
+      return 1;
+   }
+};
+
+class SaveGMLOp : public BenchOp {
+   System &mSys;
+   string  mFile;
+public:
+   SaveGMLOp (System &sys, string file) : mSys(sys), mFile(file) { }
+   long run () {
+      mSys.saveToGML(mFile);
+      return 1;
+   }
+};
+
+class OpenGMLOp : public BenchOp {
+   string       mFile;
+   NodeDynamic &mDyn;
+public:
+   OpenGMLOp (string file, NodeDynamic &dyn) : mFile(file), mDyn(dyn) { }
+   long run () {
+      System sys;
+      sys.addNodeDynamic(&mDyn);
+      sys.openFromGML(mFile);
+      return 1;
+   }
+};
+
+class EigenvaluesOp : public BenchOp {
+   System &mSys;
+public:
+   EigenvaluesOp (System &sys) : mSys(sys) { }
+   long run () {
+      mSys.eigenvalues(0);
+      return 1;
+   }
+};
+
+/** Moves one undirected edge to a random pair of unconnected nodes */
+class RewireMutate : public Mutate {
+public:
+   void mutate (System &sys, ChangeLog &logger) {
+      Random &R = sys.getRandom();
+      int ns = sys.nodeCount();
+      if (ns < 3 || sys.arcCount() == 0) { return; }
+      Arc e = sys.getArc(R[sys.arcCount()]);
+      Node a = sys.source(e), b = sys.target(e);
+      Arc back = findArc(sys, b, a);
+      sys.erase(e);
+      if (back != INVALID) { sys.erase(back); }
+      Node u, v;
+      do {
+         u = sys.getNode(R[ns]);
+         v = sys.getNode(R[ns]);
+      } while (u == v || findArc(sys, u, v) != INVALID);
+      sys.addEdge(u, v);
+   }
+};
+
+/** A single random initial phase for every node */
+class RandomPhases : public EvoInitialStates {
+   int mSeed;
+public:
+   RandomPhases (int seed) : mSeed(seed) { }
+   vector<State> initialStates (System &sys) {
+      Random R;
+      R.seed(mSeed);
+      State x(sys.totalStates());
+      for (size_t i=0; i<x.size(); ++i) { x[i] = R() * 6.283185307179586; }
+      return vector<State>(1, x);
+   }
+};
+
+/** Last iteration observed */
+class IterationCounter : public EvoObserver {
+public:
+   int last;
+   IterationCounter () : last(0) { }
+   void operator() (System &sys, double perf, int t) { last = t; }
+};
+
+/** Iterations of EvolveSA (simulating the Kuramoto order parameter for each trial) */
+class EvolveOp : public BenchOp {
+   System &mSys;
+   int     mSeed;
+public:
+   EvolveOp (System &sys, int seed) : mSys(sys), mSeed(seed) { }
+   long run () {
+      EvolveSAParams params;
+      params.rnd.seed(mSeed);
+      params.initialTrials = 10;
+      params.maxIterations = 100;
+      params.acceptRunsNoChange = 1000000;
+      params.minTemp = 0.0;
+      params.ensureWeaklyConnected = false;
+      params.simTMax = 1.0;
+      OrderParameterPerformance Q;
+      RewireMutate mut;
+      EvolveSA evo(params, Q, mut);
+      SimulateOdeFixed sim(RK_4, 0.05);
+      RandomPhases initial(mSeed);
+      IterationCounter obs;
+      ChangeLog logger;
+
+      // EvolveSA reports its initial trials on cout
+      streambuf *out = cout.rdbuf();
+      ostringstream discard;
+      cout.rdbuf(discard.rdbuf());
+      System *result = evo.evolve(mSys, sim, initial, obs, logger);
+      cout.rdbuf(out);
+      delete result;
+      return obs.last;
+   }
+};
+
+
+// ---------- Results ----------
+
+static void writeResults (ostream &out, vector<bench_result_t> &results) {
+   out << "benchmark,nodes,degree,ops,seconds,rate,unit" << endl;
+   for (size_t i=0; i<results.size(); ++i) {
+      bench_result_t &r = results[i];
+      out << r.name << "," << r.nodes << "," << r.degree << "," << r.ops << ","
+          << r.seconds << "," << r.rate << "," << r.unit << endl;
+   }
+}
+
+/** Compare with the results of an earlier run. Returns the number of regressions. */
+static int compareResults (bench_settings_t &settings, vector<bench_result_t> &results) {
+   ifstream in(settings.baseline.c_str());
+   if (!in.is_open()) {
+      cerr << "Could not open baseline " << settings.baseline << endl;
+      return 0;
+   }
+   map<string, double> base;
+   string line;
+   getline(in, line);
+   while (getline(in, line)) {
+      stringstream fields(line);
+      string name, nodes, degree, ops, seconds, rate;
+      getline(fields, name, ',');
+      getline(fields, nodes, ',');
+      getline(fields, degree, ',');
+      getline(fields, ops, ',');
+      getline(fields, seconds, ',');
+      getline(fields, rate, ',');
+      base[name + "," + nodes + "," + degree] = atof(rate.c_str());
+   }
+
+   int regressions = 0;
+   for (size_t i=0; i<results.size(); ++i) {
+      bench_result_t &r = results[i];
+      stringstream key;
+      key << r.name << "," << r.nodes << "," << r.degree;
+      map<string, double>::iterator b = base.find(key.str());
+      if (b == base.end() || b->second <= 0.0) { continue; }
+      double change = r.rate / b->second - 1.0;
+      if (change < -settings.tolerance) {
+         cerr << "REGRESSION " << key.str() << ": " << r.rate << " " << r.unit << " (baseline "
+              << b->second << ", " << (int)(change * 100.0) << "%)" << endl;
+         regressions++;
+      }
+   }
+   return regressions;
+}
+
+
+// ---------- Main ----------
+
+int main (int argc, char *argv[]) {
+
+   bench_settings_t settings;
+   settings.sizes = parseList("1000,10000");
+   settings.degrees = parseList("4,16");
+   settings.samples = 5;
+   settings.minTime = 0.2;
+   settings.maxDense = 2000;
+   settings.seed = 1;
+   settings.tolerance = 0.1;
+
+   for (int i=1; i<argc; ++i) {
+      string arg = argv[i];
+      bool hasValue = (i + 1 < argc);
+      if (arg == "--sizes" && hasValue)          { settings.sizes = parseList(argv[++i]); }
+      else if (arg == "--degrees" && hasValue)   { settings.degrees = parseList(argv[++i]); }
+      else if (arg == "--samples" && hasValue)   { settings.samples = max(1, atoi(argv[++i])); }
+      else if (arg == "--min-time" && hasValue)  { settings.minTime = atof(argv[++i]); }
+      else if (arg == "--max-dense" && hasValue) { settings.maxDense = atoi(argv[++i]); }
+      else if (arg == "--only" && hasValue)      { settings.only = argv[++i]; }
+      else if (arg == "--seed" && hasValue)      { settings.seed = atoi(argv[++i]); }
+      else if (arg == "--output" && hasValue)    { settings.output = argv[++i]; }
+      else if (arg == "--baseline" && hasValue)  { settings.baseline = argv[++i]; }
+      else if (arg == "--tolerance" && hasValue) { settings.tolerance = atof(argv[++i]); }
+      else {
+         cerr << "Unknown option " << arg << " (see the top of netevo_bench.cc)" << endl;
+         return 2;
+      }
+   }
+
+   KuramotoOscillator kuramoto;
+   KuramotoMap kuramotoMap;
+   vector<bench_result_t> results;
+   string gmlFile = "netevo_bench.gml";
+
+   for (size_t s=0; s<settings.sizes.size(); ++s) {
+      for (size_t d=0; d<settings.degrees.size(); ++d) {
+         int n = settings.sizes[s], degree = settings.degrees[d];
+
+         // Reproducible topology with Kuramoto oscillators at every node
+         System sys;
+         sys.addNodeDynamic(&kuramoto);
+         sys.addNodeDynamic(&kuramotoMap);
+         sys.seedRnd(settings.seed);
+         sys.smallWorldGraph(n, max(degree / 2, 1), 0.1, "KuramotoOscillator", "NoArcDynamic", true);
+
+         State x(sys.totalStates());
+         Random R;
+         R.seed(settings.seed);
+         for (size_t i=0; i<x.size(); ++i) { x[i] = R() * 6.283185307179586; }
+
+         // Benchmarks (name, unit and operation)
+         vector< pair<string, string> > names;
+         vector<BenchOp *> ops;
+         vector<bool> compiled;
+
+         RhsOp rhs(sys, x);
+         names.push_back(make_pair("rhs", "evals/s")); ops.push_back(&rhs); compiled.push_back(false);
+         names.push_back(make_pair("rhs_compiled", "evals/s")); ops.push_back(&rhs); compiled.push_back(true);
+
+         SimulateOdeFixed rk4(RK_4, 0.01), abm(ADAM_BASH_MOUL, 0.01);
+         SimulateOdeConst rkck(RK_CASH_KARP_54, 1e-6, 1e-6, 0.1), dopri(RK_DOPRI_5, 1e-6, 1e-6, 0.1);
+         SimulateOdeAdaptive adaptive(RK_DOPRI_5, 1e-6, 1e-6, 0.01);
+         SimulateOdeDense dense(1e-6, 1e-6, 0.01);
+         SimulateOp simRk4(sys, rk4, x, 1.0), simAbm(sys, abm, x, 1.0), simRkck(sys, rkck, x, 1.0),
+                    simDopri(sys, dopri, x, 1.0), simAdaptive(sys, adaptive, x, 1.0),
+                    simDense(sys, dense, x, 1.0);
+         names.push_back(make_pair("ode_fixed_rk4", "sims/s")); ops.push_back(&simRk4); compiled.push_back(true);
+         names.push_back(make_pair("ode_fixed_abm", "sims/s")); ops.push_back(&simAbm); compiled.push_back(true);
+         names.push_back(make_pair("ode_const_rkck54", "sims/s")); ops.push_back(&simRkck); compiled.push_back(true);
+         names.push_back(make_pair("ode_const_dopri5", "sims/s")); ops.push_back(&simDopri); compiled.push_back(true);
+         names.push_back(make_pair("ode_adaptive_dopri5", "sims/s")); ops.push_back(&simAdaptive); compiled.push_back(true);
+         names.push_back(make_pair("ode_dense_dopri5", "sims/s")); ops.push_back(&simDense); compiled.push_back(true);
+
+         System mapSys;
+         mapSys.copySystem(sys);
+         for (System::NodeIt v(mapSys); v != INVALID; ++v) {
+            mapSys.nodeData(v).dynamic = &kuramotoMap;
+         }
+         SimulateMap mapSim;
+         SimulateOp simMap(mapSys, mapSim, x, 100.0);
+         names.push_back(make_pair("map", "sims/s")); ops.push_back(&simMap); compiled.push_back(false);
+
+         CopyOp copy(sys);
+         names.push_back(make_pair("copy_system", "copies/s")); ops.push_back(&copy); compiled.push_back(false);
+
+         SaveGMLOp saveGML(sys, gmlFile);
+         OpenGMLOp openGML(gmlFile, kuramoto);
+         names.push_back(make_pair("gml_save", "files/s")); ops.push_back(&saveGML); compiled.push_back(false);
+         names.push_back(make_pair("gml_open", "files/s")); ops.push_back(&openGML); compiled.push_back(false);
+
+         EigenvaluesOp eigen(sys);
+         if (n <= settings.maxDense) {
+            names.push_back(make_pair("eigenvalues", "solves/s")); ops.push_back(&eigen); compiled.push_back(false);
+         }
+
+         EvolveOp evolve(sys, settings.seed);
+         names.push_back(make_pair("evolve_sa", "iters/s")); ops.push_back(&evolve); compiled.push_back(false);
+
+         for (size_t b=0; b<ops.size(); ++b) {
+            if (!settings.only.empty() && names[b].first != settings.only) { continue; }
+            if (compiled[b]) { sys.compile(); }
+            else { sys.uncompile(); }
+            results.push_back(measure(settings, names[b].first, names[b].second, sys, degree, *ops[b]));
+            cerr << names[b].first << " n=" << n << " k=" << degree << ": "
+                 << results.back().rate << " " << names[b].second << endl;
+         }
+         sys.uncompile();
+      }
+   }
+   remove(gmlFile.c_str());
+
+   // Write the results (to stdout unless a file is given)
+   if (settings.output.empty()) {
+      writeResults(cout, results);
+   }
+   else {
+      ofstream out(settings.output.c_str());
+      writeResults(out, results);
+   }
+
+   if (!settings.baseline.empty() && compareResults(settings, results) > 0) {
+      return 1;
+   }
+   return 0;
+}
@@ -11,16 +11,16 @@ LD_LIBRARY_PATH="-L /Users/Tom/Development/Library/lib"
 ################################################
 
 # SYSTEM RELATED FUNCTIONS
-#g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve.cc ../netevo/gml.cc ../netevo/simulate.cc ../netevo/system.cc systems.cc -o systems -lemon
+#g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve_islands.cc ../netevo/evolve.cc ../netevo/fitness_cache.cc ../netevo/profile.cc ../netevo/performance.cc ../netevo/gml.cc ../netevo/gml_fast.cc ../netevo/simulate.cc ../netevo/device.cc ../netevo/stiff.cc ../netevo/mapped_file.cc ../netevo/trajectory.cc ../netevo/system.cc ../netevo/changelog_async.cc ../netevo/snapshot.cc ../netevo/compiled.cc ../netevo/ensemble.cc ../netevo/dynamics.cc ../netevo/spectral.cc systems.cc -o systems -lemon -pthread
 
 # SIMULATE NEWORK OF MAPPINGS
-#g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve.cc ../netevo/gml.cc ../netevo/simulate.cc ../netevo/system.cc simulate_map.cc -o simulate_map -lemon
+#g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve_islands.cc ../netevo/evolve.cc ../netevo/fitness_cache.cc ../netevo/profile.cc ../netevo/performance.cc ../netevo/gml.cc ../netevo/gml_fast.cc ../netevo/simulate.cc ../netevo/device.cc ../netevo/stiff.cc ../netevo/mapped_file.cc ../netevo/trajectory.cc ../netevo/system.cc ../netevo/changelog_async.cc ../netevo/snapshot.cc ../netevo/compiled.cc ../netevo/ensemble.cc ../netevo/dynamics.cc ../netevo/spectral.cc simulate_map.cc -o simulate_map -lemon -pthread
 
 # SIMULATE NETWORK OF ODES
-#g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve.cc ../netevo/gml.cc ../netevo/simulate.cc ../netevo/system.cc simulate_ode.cc -o simulate_ode -lemon
+#g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve_islands.cc ../netevo/evolve.cc ../netevo/fitness_cache.cc ../netevo/profile.cc ../netevo/performance.cc ../netevo/gml.cc ../netevo/gml_fast.cc ../netevo/simulate.cc ../netevo/device.cc ../netevo/stiff.cc ../netevo/mapped_file.cc ../netevo/trajectory.cc ../netevo/system.cc ../netevo/changelog_async.cc ../netevo/snapshot.cc ../netevo/compiled.cc ../netevo/ensemble.cc ../netevo/dynamics.cc ../netevo/spectral.cc simulate_ode.cc -o simulate_ode -lemon -pthread
 
 # EVOLVE SIMULATED ANNEALING - TOPOLOGY
-#g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve.cc ../netevo/gml.cc ../netevo/simulate.cc ../netevo/system.cc evolve_sa_top.cc -o evolve_sa_top -lemon
+#g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve_islands.cc ../netevo/evolve.cc ../netevo/fitness_cache.cc ../netevo/profile.cc ../netevo/performance.cc ../netevo/gml.cc ../netevo/gml_fast.cc ../netevo/simulate.cc ../netevo/device.cc ../netevo/stiff.cc ../netevo/mapped_file.cc ../netevo/trajectory.cc ../netevo/system.cc ../netevo/changelog_async.cc ../netevo/snapshot.cc ../netevo/compiled.cc ../netevo/ensemble.cc ../netevo/dynamics.cc ../netevo/spectral.cc evolve_sa_top.cc -o evolve_sa_top -lemon -pthread
 
 # EVOLVE SIMULATED ANNEALING - DYNAMICS
-g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve.cc ../netevo/gml.cc ../netevo/simulate.cc ../netevo/system.cc evolve_sa_dyn.cc -o evolve_sa_dyn -lemon
+g++ $CXXFLAGS $LD_LIBRARY_PATH ../netevo/evolve_sa.cc ../netevo/evolve_islands.cc ../netevo/evolve.cc ../netevo/fitness_cache.cc ../netevo/profile.cc ../netevo/performance.cc ../netevo/gml.cc ../netevo/gml_fast.cc ../netevo/simulate.cc ../netevo/device.cc ../netevo/stiff.cc ../netevo/mapped_file.cc ../netevo/trajectory.cc ../netevo/system.cc ../netevo/changelog_async.cc ../netevo/snapshot.cc ../netevo/compiled.cc ../netevo/ensemble.cc ../netevo/dynamics.cc ../netevo/spectral.cc evolve_sa_dyn.cc -o evolve_sa_dyn -lemon -pthread
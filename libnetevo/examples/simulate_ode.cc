@@ -132,6 +132,7 @@ int main () {
    //SimulateOdeFixed simOdeFixed = SimulateOdeFixed(RK_4, 0.01); // Fixed Step
    //SimulateOdeAdaptive simOdeAdaptive = SimulateOdeAdaptive(RK_CASH_KARP_54, 10e-6, 10e-6, 0.1); // Adaptive Step
    SimulateOdeConst simOdeConst = SimulateOdeConst(RK_CASH_KARP_54, 10e-6, 10e-6, 1.0); // Adaptive Step with Fixed Output
+   //SimulateOdeDense simOdeDense = SimulateOdeDense(10e-6, 10e-6, 0.1); // Adaptive Step with Dense Output
    
    // To observe the simulated output on the screen we use in built in streaming observer.
    // We will use this for the fixed and adpative simulators.
@@ -143,15 +144,20 @@ int main () {
    vector<State>  xOut;
    SimObserverToVectors vectorObserver(xOut, tOut);
    
+   // The dense output simulator passes whole steps to the observer, these can be sampled at 
+   // fixed times (without simulating again) to fill the vectors
+   //SimObserverResample denseObserver(vectorObserver, 1.0);
+   
    // We don't need to log changes so use the default change logger that does nothing
    ChangeLog nullLogger;
    
    
    // ---------- Simulate the Dynamics ----------
 
-   // Simulate the system. The following 3 lines show the different available simulators. (Uncomment one)
+   // Simulate the system. The following 4 lines show the different available simulators. (Uncomment one)
    // simOdeFixed.simulate(sys, 20.0, initial, vectorObserver, nullLogger);
    // simOdeAdaptive.simulate(sys, 20.0, initial, vectorObserver, nullLogger);
+   // simOdeDense.simulate(sys, 20.0, initial, denseObserver, nullLogger);
    simOdeConst.simulate(sys, 20.0, initial, vectorObserver, nullLogger);
    
    // Print the dynamics to the screen
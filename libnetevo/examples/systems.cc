@@ -72,6 +72,14 @@ int main () {
    cout << "Directed graph has " << countArcs(sysRandomDirected) << ", and Undirected graph has "
         << countArcs(sysRandomUndirected) << endl;
    
+   // Small world and scale free topologies can also be generated. These (and 
+   // randomGraph) take time proportional to the size of the graph and can use 
+   // several threads, so large graphs are quick to make.
+   System sysSmallWorld;
+   sysSmallWorld.smallWorldGraph(1000, 2, 0.1, true);
+   System sysScaleFree;
+   sysScaleFree.scaleFreeGraph(1000, 2, true);
+   
    // It is also possible to load a topology from an external GML file. This
    // will set all node and arc dynamics to none if they are not specified in
    // the file. This enables integration with other graph based tools/libraries.
@@ -0,0 +1,309 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "changelog_async.h"
+#include "profile.h"
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+
+namespace netevo {
+   
+   ChangeLogAsync::ChangeLogAsync (ostream &outStream, bool binary, size_t queueBytes, async_full_e full) 
+      : mOut(outStream), mBinary(binary), mFull(full), mHead(0), mTail(0), mDropped(0), mStop(false), 
+        mWritten(0) {
+      // Round the queue up to a power of two so that positions wrap with a mask
+      size_t size = 1024;
+      while (size < queueBytes) { size <<= 1; }
+      mQueue.resize(size);
+      mMask = size - 1;
+      mWriter = thread(&ChangeLogAsync::run, this);
+   }
+   
+   // ---------- Producer (calling thread) ----------
+   
+   void ChangeLogAsync::put (const void *data, size_t bytes) {
+      size_t n = mStage.size();
+      mStage.resize(n + bytes);
+      memcpy(&mStage[n], data, bytes);
+   }
+   
+   void ChangeLogAsync::putKeys (System &sys) {
+      // Arcs keys are only needed when the arcs have states
+      int i, nodes = sys.nodeCount(), arcs = (sys.arcStates() > 0) ? sys.arcCount() : 0;
+      mKeysNow.resize(4 + nodes + 2 * arcs);
+      mKeysNow[0] = sys.nodeStates();
+      mKeysNow[1] = nodes;
+      mKeysNow[2] = sys.arcStates();
+      mKeysNow[3] = arcs;
+      for (i=0; i<nodes; ++i) {
+         mKeysNow[4 + i] = sys.nodeData(sys.getNode(i)).key;
+      }
+      for (i=0; i<arcs; ++i) {
+         Arc e = sys.getArc(i);
+         mKeysNow[4 + nodes + 2 * i] = sys.nodeData(sys.source(e)).key;
+         mKeysNow[5 + nodes + 2 * i] = sys.nodeData(sys.target(e)).key;
+      }
+      // Only send the keys when they change
+      if (mKeysNow != mKeys) {
+         putByte(ASYNC_KEYS);
+         put(&mKeysNow[0], mKeysNow.size() * sizeof(int32_t));
+         mKeys.swap(mKeysNow);
+      }
+   }
+   
+   void ChangeLogAsync::addNode (System &sys, Node n) {
+      putByte(ASYNC_NODE_ADD);
+      putInt(sys.nodeData(n).key);
+   }
+   
+   void ChangeLogAsync::addArc (System &sys, Node source, Node target) {
+      putByte(ASYNC_ARC_ADD);
+      putInt(sys.nodeData(source).key);
+      putInt(sys.nodeData(target).key);
+   }
+   
+   void ChangeLogAsync::erase (System &sys, Node n) {
+      putByte(ASYNC_NODE_ERASE);
+      putInt(sys.nodeData(n).key);
+   }
+   
+   void ChangeLogAsync::erase (System &sys, Arc e) {
+      putByte(ASYNC_ARC_ERASE);
+      putInt(sys.nodeData(sys.source(e)).key);
+      putInt(sys.nodeData(sys.target(e)).key);
+   }
+   
+   void ChangeLogAsync::update (System &sys, Node n) {
+      putByte(ASYNC_NODE_UPDATE);
+      putInt(sys.nodeData(n).key);
+   }
+   
+   void ChangeLogAsync::update (System &sys, Arc e) {
+      putByte(ASYNC_ARC_UPDATE);
+      putInt(sys.nodeData(sys.source(e)).key);
+      putInt(sys.nodeData(sys.target(e)).key);
+   }
+   
+   void ChangeLogAsync::newState (System &sys, const State &newState) {
+      putKeys(sys);
+      putByte(ASYNC_STATE);
+      putInt(newState.size());
+      if (!newState.empty()) { put(&newState[0], newState.size() * sizeof(double)); }
+   }
+   
+   void ChangeLogAsync::endStep (step_type_e stepType) {
+      putByte(ASYNC_END_STEP);
+      putInt(stepType);
+   }
+   
+   void ChangeLogAsync::rollback () {
+      mStage.clear();
+      // Keys sent in the discarded transaction never reach the writer
+      mKeys.clear();
+   }
+   
+   void ChangeLogAsync::commit () {
+      if (mStage.empty()) { return; }
+      if (mStop) {
+         // Closed, so the changes are ignored (and must not build up in the staging buffer)
+         rollback();
+         return;
+      }
+      uint32_t bytes = mStage.size();
+      size_t total = bytes + sizeof(uint32_t), size = mQueue.size();
+      size_t head = mHead.load(memory_order_relaxed);
+      
+      if (total > size) {
+         cerr << "Transaction larger than the queue, dropped (ChangeLogAsync::commit)" << endl;
+         mDropped++;
+         rollback();
+         return;
+      }
+      
+      // Wait for (or give up on) space in the queue
+      int spins = 0;
+      while (size - (head - mTail.load(memory_order_acquire)) < total) {
+         if (mFull == ASYNC_DROP) {
+            mDropped++;
+            rollback();
+            return;
+         }
+         mWake.notify_one();
+         if (++spins < 64) { this_thread::yield(); }
+         else { this_thread::sleep_for(chrono::microseconds(50)); }
+      }
+      
+      // Copy the length and records in (wrapping around the end of the queue)
+      const char *src[2] = { (const char *)&bytes, &mStage[0] };
+      size_t len[2] = { sizeof(uint32_t), bytes };
+      for (int k=0; k<2; ++k) {
+         size_t pos = head & mMask, first = min(len[k], size - pos);
+         memcpy(&mQueue[pos], src[k], first);
+         memcpy(&mQueue[0], src[k] + first, len[k] - first);
+         head += len[k];
+      }
+      mHead.store(head, memory_order_release);
+      mStage.clear();
+      mWake.notify_one();
+   }
+   
+   void ChangeLogAsync::flush () {
+      size_t head = mHead.load(memory_order_relaxed);
+      mWake.notify_one();
+      while (mWritten.load(memory_order_acquire) < head && mWriter.joinable()) {
+         this_thread::sleep_for(chrono::microseconds(50));
+      }
+   }
+   
+   void ChangeLogAsync::close () {
+      if (!mWriter.joinable()) { return; }
+      mStop = true;
+      mWake.notify_one();
+      mWriter.join();
+   }
+   
+   // ---------- Writer thread ----------
+   
+   void ChangeLogAsync::run () {
+      size_t head, tail, size = mQueue.size();
+      for (;;) {
+         head = mHead.load(memory_order_acquire);
+         tail = mTail.load(memory_order_relaxed);
+         if (head == tail) {
+            // Nothing to do, so flush and wait (stopping once the queue is drained)
+            mOut.flush();
+            mWritten.store(tail, memory_order_release);
+            if (mStop) { break; }
+            unique_lock<mutex> lock(mWakeLock);
+            mWake.wait_for(lock, chrono::milliseconds(1));
+            continue;
+         }
+         
+         // Take everything in the queue at once, freeing the space before encoding it
+         mBatch.resize(head - tail);
+         size_t pos = tail & mMask, first = min(head - tail, size - pos);
+         memcpy(&mBatch[0], &mQueue[pos], first);
+         memcpy(&mBatch[first], &mQueue[0], (head - tail) - first);
+         mTail.store(head, memory_order_release);
+         
+         write(&mBatch[0], mBatch.size());
+      }
+   }
+   
+   void ChangeLogAsync::write (const char *data, size_t bytes) {
+      if (mBinary) {
+         mOut.write(data, bytes);
+         NE_PROFILE_COUNT(PROF_BYTES_LOGGED, bytes);
+         return;
+      }
+      
+      // Decode each transaction into the same text as ChangeLogToStream
+      const char *p = data, *end = data + bytes, *tEnd;
+      char num[32];
+      int32_t a, b, n, i, j;
+      uint32_t len;
+      mText.clear();
+      while (p < end) {
+         memcpy(&len, p, sizeof(uint32_t));
+         p += sizeof(uint32_t);
+         tEnd = p + len;
+         while (p < tEnd) {
+            char type = *p++;
+            switch (type) {
+               case ASYNC_NODE_ADD:
+               case ASYNC_NODE_ERASE:
+               case ASYNC_NODE_UPDATE:
+                  memcpy(&a, p, 4); p += 4;
+                  mText += (type == ASYNC_NODE_ADD) ? "N+," : (type == ASYNC_NODE_ERASE) ? "N-," : "NU,";
+                  snprintf(num, 32, "%d\n", a);
+                  mText += num;
+                  break;
+               case ASYNC_ARC_ADD:
+               case ASYNC_ARC_ERASE:
+               case ASYNC_ARC_UPDATE:
+                  memcpy(&a, p, 4); p += 4;
+                  memcpy(&b, p, 4); p += 4;
+                  mText += (type == ASYNC_ARC_ADD) ? "E+," : (type == ASYNC_ARC_ERASE) ? "E-," : "EU,";
+                  snprintf(num, 32, "%d,%d\n", a, b);
+                  mText += num;
+                  break;
+               case ASYNC_KEYS:
+                  memcpy(&a, p + 4, 4);
+                  memcpy(&b, p + 12, 4);
+                  mOutKeys.resize(4 + a + 2 * b);
+                  memcpy(&mOutKeys[0], p, mOutKeys.size() * 4);
+                  p += mOutKeys.size() * 4;
+                  break;
+               case ASYNC_STATE: {
+                  memcpy(&n, p, 4); p += 4;
+                  const char *x = p;
+                  p += (size_t)n * sizeof(double);
+                  if (mOutKeys.size() < 4) { break; }
+                  int ns = mOutKeys[0], nodes = mOutKeys[1], as = mOutKeys[2], arcs = mOutKeys[3];
+                  if (n < nodes * ns + arcs * as) { break; }
+                  double v;
+                  if (ns > 0) {
+                     for (i=0; i<nodes; ++i) {
+                        snprintf(num, 32, "NS,%d", mOutKeys[4 + i]);
+                        mText += num;
+                        for (j=0; j<ns; ++j) {
+                           memcpy(&v, x + ((size_t)i * ns + j) * sizeof(double), sizeof(double));
+                           snprintf(num, 32, ",%g", v);
+                           mText += num;
+                        }
+                        mText += '\n';
+                     }
+                  }
+                  if (as > 0) {
+                     for (i=0; i<arcs; ++i) {
+                        snprintf(num, 32, "ES,%d,%d", mOutKeys[4 + nodes + 2 * i], mOutKeys[5 + nodes + 2 * i]);
+                        mText += num;
+                        for (j=0; j<as; ++j) {
+                           memcpy(&v, x + ((size_t)nodes * ns + (size_t)i * as + j) * sizeof(double), sizeof(double));
+                           snprintf(num, 32, ",%g", v);
+                           mText += num;
+                        }
+                        mText += '\n';
+                     }
+                  }
+                  break;
+               }
+               case ASYNC_END_STEP:
+                  memcpy(&a, p, 4); p += 4;
+                  mText += (a == INIT_STEP) ? "---\n" : (a == SIM_STEP) ? "-\n" : (a == EVO_STEP) ? "--\n" : "";
+                  break;
+               default:
+                  // Unknown record, skip the rest of the transaction
+                  p = tEnd;
+                  break;
+            }
+         }
+      }
+      mOut.write(mText.data(), mText.size());
+      NE_PROFILE_COUNT(PROF_BYTES_LOGGED, mText.size());
+   }
+   
+} // netevo namespace
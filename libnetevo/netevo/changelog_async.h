@@ -0,0 +1,141 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_CHANGELOG_ASYNC_H
+#define NE_CHANGELOG_ASYNC_H
+
+#include "system.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+using namespace std;
+
+namespace netevo {
+   
+   /** What a ChangeLogAsync does when its queue is full. */
+   enum async_full_e {
+      ASYNC_BLOCK = 0, /** Wait for the writer thread to make space */
+      ASYNC_DROP  = 1  /** Drop the transaction (counted by dropped) */
+   };
+   
+   /** Record types written by ChangeLogAsync. */
+   enum async_record_e {
+      ASYNC_NODE_ADD    = 1,
+      ASYNC_ARC_ADD     = 2,
+      ASYNC_NODE_ERASE  = 3,
+      ASYNC_ARC_ERASE   = 4,
+      ASYNC_NODE_UPDATE = 5,
+      ASYNC_ARC_UPDATE  = 6,
+      ASYNC_KEYS        = 7,
+      ASYNC_STATE       = 8,
+      ASYNC_END_STEP    = 9
+   };
+   
+   /** ChangeLog that moves the cost of logging off the calling thread. Changes are copied as 
+    *  compact binary records into a staging buffer and on commit the transaction is pushed onto a 
+    *  lock-free single producer, single consumer queue (rollback discards it). A background 
+    *  thread takes everything in the queue at once and writes it to the stream, either as the 
+    *  same text lines as ChangeLogToStream (though nodes and arcs are listed in ID order) or as 
+    *  the raw records. When the queue is full the caller either waits or drops the transaction.
+    *  
+    *  Each record is a one byte async_record_e followed by its fields (int32 node keys, an int32 
+    *  step type or the record contents below). A state only holds the values (an int32 count then 
+    *  doubles). The keys of the nodes and arcs they belong to are sent in an ASYNC_KEYS record 
+    *  (int32 node states, nodes, arc states, arcs, then the node keys and source and target keys 
+    *  of each arc, in ID order, arcs only being included if they have states) only when they 
+    *  change. Each transaction starts with its length as a uint32.
+    *  
+    *  All calls must be made from a single thread. */
+   class ChangeLogAsync : public ChangeLog {
+   private:
+      ostream              &mOut;
+      bool                  mBinary;
+      async_full_e          mFull;
+      
+      // Queue (a power of two bytes, indexed by free running counters)
+      vector<char>          mQueue;
+      size_t                mMask;
+      atomic<size_t>        mHead;
+      atomic<size_t>        mTail;
+      atomic<long>          mDropped;
+      
+      // Producer side
+      vector<char>          mStage;
+      vector<int>           mKeys;
+      vector<int>           mKeysNow;
+      
+      // Writer thread
+      thread                mWriter;
+      atomic<bool>          mStop;
+      atomic<size_t>        mWritten;
+      mutex                 mWakeLock;
+      condition_variable    mWake;
+      vector<char>          mBatch;
+      string                mText;
+      vector<int>           mOutKeys;
+      
+      ChangeLogAsync (const ChangeLogAsync &from);
+      ChangeLogAsync & operator= (const ChangeLogAsync &from);
+      
+      void put (const void *data, size_t bytes);
+      void putByte (char c) { mStage.push_back(c); }
+      void putInt (int i) { put(&i, sizeof(int32_t)); }
+      void putKeys (System &sys);
+      
+      void run ();
+      void write (const char *data, size_t bytes);
+      
+   public:
+      /** Log to a stream using a queue of at least queueBytes. The stream must not be used by 
+       *  anything else until the log is closed. */
+      ChangeLogAsync (ostream &outStream, bool binary = false, size_t queueBytes = (1 << 22), 
+                      async_full_e full = ASYNC_BLOCK);
+      ~ChangeLogAsync () { close(); }
+      
+      /** Wait until everything committed so far has been written and the stream flushed. */
+      void flush ();
+      /** Write everything committed and stop the writer thread (further changes are ignored). */
+      void close ();
+      /** Number of transactions dropped because the queue was full (ASYNC_DROP only). */
+      long dropped () { return mDropped; }
+      
+      void addNode  (System &sys, Node n);
+      void addArc   (System &sys, Node source, Node target);
+      void erase    (System &sys, Node n);
+      void erase    (System &sys, Arc e);
+      
+      void update   (System &sys, Node n);
+      void update   (System &sys, Arc e);
+      
+      void newState (System &sys, const State &newState);
+      
+      void endStep  (step_type_e stepType);
+      
+      void rollback ();
+      void commit   ();
+   };
+   
+} // netevo namespace
+
+#endif // NE_CHANGELOG_ASYNC_H
@@ -0,0 +1,210 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "compiled.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace netevo {
+   
+   void ParamStore::set (int id, int slot, double value) {
+      if (slot >= mSlots) {
+         // Columns are contiguous so any new slots are simply appended
+         mData.resize((slot + 1) * mSize, 0.0);
+         mSlots = slot + 1;
+      }
+      mData[slot*mSize + id] = value;
+   }
+   
+   void CompiledSystem::compile (System &sys) {
+      int i, j, k, r;
+      
+      nodes = countNodes(sys);
+      arcs = countArcs(sys);
+      nodeStates = sys.nodeStates();
+      arcStates = sys.arcStates();
+      
+      // Node and arc handles in ID order
+      node.resize(nodes);
+      for (System::NodeIt v(sys); v != INVALID; ++v) {
+         node[sys.nodeID(v)] = v;
+      }
+      arc.resize(arcs);
+      for (System::ArcIt e(sys); e != INVALID; ++e) {
+         arc[sys.arcID(e)] = e;
+      }
+      
+      // In-arcs of each node (keeping the InArcIt order)
+      inOffset.resize(nodes + 1);
+      inSource.resize(arcs);
+      inArcState.resize(arcs);
+      inWeight.resize(arcs);
+      k = 0;
+      for (i=0; i<nodes; ++i) {
+         inOffset[i] = k;
+         for (System::InArcIt e(sys, node[i]); e != INVALID; ++e) {
+            inSource[k] = nodeStateID(sys.nodeID(sys.source(e)));
+            inArcState[k] = arcStateID(sys.arcID(e));
+            inWeight[k] = sys.arcData(e).weight;
+            ++k;
+         }
+      }
+      inOffset[nodes] = k;
+      
+      // Arc end points and weights
+      arcSource.resize(arcs);
+      arcTarget.resize(arcs);
+      arcWeight.resize(arcs);
+      for (j=0; j<arcs; ++j) {
+         arcSource[j] = nodeStateID(sys.nodeID(sys.source(arc[j])));
+         arcTarget[j] = nodeStateID(sys.nodeID(sys.target(arc[j])));
+         arcWeight[j] = sys.arcData(arc[j]).weight;
+      }
+      
+      // Store the dynamic parameters as columns
+      int slots = 0;
+      for (i=0; i<nodes; ++i) {
+         int n = sys.nodeData(node[i]).dynamicParams.size();
+         if (n > slots) { slots = n; }
+      }
+      nodeParams.reset(nodes, slots);
+      for (i=0; i<nodes; ++i) {
+         vector<double> &params = sys.nodeData(node[i]).dynamicParams;
+         for (k=0; k<(int)params.size(); ++k) { nodeParams.column(k)[i] = params[k]; }
+      }
+      slots = 0;
+      for (j=0; j<arcs; ++j) {
+         int n = sys.arcData(arc[j]).dynamicParams.size();
+         if (n > slots) { slots = n; }
+      }
+      arcParams.reset(arcs, slots);
+      for (j=0; j<arcs; ++j) {
+         vector<double> &params = sys.arcData(arc[j]).dynamicParams;
+         for (k=0; k<(int)params.size(); ++k) { arcParams.column(k)[j] = params[k]; }
+      }
+      
+      // Group consecutive IDs with the same dynamics
+      nodeRuns.clear();
+      for (i=0; i<nodes; ++i) {
+         NodeDynamic *dyn = sys.nodeData(node[i]).dynamic;
+         if (nodeRuns.empty() || nodeRuns.back().dynamic != dyn) {
+            node_run_t run = { dyn, i, i + 1, dyn->hasBatch() };
+            nodeRuns.push_back(run);
+         }
+         else {
+            nodeRuns.back().last = i + 1;
+         }
+      }
+      arcRuns.clear();
+      for (j=0; j<arcs; ++j) {
+         ArcDynamic *dyn = sys.arcData(arc[j]).dynamic;
+         if (arcRuns.empty() || arcRuns.back().dynamic != dyn) {
+            arc_run_t run = { dyn, j, j + 1, dyn->hasBatch() };
+            arcRuns.push_back(run);
+         }
+         else {
+            arcRuns.back().last = j + 1;
+         }
+      }
+      
+      // Cut the runs into cache sized blocks
+      int work = (blockWork > 0) ? blockWork : 1;
+      nodeBlocks.clear();
+      for (r=0; r<(int)nodeRuns.size(); ++r) {
+         node_run_t block = nodeRuns[r];
+         int w = 0;
+         for (i=nodeRuns[r].first; i<nodeRuns[r].last; ++i) {
+            w += 1 + inOffset[i+1] - inOffset[i];
+            if (w >= work || i+1 == nodeRuns[r].last) {
+               block.last = i + 1;
+               nodeBlocks.push_back(block);
+               block.first = i + 1;
+               w = 0;
+            }
+         }
+      }
+      arcBlocks.clear();
+      for (r=0; r<(int)arcRuns.size(); ++r) {
+         arc_run_t block = arcRuns[r];
+         for (j=arcRuns[r].first; j<arcRuns[r].last; j+=work) {
+            block.first = j;
+            block.last = (j + work < arcRuns[r].last) ? j + work : arcRuns[r].last;
+            arcBlocks.push_back(block);
+         }
+      }
+   }
+   
+   void CompiledSystem::evalNodes (System &sys, const node_run_t &run, const State &x, 
+                                   State &dx, const double t) {
+      if (run.batch) {
+         run.dynamic->fnBatch(*this, run.first, run.last, x, dx, t);
+      }
+      else {
+         for (int i=run.first; i<run.last; ++i) {
+            run.dynamic->fn(node[i], sys, x, dx, t);
+         }
+      }
+   }
+   
+   void CompiledSystem::evalArcs (System &sys, const arc_run_t &run, const State &x, 
+                                  State &dx, const double t) {
+      if (run.batch) {
+         run.dynamic->fnBatch(*this, run.first, run.last, x, dx, t);
+      }
+      else {
+         for (int i=run.first; i<run.last; ++i) {
+            run.dynamic->fn(arc[i], sys, x, dx, t);
+         }
+      }
+   }
+   
+   void CompiledSystem::operator() (System &sys, const State &x, State &dx, const double t) {
+      int r;
+      int nBlocks = (nodeStates > 0) ? (int)nodeBlocks.size() : 0;
+      int aBlocks = (arcStates > 0) ? (int)arcBlocks.size() : 0;
+      
+#ifdef _OPENMP
+      if (threads != 1 && nBlocks + aBlocks > 1) {
+         int team = (threads > 0) ? threads : omp_get_max_threads();
+         // Every block writes to its own part of dx so they can run in any order
+         #pragma omp parallel for schedule(dynamic) num_threads(team)
+         for (r=0; r<nBlocks+aBlocks; ++r) {
+            if (r < nBlocks) { evalNodes(sys, nodeBlocks[r], x, dx, t); }
+            else { evalArcs(sys, arcBlocks[r-nBlocks], x, dx, t); }
+         }
+         return;
+      }
+#endif
+      
+      // Each run of nodes updates itself
+      if (nodeStates > 0) {
+         for (r=0; r<(int)nodeRuns.size(); ++r) { evalNodes(sys, nodeRuns[r], x, dx, t); }
+      }
+      
+      // Each run of arcs updates itself
+      if (arcStates > 0) {
+         for (r=0; r<(int)arcRuns.size(); ++r) { evalArcs(sys, arcRuns[r], x, dx, t); }
+      }
+   }
+   
+} // netevo namespace
@@ -0,0 +1,183 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_COMPILED_H
+#define NE_COMPILED_H
+
+#include "system.h"
+
+using namespace std;
+
+namespace netevo {
+   
+   /** A run of consecutive node IDs that share the same dynamics. */
+   typedef struct {
+      NodeDynamic *dynamic; /**< Dynamics of every node in the run */
+      int          first;   /**< First node ID in the run */
+      int          last;    /**< One past the last node ID in the run */
+      bool         batch;   /**< Whether the dynamics has a batched implementation */
+   } node_run_t;
+   
+   /** A run of consecutive arc IDs that share the same dynamics. */
+   typedef struct {
+      ArcDynamic  *dynamic; /**< Dynamics of every arc in the run */
+      int          first;   /**< First arc ID in the run */
+      int          last;    /**< One past the last arc ID in the run */
+      bool         batch;   /**< Whether the dynamics has a batched implementation */
+   } arc_run_t;
+   
+   /** Structure of arrays store for dynamic parameters.
+    *  Parameter slot k of every node (or arc) is held contiguously in column k and indexed by ID, 
+    *  so a kernel reading the same parameter for a range of IDs touches a single array. Nodes with 
+    *  fewer parameters than the number of slots are padded with zeros. */
+   class ParamStore {
+   private:
+      /** Number of IDs (length of each column) */
+      int mSize;
+      /** Number of parameter slots (columns) */
+      int mSlots;
+      /** Column data (column k starts at k*mSize) */
+      vector<double> mData;
+      /** Column returned for slots that do not exist */
+      vector<double> mZeros;
+   public:
+      ParamStore () : mSize(0), mSlots(0) { }
+      
+      /** Clear the store and size it for a number of IDs and parameter slots */
+      void reset (int size, int slots) { 
+         mSize = size; 
+         mSlots = slots; 
+         mData.assign(size*slots, 0.0); 
+         mZeros.assign(size, 0.0);
+      }
+      
+      /** Number of IDs held */
+      int size  () const { return mSize; }
+      /** Number of parameter slots */
+      int slots () const { return mSlots; }
+      
+      /** Contiguous array holding a parameter slot for every ID. Slots that do not exist read as 
+       *  zero (as System::nodeParam), so this is only NULL if there are no IDs. */
+      const double * column (int slot) const { 
+         if (mSize == 0) { return NULL; }
+         return (slot < mSlots) ? &mData[slot*mSize] : &mZeros[0];
+      }
+      /** Writable array of a parameter slot (NULL if the slot does not exist) */
+      double *       column (int slot)       { return (slot < mSlots && mSize > 0) ? &mData[slot*mSize] : NULL; }
+      
+      /** Value of a parameter (zero if the slot does not exist) */
+      double get (int id, int slot) const { return (slot < mSlots) ? mData[slot*mSize + id] : 0.0; }
+      /** Set the value of a parameter, adding slots if required */
+      void set (int id, int slot, double value);
+   };
+   
+   /** Flat (compressed sparse row) snapshot of a System.
+    *  All nodes and arcs are referred to by their ID (see System::nodeID and System::arcID) and 
+    *  the in-arcs of every node are stored contiguously so that the dynamics can be evaluated 
+    *  without walking the graph or looking up maps. Node i has in-arcs inOffset[i] to 
+    *  inOffset[i+1]-1, for which the state index of the source node, the state index of the arc 
+    *  and the arc weight are held in inSource, inArcState and inWeight. Dynamic parameters are 
+    *  held in a ParamStore for nodes and another for arcs.
+    *  
+    *  The runs are also cut into blocks of roughly blockWork nodes plus in-arcs (or arcs) so that 
+    *  each block's slice of the arrays stays in cache. When threads is not 1 (and OpenMP is 
+    *  available) the blocks are shared dynamically between the threads, which write to disjoint 
+    *  parts of dx without any locking. The fn of dynamics without a batched implementation must 
+    *  then be safe to call concurrently for different nodes (or arcs). */
+   class CompiledSystem {
+   public:
+      /** Number of nodes */
+      int nodes;
+      /** Number of arcs */
+      int arcs;
+      /** Number of dynamic states per node */
+      int nodeStates;
+      /** Number of dynamic states per arc */
+      int arcStates;
+      
+      /** Node handle for each node ID */
+      vector<Node>   node;
+      /** Arc handle for each arc ID */
+      vector<Arc>    arc;
+      
+      /** Offset of the first in-arc of each node (size nodes+1) */
+      vector<int>    inOffset;
+      /** State index of the source node of each in-arc */
+      vector<int>    inSource;
+      /** State index of each in-arc */
+      vector<int>    inArcState;
+      /** Weight of each in-arc */
+      vector<double> inWeight;
+      
+      /** State index of the source node of each arc */
+      vector<int>    arcSource;
+      /** State index of the target node of each arc */
+      vector<int>    arcTarget;
+      /** Weight of each arc */
+      vector<double> arcWeight;
+      
+      /** Dynamic parameters of all nodes (one column per parameter slot) */
+      ParamStore     nodeParams;
+      /** Dynamic parameters of all arcs (one column per parameter slot) */
+      ParamStore     arcParams;
+      
+      /** Runs of nodes sharing the same dynamics (in ID order) */
+      vector<node_run_t> nodeRuns;
+      /** Runs of arcs sharing the same dynamics (in ID order) */
+      vector<arc_run_t>  arcRuns;
+      
+      /** Threads used to evaluate the dynamics (1 is serial, 0 the OpenMP default) */
+      int threads;
+      /** Target amount of work (nodes plus in-arcs, or arcs) in each block */
+      int blockWork;
+      /** Runs of nodes cut into blocks */
+      vector<node_run_t> nodeBlocks;
+      /** Runs of arcs cut into blocks */
+      vector<arc_run_t>  arcBlocks;
+      
+      CompiledSystem () : nodes(0), arcs(0), nodeStates(0), arcStates(0), threads(1), 
+                          blockWork(16384) { }
+      
+      /** Build the flat form from a System (state IDs of the System must be valid). */
+      void compile (System &sys);
+      
+      /** Evaluate the dynamics of the System in the same order as System::operator(). */
+      void operator() (System &sys, const State &x, State &dx, const double t);
+      
+      /** Evaluate the dynamics of a run (or block) of nodes */
+      void evalNodes (System &sys, const node_run_t &run, const State &x, State &dx, const double t);
+      /** Evaluate the dynamics of a run (or block) of arcs */
+      void evalArcs  (System &sys, const arc_run_t &run, const State &x, State &dx, const double t);
+      
+      /** Start index of a node in any dynamical state vector */
+      int nodeStateID (int i) const { return i * nodeStates; }
+      /** Start index of an arc in any dynamical state vector */
+      int arcStateID  (int i) const { return (nodes * nodeStates) + (i * arcStates); }
+      
+      /** Contiguous array (indexed by node ID) of a node parameter slot */
+      const double * nodeParam (int slot) const { return nodeParams.column(slot); }
+      /** Contiguous array (indexed by arc ID) of an arc parameter slot */
+      const double * arcParam  (int slot) const { return arcParams.column(slot); }
+   };
+   
+} // netevo namespace
+
+#endif // NE_COMPILED_H
@@ -0,0 +1,209 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "device.h"
+#include "dynamics.h"
+#include <limits>
+#include <typeinfo>
+
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+#define NE_OMP_TARGET
+#include <omp.h>
+#endif
+
+namespace netevo {
+   
+   // Every kernel is a target region that finds the device copies of the arrays mapped by the 
+   // enclosing target data region in SimulateOdeDevice::simulate (pointers referenced in a target 
+   // region are mapped as zero length array sections). Without offloading they are plain loops.
+   
+   /** Kernel type of a node dynamic (exact types only, as derived classes may change fn). */
+   static int deviceKernel (NodeDynamic *dyn) {
+      if (typeid(*dyn) == typeid(KuramotoOscillator)) { return DEVICE_KURAMOTO; }
+      if (typeid(*dyn) == typeid(DiffusiveCoupling))  { return DEVICE_DIFFUSIVE; }
+      if (typeid(*dyn) == typeid(LinearCoupling))     { return DEVICE_LINEAR; }
+      return DEVICE_NONE;
+   }
+   
+   /** Derivatives of every node (the same expressions as the fn of each dynamic). */
+   static void deviceRhs (int n, const int *off, const int *src, const int *kind, const double *a, 
+                          const double *p0, const double *p1, const double *x, double *dx) {
+#ifdef NE_OMP_TARGET
+      #pragma omp target teams distribute parallel for
+#endif
+      for (int i=0; i<n; ++i) {
+         double xi = x[i], c = 0.0;
+         int type = kind[i];
+         for (int k=off[i]; k<off[i+1]; ++k) {
+            double xj = x[src[k]];
+            if (type == DEVICE_KURAMOTO)       { c += a[k] * vsin(xj - xi); }
+            else if (type == DEVICE_DIFFUSIVE) { c += a[k] * (xj - xi); }
+            else                               { c += a[k] * xj; }
+         }
+         dx[i] = (type == DEVICE_KURAMOTO) ? p0[i] + p1[i] * c : p0[i] * xi + p1[i] * c;
+      }
+   }
+   
+   /** out = x + c * k */
+   static void deviceAxpy (int n, double *out, const double *x, double c, const double *k) {
+#ifdef NE_OMP_TARGET
+      #pragma omp target teams distribute parallel for
+#endif
+      for (int i=0; i<n; ++i) { out[i] = x[i] + c * k[i]; }
+   }
+   
+   /** out = x + c0 * k0 + c1 * k1 + c2 * k2 + c3 * k3 + c4 * k4 (summed in this order) */
+   static void deviceSum (int n, double *out, const double *x, double c0, const double *k0, double c1, 
+                          const double *k1, double c2, const double *k2, double c3, const double *k3, 
+                          double c4, const double *k4) {
+#ifdef NE_OMP_TARGET
+      #pragma omp target teams distribute parallel for
+#endif
+      for (int i=0; i<n; ++i) { 
+         out[i] = x[i] + c0 * k0[i] + c1 * k1[i] + c2 * k2[i] + c3 * k3[i] + c4 * k4[i]; 
+      }
+   }
+   
+   bool SimulateOdeDevice::supported (System &sys) {
+      if (sys.nodeStates() != 1 || sys.arcStates() != 0) { return false; }
+      for (System::NodeIt v(sys); v != INVALID; ++v) {
+         if (deviceKernel(sys.nodeData(v).dynamic) == DEVICE_NONE) { return false; }
+      }
+      return true;
+   }
+   
+   int SimulateOdeDevice::devices () {
+#ifdef NE_OMP_TARGET
+      return omp_get_num_devices();
+#else
+      return 0;
+#endif
+   }
+   
+   void SimulateOdeDevice::simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger) {
+      
+      // Check to ensure that initial conditions are correct size
+      int states = (countNodes(sys)*sys.nodeStates()) + (countArcs(sys)*sys.arcStates());
+      if (initial.size() < states || initial.size() > states) {
+         cerr << "Incorrect number of states for initial conditions (SimulateOdeDevice::simulate)" << endl;
+         return;
+      }
+      
+      // Systems with other dynamics are simulated on the host
+      if (!supported(sys)) {
+         SimulateOdeFixed host(mStepper, mStepSize);
+         host.simulate(sys, tMax, initial, obs, logger);
+         return;
+      }
+      
+      // Check that the state IDs are correct, if not refresh
+      if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
+      
+      // Flat copy of the System (one state per node so state indexes are node IDs)
+      CompiledSystem cs;
+      cs.compile(sys);
+      int i, n = cs.nodes, e = cs.arcs;
+      vector<int> kind(n);
+      vector<double> p0(n), p1(n);
+      for (i=0; i<n; ++i) {
+         kind[i] = deviceKernel(sys.nodeData(cs.node[i]).dynamic);
+         p0[i] = cs.nodeParams.get(i, 0);
+         p1[i] = cs.nodeParams.get(i, 1);
+      }
+      
+      // Work space. The host vector only provides the address for the mapping, it is mapped with 
+      // map(alloc) so its contents are never copied to or from the device.
+      int hist = (mStepper == ADAM_BASH_MOUL) ? 5 : 0;
+      vector<double> work((5 + hist) * n + 1);
+      
+      const int *OFF = &cs.inOffset[0], *SRC = cs.inSource.data(), *KIND = kind.data();
+      const double *A = cs.inWeight.data(), *P0 = p0.data(), *P1 = p1.data();
+      double *X = initial.data(), *W = &work[0];
+      double *K1 = W, *K2 = W + n, *K3 = W + 2 * n, *K4 = W + 3 * n, *XT = W + 4 * n, *H = W + 5 * n;
+      int wn = work.size();
+      
+      // Runge Kutta (4) coefficients as used by odeint
+      const double dt = mStepSize, h2 = 0.5 * dt;
+      const double b0 = (1.0 / 6.0) * dt, b1 = (1.0 / 3.0) * dt;
+      // Adams Bashforth (5) predictor and Adams Moulton (5) corrector coefficients
+      const double ab[5] = { 1901.0 / 720.0, -2774.0 / 720.0, 2616.0 / 720.0, -1274.0 / 720.0, 251.0 / 720.0 };
+      const double am[5] = { 251.0 / 720.0, 646.0 / 720.0, -264.0 / 720.0, 106.0 / 720.0, -19.0 / 720.0 };
+      
+      int step = 0, slot[5], j;
+      double t = 0.0;
+      
+#ifdef NE_OMP_TARGET
+      #pragma omp target data map(tofrom: X[0:n]) map(to: OFF[0:n+1], SRC[0:e], KIND[0:n], A[0:e], P0[0:n], P1[0:n]) map(alloc: W[0:wn])
+#endif
+      {
+         while (true) {
+            // Same end condition as integrate_const (so the same number of steps are taken)
+            bool last = (t + dt - tMax > numeric_limits<double>::epsilon());
+            
+            // Copy the states back to observe them
+            if (step % mObserveEvery == 0 || last) {
+#ifdef NE_OMP_TARGET
+               if (step > 0) {
+                  #pragma omp target update from(X[0:n])
+               }
+#endif
+               logger.newState(sys, initial);
+               logger.endStep(SIM_STEP);
+               logger.commit();
+               obs(initial, t);
+               if (obs.stop()) { break; }
+            }
+            if (last) { break; }
+            
+            if (mStepper == ADAM_BASH_MOUL) {
+               // Derivatives of the last five steps are kept in rotation (slot[0] is the newest)
+               for (j=0; j<5; ++j) { slot[j] = (step - j + 5) % 5; }
+               K1 = H + slot[0] * n;
+            }
+            deviceRhs(n, OFF, SRC, KIND, A, P0, P1, X, K1);
+            
+            if (mStepper == ADAM_BASH_MOUL && step >= 4) {
+               // Predict, evaluate and correct
+               deviceSum(n, XT, X, dt * ab[0], H + slot[0] * n, dt * ab[1], H + slot[1] * n, dt * ab[2], 
+                         H + slot[2] * n, dt * ab[3], H + slot[3] * n, dt * ab[4], H + slot[4] * n);
+               deviceRhs(n, OFF, SRC, KIND, A, P0, P1, XT, K2);
+               deviceSum(n, X, X, dt * am[0], K2, dt * am[1], H + slot[0] * n, dt * am[2], H + slot[1] * n, 
+                         dt * am[3], H + slot[2] * n, dt * am[4], H + slot[3] * n);
+            }
+            else {
+               // Runge Kutta (4), which also starts Adams Bashforth Moulton
+               deviceAxpy(n, XT, X, h2, K1);
+               deviceRhs(n, OFF, SRC, KIND, A, P0, P1, XT, K2);
+               deviceAxpy(n, XT, X, h2, K2);
+               deviceRhs(n, OFF, SRC, KIND, A, P0, P1, XT, K3);
+               deviceAxpy(n, XT, X, dt, K3);
+               deviceRhs(n, OFF, SRC, KIND, A, P0, P1, XT, K4);
+               deviceSum(n, X, X, b0, K1, b1, K2, b1, K3, b0, K4, 0.0, K4);
+            }
+            
+            // Direct computation of the time avoids error propagation (as integrate_const)
+            step++;
+            t = (double)step * dt;
+         }
+      }
+   }
+   
+} // netevo namespace
@@ -0,0 +1,77 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_DEVICE_H
+#define NE_DEVICE_H
+
+#include "system.h"
+#include "compiled.h"
+#include "simulate.h"
+
+using namespace std;
+
+namespace netevo {
+   
+   /** Built-in node dynamics that can be evaluated on a device. */
+   enum device_kernel_e {
+      DEVICE_NONE      = 0, /** Not available on the device */
+      DEVICE_KURAMOTO  = 1, /** KuramotoOscillator */
+      DEVICE_DIFFUSIVE = 2, /** DiffusiveCoupling */
+      DEVICE_LINEAR    = 3  /** LinearCoupling */
+   };
+   
+   /** Fixed step simulation (as SimulateOdeFixed) offloaded to an accelerator through OpenMP 
+    *  target regions. The compiled topology (in-arc offsets, sources and weights) and the first 
+    *  two parameter columns are copied to the device once per simulation, after which every 
+    *  stage of the stepper runs there and the states are only copied back every observeEvery 
+    *  steps to be observed and logged (the final state is always observed). Both steppers follow 
+    *  the same arithmetic as odeint (Adams Bashforth Moulton is the fifth order predictor 
+    *  corrector started with four Runge Kutta (4) steps), so on the host the results are the same 
+    *  as SimulateOdeFixed for an uncompiled System. A device may differ in the last bits (e.g. 
+    *  by fusing multiply adds). 
+    *  
+    *  Only Systems whose nodes all use KuramotoOscillator, DiffusiveCoupling or LinearCoupling 
+    *  (and have no arc states) can be offloaded, any other System is simulated by 
+    *  SimulateOdeFixed. If no device is present (or OpenMP offloading was not enabled when 
+    *  compiling, see --enable-offload) the target regions run on the host in parallel. */
+   class SimulateOdeDevice : public Simulate {
+   public:
+      SimulateOdeDevice (fixed_step_type_e stepper, double stepSize, int observeEvery = 1) { 
+         mStepper = stepper;
+         mStepSize = stepSize;
+         mObserveEvery = (observeEvery < 1) ? 1 : observeEvery;
+      };
+      void simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger);
+      
+      /** Whether a System can be simulated on the device. */
+      static bool supported (System &sys);
+      /** Number of devices available for offloading (0 if the host is used). */
+      static int devices ();
+      
+   private:
+      fixed_step_type_e mStepper;
+      double mStepSize;
+      int    mObserveEvery;
+   };
+   
+} // netevo namespace
+
+#endif // NE_DEVICE_H
@@ -0,0 +1,286 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "dynamics.h"
+#include <cmath>
+
+namespace netevo {
+   
+   const double TWO_PI = 6.28318530717958647693;
+   
+   /** Wrap a phase into [0, 2pi) (fmod alone keeps the sign, so would leave negative phases) */
+   static inline double wrapPhase (double x) {
+      double y = fmod(x, TWO_PI);
+      if (y < 0.0) { y += TWO_PI; }
+      // A tiny negative phase rounds up to 2pi when shifted
+      return (y < TWO_PI) ? y : 0.0;
+   }
+   
+   // The scalar (fn) and batched (fnBatch) versions of each dynamic compute the same expressions so
+   // results only depend on whether the System has been compiled through the order of summation. The
+   // batched versions read everything from the flat arrays and the coupling loop is written so that
+   // the compiler can vectorise it for the target instruction set (with OpenMP it is marked as a SIMD
+   // loop, which allows the coupling sum to be reordered). The ensemble versions (fnEnsemble) loop over
+   // the members innermost, accumulating the coupling in dx, and so sum the in-arcs in the same order
+   // as fn for every member.
+   
+   // ---------- KuramotoOscillator ----------
+   
+   void KuramotoOscillator::setDefaultParams (Node v, System &sys) {
+      sys.nodeData(v).dynamicParams.push_back(1.0); // Natural frequency
+      sys.nodeData(v).dynamicParams.push_back(1.0); // Coupling strength
+   }
+   
+   void KuramotoOscillator::fn (Node v, System &sys, const State &x, State &dx, const double t) {
+      int vID = sys.stateID(v);
+      double xi = x[vID], c = 0.0;
+      for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+         c += sys.arcData(e).weight * vsin(x[sys.stateID(sys.source(e))] - xi);
+      }
+      dx[vID] = sys.nodeParam(v, 0) + sys.nodeParam(v, 1) * c;
+   }
+   
+   void KuramotoOscillator::fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t) {
+      const double *w = cs.nodeParam(0), *K = cs.nodeParam(1);
+      const int *src = cs.inSource.data(), *off = cs.inOffset.data();
+      const double *a = cs.inWeight.data();
+      for (int i=first; i<last; ++i) {
+         int vID = cs.nodeStateID(i);
+         double xi = x[vID], c = 0.0;
+#ifdef _OPENMP
+         #pragma omp simd reduction(+:c)
+#endif
+         for (int k=off[i]; k<off[i+1]; ++k) {
+            c += a[k] * vsin(x[src[k]] - xi);
+         }
+         dx[vID] = w[i] + K[i] * c;
+      }
+   }
+   
+   void KuramotoOscillator::fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t) {
+      const int B = ce.members;
+      const double *w = ce.nodeParam(0), *K = ce.nodeParam(1);
+      const int *src = ce.structure.inSource.data(), *off = ce.structure.inOffset.data();
+      const double *a = ce.inWeight.data(), *X = x.data();
+      double *dX = dx.data();
+      for (int i=first; i<last; ++i) {
+         const int vID = ce.nodeStateID(i);
+         for (int m=0; m<B; ++m) { dX[vID + m] = 0.0; }
+         for (int k=off[i]; k<off[i+1]; ++k) {
+            const int jID = src[k] * B, kID = k * B;
+#ifdef _OPENMP
+            #pragma omp simd
+#endif
+            for (int m=0; m<B; ++m) {
+               dX[vID + m] += a[kID + m] * vsin(X[jID + m] - X[vID + m]);
+            }
+         }
+         for (int m=0; m<B; ++m) {
+            dX[vID + m] = w[i * B + m] + K[i * B + m] * dX[vID + m];
+         }
+      }
+   }
+   
+   void KuramotoOscillator::jacobian (Node v, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J) {
+      int vID = sys.stateID(v);
+      double xi = x[vID], K = sys.nodeParam(v, 1), d = 0.0;
+      for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+         int jID = sys.stateID(sys.source(e));
+         double c = K * sys.arcData(e).weight * cos(x[jID] - xi);
+         jacobian_entry_t entry = { vID, jID, c };
+         J.push_back(entry);
+         d -= c;
+      }
+      jacobian_entry_t self = { vID, vID, d };
+      J.push_back(self);
+   }
+   
+   // ---------- KuramotoMap ----------
+   
+   void KuramotoMap::setDefaultParams (Node v, System &sys) {
+      sys.nodeData(v).dynamicParams.push_back(0.2); // Natural frequency
+      sys.nodeData(v).dynamicParams.push_back(0.1); // Coupling strength
+   }
+   
+   void KuramotoMap::fn (Node v, System &sys, const State &x, State &dx, const double t) {
+      int vID = sys.stateID(v);
+      double xi = x[vID], c = 0.0;
+      for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+         c += sys.arcData(e).weight * vsin(x[sys.stateID(sys.source(e))] - xi);
+      }
+      dx[vID] = wrapPhase(xi + sys.nodeParam(v, 0) + sys.nodeParam(v, 1) * c);
+   }
+   
+   void KuramotoMap::fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t) {
+      const double *w = cs.nodeParam(0), *K = cs.nodeParam(1);
+      const int *src = cs.inSource.data(), *off = cs.inOffset.data();
+      const double *a = cs.inWeight.data();
+      for (int i=first; i<last; ++i) {
+         int vID = cs.nodeStateID(i);
+         double xi = x[vID], c = 0.0;
+#ifdef _OPENMP
+         #pragma omp simd reduction(+:c)
+#endif
+         for (int k=off[i]; k<off[i+1]; ++k) {
+            c += a[k] * vsin(x[src[k]] - xi);
+         }
+         dx[vID] = wrapPhase(xi + w[i] + K[i] * c);
+      }
+   }
+   
+   // ---------- DiffusiveCoupling ----------
+   
+   void DiffusiveCoupling::setDefaultParams (Node v, System &sys) {
+      sys.nodeData(v).dynamicParams.push_back(0.0); // Self term
+      sys.nodeData(v).dynamicParams.push_back(1.0); // Coupling strength
+   }
+   
+   void DiffusiveCoupling::fn (Node v, System &sys, const State &x, State &dx, const double t) {
+      int vID = sys.stateID(v);
+      double xi = x[vID], c = 0.0;
+      for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+         c += sys.arcData(e).weight * (x[sys.stateID(sys.source(e))] - xi);
+      }
+      dx[vID] = sys.nodeParam(v, 0) * xi + sys.nodeParam(v, 1) * c;
+   }
+   
+   void DiffusiveCoupling::fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t) {
+      const double *s = cs.nodeParam(0), *K = cs.nodeParam(1);
+      const int *src = cs.inSource.data(), *off = cs.inOffset.data();
+      const double *a = cs.inWeight.data();
+      for (int i=first; i<last; ++i) {
+         int vID = cs.nodeStateID(i);
+         double xi = x[vID], c = 0.0;
+#ifdef _OPENMP
+         #pragma omp simd reduction(+:c)
+#endif
+         for (int k=off[i]; k<off[i+1]; ++k) {
+            c += a[k] * (x[src[k]] - xi);
+         }
+         dx[vID] = s[i] * xi + K[i] * c;
+      }
+   }
+   
+   void DiffusiveCoupling::fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t) {
+      const int B = ce.members;
+      const double *s = ce.nodeParam(0), *K = ce.nodeParam(1);
+      const int *src = ce.structure.inSource.data(), *off = ce.structure.inOffset.data();
+      const double *a = ce.inWeight.data(), *X = x.data();
+      double *dX = dx.data();
+      for (int i=first; i<last; ++i) {
+         const int vID = ce.nodeStateID(i);
+         for (int m=0; m<B; ++m) { dX[vID + m] = 0.0; }
+         for (int k=off[i]; k<off[i+1]; ++k) {
+            const int jID = src[k] * B, kID = k * B;
+#ifdef _OPENMP
+            #pragma omp simd
+#endif
+            for (int m=0; m<B; ++m) {
+               dX[vID + m] += a[kID + m] * (X[jID + m] - X[vID + m]);
+            }
+         }
+         for (int m=0; m<B; ++m) {
+            dX[vID + m] = s[i * B + m] * X[vID + m] + K[i * B + m] * dX[vID + m];
+         }
+      }
+   }
+   
+   void DiffusiveCoupling::jacobian (Node v, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J) {
+      int vID = sys.stateID(v);
+      double K = sys.nodeParam(v, 1), d = sys.nodeParam(v, 0);
+      for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+         jacobian_entry_t entry = { vID, sys.stateID(sys.source(e)), K * sys.arcData(e).weight };
+         J.push_back(entry);
+         d -= entry.value;
+      }
+      jacobian_entry_t self = { vID, vID, d };
+      J.push_back(self);
+   }
+   
+   // ---------- LinearCoupling ----------
+   
+   void LinearCoupling::setDefaultParams (Node v, System &sys) {
+      sys.nodeData(v).dynamicParams.push_back(-1.0); // Self term
+      sys.nodeData(v).dynamicParams.push_back(1.0);  // Coupling strength
+   }
+   
+   void LinearCoupling::fn (Node v, System &sys, const State &x, State &dx, const double t) {
+      int vID = sys.stateID(v);
+      double c = 0.0;
+      for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+         c += sys.arcData(e).weight * x[sys.stateID(sys.source(e))];
+      }
+      dx[vID] = sys.nodeParam(v, 0) * x[vID] + sys.nodeParam(v, 1) * c;
+   }
+   
+   void LinearCoupling::fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t) {
+      const double *s = cs.nodeParam(0), *K = cs.nodeParam(1);
+      const int *src = cs.inSource.data(), *off = cs.inOffset.data();
+      const double *a = cs.inWeight.data();
+      for (int i=first; i<last; ++i) {
+         int vID = cs.nodeStateID(i);
+         double c = 0.0;
+#ifdef _OPENMP
+         #pragma omp simd reduction(+:c)
+#endif
+         for (int k=off[i]; k<off[i+1]; ++k) {
+            c += a[k] * x[src[k]];
+         }
+         dx[vID] = s[i] * x[vID] + K[i] * c;
+      }
+   }
+   
+   void LinearCoupling::fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t) {
+      const int B = ce.members;
+      const double *s = ce.nodeParam(0), *K = ce.nodeParam(1);
+      const int *src = ce.structure.inSource.data(), *off = ce.structure.inOffset.data();
+      const double *a = ce.inWeight.data(), *X = x.data();
+      double *dX = dx.data();
+      for (int i=first; i<last; ++i) {
+         const int vID = ce.nodeStateID(i);
+         for (int m=0; m<B; ++m) { dX[vID + m] = 0.0; }
+         for (int k=off[i]; k<off[i+1]; ++k) {
+            const int jID = src[k] * B, kID = k * B;
+#ifdef _OPENMP
+            #pragma omp simd
+#endif
+            for (int m=0; m<B; ++m) {
+               dX[vID + m] += a[kID + m] * X[jID + m];
+            }
+         }
+         for (int m=0; m<B; ++m) {
+            dX[vID + m] = s[i * B + m] * X[vID + m] + K[i * B + m] * dX[vID + m];
+         }
+      }
+   }
+   
+   void LinearCoupling::jacobian (Node v, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J) {
+      int vID = sys.stateID(v);
+      double K = sys.nodeParam(v, 1);
+      jacobian_entry_t self = { vID, vID, sys.nodeParam(v, 0) };
+      J.push_back(self);
+      for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+         jacobian_entry_t entry = { vID, sys.stateID(sys.source(e)), K * sys.arcData(e).weight };
+         J.push_back(entry);
+      }
+   }
+   
+} // netevo namespace
@@ -0,0 +1,139 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_DYNAMICS_H
+#define NE_DYNAMICS_H
+
+#include "system.h"
+#include "compiled.h"
+#include "ensemble.h"
+
+using namespace std;
+
+namespace netevo {
+   
+   /** Sine function that can be vectorised by the compiler (no branches or library calls) and
+    *  called from OpenMP target regions (see SimulateOdeDevice).
+    *  The argument is reduced to [-pi/2, pi/2] and a polynomial is used, giving an absolute error 
+    *  of around 2e-16 for arguments of moderate size (|x| < 1e6, and |x| must be less than 6e9). */
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+   #pragma omp declare target
+#endif
+   inline double vsin (double x) {
+      // Pi is split into three parts so that k*piA and k*piB are exact (Cody-Waite reduction)
+      const double invPi = 0.31830988618379067154;
+      const double piA   = 3.14159250259399414062;
+      const double piB   = 1.50995788317231926e-7;
+      const double piC   = 1.07806057163162381e-14;
+      // Nearest multiple of pi, rounded through a 32 bit conversion as calling floor stops the 
+      // compiler vectorising the loop unless traps are disabled (-fno-trapping-math)
+      double v = x * invPi;
+      int n = (int)(v + ((v < 0.0) ? -0.5 : 0.5));
+      double k = (double)n;
+      double r = ((x - k * piA) - k * piB) - k * piC;
+      double r2 = r * r;
+      double p = -3.868170170630684e-23;
+      p = p * r2 + 1.957294106339126e-20;
+      p = p * r2 - 8.220635246624329e-18;
+      p = p * r2 + 2.811457254345521e-15;
+      p = p * r2 - 7.647163731819816e-13;
+      p = p * r2 + 1.605904383682161e-10;
+      p = p * r2 - 2.505210838544172e-08;
+      p = p * r2 + 2.755731922398589e-06;
+      p = p * r2 - 1.984126984126984e-04;
+      p = p * r2 + 8.3333333333333332e-03;
+      p = p * r2 - 1.6666666666666666e-01;
+      double s = r + r * r2 * p;
+      // Odd multiples of pi flip the sign
+      double odd = (double)(n & 1);
+      return s - 2.0 * odd * s;
+   }
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+   #pragma omp end declare target
+#endif
+   
+   /** Kuramoto phase oscillator (ODE).
+    *  dtheta_i/dt = w_i + K_i * sum_j a_ji sin(theta_j - theta_i), where a_ji is the weight of the 
+    *  arc from j to i. Parameters: [0] natural frequency (w_i), [1] coupling strength (K_i). */
+   class KuramotoOscillator : public NodeDynamic {
+   public:
+      string getName   () { return "KuramotoOscillator"; }
+      int    getStates () { return 1; }
+      void   setDefaultParams (Node v, System &sys);
+      void   fn (Node v, System &sys, const State &x, State &dx, const double t);
+      bool   hasBatch () { return true; }
+      void   fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t);
+      bool   hasEnsemble () { return true; }
+      void   fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t);
+      bool   hasJacobian () { return true; }
+      void   jacobian (Node v, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J);
+   };
+   
+   /** Kuramoto phase oscillator (discrete time map).
+    *  theta_i' = (theta_i + w_i + K_i * sum_j a_ji sin(theta_j - theta_i)) mod 2pi, in [0, 2pi). 
+    *  Parameters: [0] natural frequency (w_i), [1] coupling strength (K_i). */
+   class KuramotoMap : public NodeDynamic {
+   public:
+      string getName   () { return "KuramotoMap"; }
+      int    getStates () { return 1; }
+      void   setDefaultParams (Node v, System &sys);
+      void   fn (Node v, System &sys, const State &x, State &dx, const double t);
+      bool   hasBatch () { return true; }
+      void   fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t);
+   };
+   
+   /** Linear node with diffusive coupling (ODE).
+    *  dx_i/dt = a_i x_i + s_i * sum_j a_ji (x_j - x_i). With a_i = 0 this is the standard consensus 
+    *  (Laplacian) dynamics. Parameters: [0] self term (a_i), [1] coupling strength (s_i). */
+   class DiffusiveCoupling : public NodeDynamic {
+   public:
+      string getName   () { return "DiffusiveCoupling"; }
+      int    getStates () { return 1; }
+      void   setDefaultParams (Node v, System &sys);
+      void   fn (Node v, System &sys, const State &x, State &dx, const double t);
+      bool   hasBatch () { return true; }
+      void   fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t);
+      bool   hasEnsemble () { return true; }
+      void   fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t);
+      bool   hasJacobian () { return true; }
+      void   jacobian (Node v, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J);
+   };
+   
+   /** Linear node with linear coupling (ODE).
+    *  dx_i/dt = a_i x_i + s_i * sum_j a_ji x_j. Parameters: [0] self term (a_i), [1] coupling 
+    *  strength (s_i). */
+   class LinearCoupling : public NodeDynamic {
+   public:
+      string getName   () { return "LinearCoupling"; }
+      int    getStates () { return 1; }
+      void   setDefaultParams (Node v, System &sys);
+      void   fn (Node v, System &sys, const State &x, State &dx, const double t);
+      bool   hasBatch () { return true; }
+      void   fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t);
+      bool   hasEnsemble () { return true; }
+      void   fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t);
+      bool   hasJacobian () { return true; }
+      void   jacobian (Node v, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J);
+   };
+   
+} // netevo namespace
+
+#endif // NE_DYNAMICS_H
@@ -0,0 +1,336 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "ensemble.h"
+#include <boost/numeric/odeint.hpp>
+#include <boost/numeric/odeint/stepper/adams_bashforth_moulton.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace boost::numeric::odeint;
+
+namespace netevo {
+   
+   // ---------- CompiledEnsemble ----------
+   
+   int CompiledEnsemble::compile (vector<System*> &sys) {
+      int i, j, k, m, r;
+      
+      members = sys.size();
+      ensemble = false;
+      if (members == 0) { return 1; }
+      structure.compile(*sys[0]);
+      const int n = structure.nodes, a = structure.arcs;
+      
+      // Parameter slots are padded to the most used by any member
+      nodeSlots = structure.nodeParams.slots();
+      arcSlots = structure.arcParams.slots();
+      vector<CompiledSystem> forms(members);
+      for (m=1; m<members; ++m) {
+         if (sys[m] == sys[0]) { continue; }
+         CompiledSystem &c = forms[m];
+         c.compile(*sys[m]);
+         
+         // Every member must have the same structure and dynamics
+         bool same = (c.nodes == n && c.arcs == a && c.nodeStates == structure.nodeStates && 
+                      c.arcStates == structure.arcStates && c.inOffset == structure.inOffset && 
+                      c.inSource == structure.inSource && c.inArcState == structure.inArcState &&
+                      c.arcSource == structure.arcSource && c.arcTarget == structure.arcTarget &&
+                      c.nodeRuns.size() == structure.nodeRuns.size() && 
+                      c.arcRuns.size() == structure.arcRuns.size());
+         for (r=0; same && r<(int)c.nodeRuns.size(); ++r) {
+            same = (c.nodeRuns[r].dynamic == structure.nodeRuns[r].dynamic && 
+                    c.nodeRuns[r].last == structure.nodeRuns[r].last);
+         }
+         for (r=0; same && r<(int)c.arcRuns.size(); ++r) {
+            same = (c.arcRuns[r].dynamic == structure.arcRuns[r].dynamic && 
+                    c.arcRuns[r].last == structure.arcRuns[r].last);
+         }
+         if (!same) {
+            cerr << "Member " << m << " has a different structure (CompiledEnsemble::compile)" << endl;
+            return 1;
+         }
+         if (c.nodeParams.slots() > nodeSlots) { nodeSlots = c.nodeParams.slots(); }
+         if (c.arcParams.slots() > arcSlots) { arcSlots = c.arcParams.slots(); }
+      }
+      
+      // Interleave the weights and parameters of the members
+      inWeight.resize(a * members);
+      arcWeight.resize(a * members);
+      nodeParams.resize(nodeSlots * n * members);
+      arcParams.resize(arcSlots * a * members);
+      zeroParams.assign(max(n, a) * members, 0.0);
+      for (m=0; m<members; ++m) {
+         const CompiledSystem &c = (sys[m] == sys[0]) ? structure : forms[m];
+         for (j=0; j<a; ++j) {
+            inWeight[j * members + m] = c.inWeight[j];
+            arcWeight[j * members + m] = c.arcWeight[j];
+         }
+         for (k=0; k<nodeSlots; ++k) {
+            for (i=0; i<n; ++i) { nodeParams[(k * n + i) * members + m] = c.nodeParams.get(i, k); }
+         }
+         for (k=0; k<arcSlots; ++k) {
+            for (j=0; j<a; ++j) { arcParams[(k * a + j) * members + m] = c.arcParams.get(j, k); }
+         }
+      }
+      
+      // The ensemble kernels can only be used if every dynamic has one
+      ensemble = true;
+      for (r=0; r<(int)structure.nodeRuns.size(); ++r) {
+         if (structure.nodeStates > 0 && !structure.nodeRuns[r].dynamic->hasEnsemble()) { ensemble = false; }
+      }
+      for (r=0; r<(int)structure.arcRuns.size(); ++r) {
+         if (structure.arcStates > 0 && !structure.arcRuns[r].dynamic->hasEnsemble()) { ensemble = false; }
+      }
+      return 0;
+   }
+   
+   void CompiledEnsemble::operator() (const State &x, State &dx, const double t) {
+      int r;
+      if (structure.nodeStates > 0) {
+         for (r=0; r<(int)structure.nodeRuns.size(); ++r) {
+            node_run_t &run = structure.nodeRuns[r];
+            run.dynamic->fnEnsemble(*this, run.first, run.last, x, dx, t);
+         }
+      }
+      if (structure.arcStates > 0) {
+         for (r=0; r<(int)structure.arcRuns.size(); ++r) {
+            arc_run_t &run = structure.arcRuns[r];
+            run.dynamic->fnEnsemble(*this, run.first, run.last, x, dx, t);
+         }
+      }
+   }
+   
+   // ---------- EnsembleObserverMembers ----------
+   
+   void EnsembleObserverMembers::operator() (const State &x, int members, double t, vector<char> &active) {
+      for (int m=0; m<members && m<(int)mObs.size(); ++m) {
+         if (!active[m]) { continue; }
+         SimulateEnsemble::member(x, members, m, mX);
+         if (mLimit > 0.0) {
+            bool ok = true;
+            for (int s=0; s<(int)mX.size() && ok; ++s) { ok = (fabs(mX[s]) <= mLimit); }
+            if (!ok) { active[m] = 0; continue; }
+         }
+         if (mObs[m] != NULL) { (*mObs[m])(mX, t); }
+      }
+   }
+   
+   // ---------- SimulateEnsemble ----------
+   
+   /** Work space shared by the copies of an EnsembleRhs */
+   typedef struct {
+      CompiledEnsemble *ce;
+      vector<System*>  *sys;
+      vector<char>     *active;
+      int               states;
+      State             x;
+      State             dx;
+   } ensemble_rhs_t;
+   
+   /** Derivatives of the interleaved ensemble (odeint copies the system so the work space is 
+    *  held by pointer). */
+   class EnsembleRhs {
+   private:
+      ensemble_rhs_t *mW;
+   public:
+      EnsembleRhs (ensemble_rhs_t *w) : mW(w) { }
+      void operator() (const State &x, State &dx, const double t) {
+         int m, s, B = mW->ce->members;
+         vector<char> &active = *mW->active;
+         if (mW->ce->ensemble) {
+            (*mW->ce)(x, dx, t);
+         }
+         else {
+            // Evaluate each active member alone using its own System
+            for (m=0; m<B; ++m) {
+               if (!active[m]) { continue; }
+               SimulateEnsemble::member(x, B, m, mW->x);
+               mW->dx.assign(mW->states, 0.0);
+               (*(*mW->sys)[m])(mW->x, mW->dx, t);
+               for (s=0; s<mW->states; ++s) { dx[s * B + m] = mW->dx[s]; }
+            }
+         }
+         // Frozen members do not change
+         for (m=0; m<B; ++m) {
+            if (active[m]) { continue; }
+            for (s=0; s<mW->states; ++s) { dx[s * B + m] = 0.0; }
+         }
+      }
+   };
+   
+   /** Stepper specific handling of members being frozen (multistep methods must restart). */
+   template <class Stepper> void restartStepper (Stepper &stepper) { }
+   template <> void restartStepper (adams_bashforth_moulton<5,State> &stepper) { stepper.reset(); }
+   
+   /** Observe the ensemble, returning true if any member was frozen. */
+   static bool observeEnsemble (EnsembleObserver &obs, const State &x, int members, double t, vector<char> &active) {
+      int before = 0, after = 0, m;
+      for (m=0; m<members; ++m) { before += active[m] ? 1 : 0; }
+      obs(x, members, t, active);
+      for (m=0; m<members; ++m) { after += active[m] ? 1 : 0; }
+      return (after != before);
+   }
+   
+   template <class Stepper> 
+   static void integrateFixed (Stepper stepper, EnsembleRhs rhs, State &x, double tMax, double dt, 
+                        EnsembleObserver &obs, vector<char> &active) {
+      int B = active.size(), step = 0;
+      double t = 0.0;
+      while (true) {
+         if (observeEnsemble(obs, x, B, t, active)) { restartStepper(stepper); }
+         if (std::find(active.begin(), active.end(), 1) == active.end()) { break; }
+         // Same end condition as integrate_const (so the same number of steps are taken)
+         if (t + dt - tMax > numeric_limits<double>::epsilon()) { break; }
+         stepper.do_step(rhs, x, t, dt);
+         step++;
+         t = (double)step * dt;
+      }
+   }
+   
+   template <class Stepper> 
+   static void integrateControlled (Stepper stepper, EnsembleRhs rhs, State &x, double tMax, double outputStep, 
+                             EnsembleObserver &obs, vector<char> &active) {
+      int B = active.size(), step = 0, fails;
+      double t = 0.0, dt = outputStep, tEnd;
+      while (true) {
+         observeEnsemble(obs, x, B, t, active);
+         if (std::find(active.begin(), active.end(), 1) == active.end()) { break; }
+         if (t + outputStep - tMax > numeric_limits<double>::epsilon()) { break; }
+         
+         // Take as many steps as needed to reach the next observation
+         tEnd = (double)(step + 1) * outputStep;
+         while (tEnd - t > 1e-12 * outputStep) {
+            if (t + dt > tEnd) { dt = tEnd - t; }
+            fails = 0;
+            while (stepper.try_step(rhs, x, t, dt) == fail) {
+               if (++fails > 500) {
+                  cerr << "Step size adjustment failed (SimulateEnsemble::simulate)" << endl;
+                  return;
+               }
+            }
+         }
+         step++;
+         t = tEnd;
+      }
+   }
+   
+   void SimulateEnsemble::simulate (vector<System*> &sys, double tMax, vector<State> &initial, 
+                                    EnsembleObserver &obs, vector<char> &active) {
+      int m, B = sys.size();
+      
+      // Check to ensure that there is an initial state of the correct size for each member
+      if (B == 0 || (int)initial.size() != B || (!active.empty() && (int)active.size() != B)) {
+         cerr << "Incorrect number of members (SimulateEnsemble::simulate)" << endl;
+         return;
+      }
+      for (m=0; m<B; ++m) {
+         int states = (countNodes(*sys[m])*sys[m]->nodeStates()) + (countArcs(*sys[m])*sys[m]->arcStates());
+         if ((int)initial[m].size() != states) {
+            cerr << "Incorrect number of states for initial conditions (SimulateEnsemble::simulate)" << endl;
+            return;
+         }
+         // Check that the state IDs are correct, if not refresh
+         if (!sys[m]->validStateIDs()) { sys[m]->refreshStateIDs(); }
+      }
+      if (active.empty()) { active.assign(B, 1); }
+      
+      CompiledEnsemble ce;
+      if (ce.compile(sys) != 0) { return; }
+      
+      ensemble_rhs_t work;
+      work.ce = &ce;
+      work.sys = &sys;
+      work.active = &active;
+      work.states = initial[0].size();
+      EnsembleRhs rhs(&work);
+      
+      State x;
+      interleave(initial, x);
+      
+      // Create the required steppers
+      typedef runge_kutta4<State> rk4_stepper_type;
+      typedef adams_bashforth_moulton<5,State> adams_bash_moul_stepper_type;
+      typedef runge_kutta_cash_karp54<State> rkck54_error_stepper_type;
+      typedef runge_kutta_dopri5<State> dopri5_error_stepper_type;
+      
+      // Solve the ensemble
+      if (!mAdaptive) {
+         switch (mFixedStepper) {
+            case RK_4:
+               integrateFixed(rk4_stepper_type(), rhs, x, tMax, mStepSize, obs, active);
+               break;
+            case ADAM_BASH_MOUL:
+               integrateFixed(adams_bash_moul_stepper_type(), rhs, x, tMax, mStepSize, obs, active);
+               break;
+            default:
+               // Do nothing
+               break;
+         }
+      }
+      else {
+         switch (mAdaptiveStepper) {
+            case RK_CASH_KARP_54:
+               integrateControlled(make_controlled(mEpsAbs, mEpsRel, rkck54_error_stepper_type()), 
+                                   rhs, x, tMax, mStepSize, obs, active);
+               break;
+            case RK_DOPRI_5:
+            case RK_DOPRI_5_DENSE:
+               integrateControlled(make_controlled(mEpsAbs, mEpsRel, dopri5_error_stepper_type()), 
+                                   rhs, x, tMax, mStepSize, obs, active);
+               break;
+            default:
+               // Do nothing
+               break;
+         }
+      }
+      
+      // Ensure the initial states are updated to the final result
+      for (m=0; m<B; ++m) { member(x, B, m, initial[m]); }
+   }
+   
+   void SimulateEnsemble::simulate (vector<System*> &sys, double tMax, vector<State> &initial, EnsembleObserver &obs) {
+      vector<char> active;
+      simulate(sys, tMax, initial, obs, active);
+   }
+   
+   void SimulateEnsemble::simulate (System &sys, double tMax, vector<State> &initial, EnsembleObserver &obs) {
+      vector<System*> members(initial.size(), &sys);
+      vector<char> active;
+      simulate(members, tMax, initial, obs, active);
+   }
+   
+   void SimulateEnsemble::interleave (const vector<State> &states, State &x) {
+      int m, s, B = states.size(), n = (B > 0) ? states[0].size() : 0;
+      x.resize(n * B);
+      for (m=0; m<B; ++m) {
+         for (s=0; s<n; ++s) { x[s * B + m] = states[m][s]; }
+      }
+   }
+   
+   void SimulateEnsemble::member (const State &x, int members, int m, State &out) {
+      int s, n = x.size() / members;
+      out.resize(n);
+      for (s=0; s<n; ++s) { out[s] = x[s * members + m]; }
+   }
+   
+} // netevo namespace
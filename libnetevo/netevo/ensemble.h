@@ -0,0 +1,167 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_ENSEMBLE_H
+#define NE_ENSEMBLE_H
+
+#include "system.h"
+#include "compiled.h"
+#include "simulate.h"
+
+using namespace std;
+
+namespace netevo {
+   
+   /** Interleaved flat form of an ensemble of B Systems sharing the same structure (the same nodes, 
+    *  arcs and dynamics) that may differ in their arc weights and dynamic parameters.
+    *  The states of all members are held in a single vector in which state s of member m is at 
+    *  s*B + m, so the members of each state are contiguous and a kernel that loops over them 
+    *  (innermost) can be vectorised. Arc weights and parameters are interleaved in the same way
+    *  from the compiled form of each member. Everything else (in-arc offsets, state indexes and 
+    *  runs of dynamics) is shared and taken from the CompiledSystem of the first member. */
+   class CompiledEnsemble {
+   public:
+      /** Number of members (B) */
+      int members;
+      /** Structure shared by all the members */
+      CompiledSystem structure;
+      
+      /** Weight of each in-arc (see CompiledSystem::inWeight) for each member */
+      vector<double> inWeight;
+      /** Weight of each arc for each member */
+      vector<double> arcWeight;
+      /** Node parameter slots (slot k of node i for member m is at (k*nodes + i)*B + m) */
+      vector<double> nodeParams;
+      /** Arc parameter slots (laid out as for the node parameters) */
+      vector<double> arcParams;
+      /** Read in place of parameter slots that do not exist (zero) */
+      vector<double> zeroParams;
+      /** Number of node parameter slots (the most used by any member) */
+      int nodeSlots;
+      /** Number of arc parameter slots (the most used by any member) */
+      int arcSlots;
+      
+      /** Whether every run of dynamics has an ensemble implementation */
+      bool ensemble;
+      
+      CompiledEnsemble () : members(0), nodeSlots(0), arcSlots(0), ensemble(false) { }
+      
+      /** Build the interleaved form from each member (state IDs must be valid). Returns 0 if 
+       *  successful or 1 if the members do not share the same structure. */
+      int compile (vector<System*> &sys);
+      
+      /** Evaluate the ensemble kernels of every run (valid only if ensemble is set). */
+      void operator() (const State &x, State &dx, const double t);
+      
+      /** Start index (for member 0) of a node in the interleaved state vector */
+      int nodeStateID (int i) const { return structure.nodeStateID(i) * members; }
+      /** Start index (for member 0) of an arc in the interleaved state vector */
+      int arcStateID  (int i) const { return structure.arcStateID(i) * members; }
+      
+      /** Array of a node parameter slot (indexed by node ID * B + member). Slots that do not exist 
+       *  read as zero, so this is only NULL if there are no nodes. */
+      const double * nodeParam (int slot) const { 
+         if (structure.nodes == 0) { return NULL; }
+         return (slot < nodeSlots) ? &nodeParams[slot*structure.nodes*members] : &zeroParams[0]; 
+      }
+      /** Array of an arc parameter slot (indexed by arc ID * B + member, zero if it does not exist) */
+      const double * arcParam  (int slot) const { 
+         if (structure.arcs == 0) { return NULL; }
+         return (slot < arcSlots) ? &arcParams[slot*structure.arcs*members] : &zeroParams[0]; 
+      }
+   };
+   
+   /** Observer of an ensemble simulation. It is given the interleaved states of all members and 
+    *  may clear an entry of active to freeze that member (its states then stop changing and no 
+    *  longer affect the step size) for the rest of the simulation. */
+   class EnsembleObserver {
+   public:
+      /** This should be overwritten by any observer. By default does nothing. */
+      virtual void operator() (const State &x, int members, double t, vector<char> &active) { };
+   };
+   
+   /** Passes the states of each active member to its own SimObserver. If a limit is given, members 
+    *  with a state that is not finite or larger in magnitude than the limit are frozen. */
+   class EnsembleObserverMembers : public EnsembleObserver {
+   private:
+      vector<SimObserver*> mObs;
+      double               mLimit;
+      State                mX;
+   public:
+      /** One observer per member (NULL entries are not observed). A limit of 0 is ignored. */
+      EnsembleObserverMembers (vector<SimObserver*> obs, double limit = 0.0) : mObs(obs), mLimit(limit) { }
+      void operator() (const State &x, int members, double t, vector<char> &active);
+   };
+   
+   /** Simulates an ensemble of ODE Systems (or many initial conditions of one System) as a single
+    *  interleaved state vector (see CompiledEnsemble). One stepper integrates the whole ensemble, 
+    *  so its work vectors are allocated once and, if every dynamic has an ensemble kernel 
+    *  (see NodeDynamic::fnEnsemble), each kernel updates all members at once. Other dynamics are 
+    *  evaluated for each member in turn using that member's System. 
+    *  All members share the same time step. For the fixed step steppers this is the given step 
+    *  and for the adaptive steppers the error of every active member must be within tolerance
+    *  (observations are made every outputStep, as for SimulateOdeConst). Members can be frozen 
+    *  by the observer (see EnsembleObserver) or be inactive from the start, after which their 
+    *  derivatives are set to zero. Nothing is logged. */
+   class SimulateEnsemble {
+   public:
+      /** Fixed step integration (as SimulateOdeFixed). */
+      SimulateEnsemble (fixed_step_type_e stepper, double stepSize) { 
+         mAdaptive = false;
+         mFixedStepper = stepper;
+         mStepSize = stepSize;
+      };
+      /** Adaptive integration observed at a constant interval (as SimulateOdeConst). The dense 
+       *  output stepper is integrated as the controlled Dormand-Prince stepper. */
+      SimulateEnsemble (adaptive_step_type_e stepper, double epsAbs, double epsRel, double outputStep) { 
+         mAdaptive = true;
+         mAdaptiveStepper = stepper;
+         mEpsAbs = epsAbs;
+         mEpsRel = epsRel;
+         mStepSize = outputStep;
+      };
+      
+      /** Simulate one member for each System from the matching initial state. The initial states 
+       *  are updated to the final states. Active (if not empty) gives the members to simulate and 
+       *  is updated to those still active at the end. */
+      void simulate (vector<System*> &sys, double tMax, vector<State> &initial, EnsembleObserver &obs, 
+                     vector<char> &active);
+      void simulate (vector<System*> &sys, double tMax, vector<State> &initial, EnsembleObserver &obs);
+      /** Simulate a single System from many initial states. */
+      void simulate (System &sys, double tMax, vector<State> &initial, EnsembleObserver &obs);
+      
+      /** Interleave the states of the members into a single vector. */
+      static void interleave (const vector<State> &states, State &x);
+      /** Copy the states of a single member out of an interleaved vector. */
+      static void member (const State &x, int members, int m, State &out);
+      
+   private:
+      bool                 mAdaptive;
+      fixed_step_type_e    mFixedStepper;
+      adaptive_step_type_e mAdaptiveStepper;
+      double               mEpsAbs;
+      double               mEpsRel;
+      double               mStepSize;
+   };
+   
+} // netevo namespace
+
+#endif // NE_ENSEMBLE_H
@@ -39,5 +39,19 @@ namespace netevo {
          if (mRnd() < mProbDup)     { duplicate(sys, logger); }
       }
    }
+   
+   double StreamingPerformance::performance (System &sys, pair<vector<State>*,vector<double>*> *dyn) {
+      if (dyn == NULL) {
+         cerr << "No dynamics given (StreamingPerformance::performance)" << endl;
+         return 0.0;
+      }
+      SimReducer *r = reducer(sys);
+      for (size_t i=0; i<dyn->first->size(); ++i) {
+         (*r)((*dyn->first)[i], (*dyn->second)[i]);
+      }
+      double perf = result(sys, *r);
+      delete r;
+      return perf;
+   }
 
 } // netevo namespace
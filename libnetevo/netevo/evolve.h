@@ -23,6 +23,8 @@
 #define NE_EVOLVE_H
 
 #include "system.h"
+#include "simulate.h"
+#include "profile.h"
 #include <lemon/random.h>
 
 using namespace lemon;
@@ -39,6 +41,9 @@ namespace netevo {
    class Mutate {
    public:
       virtual void mutate (System &sys, ChangeLog &logger) = 0;
+      /** Seed any internal random number generator (used to continue a checkpointed run in the 
+       *  same way). By default does nothing. */
+      virtual void seedRnd (int seed) { }
    };
    
    class MutateRandom : public Mutate {
@@ -104,12 +109,87 @@ namespace netevo {
       virtual double performance (System &sys, pair<vector<State>*,vector<double>*> *dyn) = 0;
    };
    
+   /** A topology only performance measure that can be kept up to date as a System changes.
+    *  After reset the measure is attached to the System (see System::attach) and receives a 
+    *  ChangeLog event for every node and arc added or erased, from which currentPerformance should
+    *  be updated in sub-linear time. performance(sys, dyn) must still calculate the measure from 
+    *  scratch (without changing the tracked state) for Systems that are not being tracked. */
+   class IncrementalPerformance : public Performance, public ChangeLog {
+   public:
+      /** Incremental measures depend only on the topology. */
+      performance_type_e getType () { return TOPOLOGY_ONLY; }
+      /** Calculate the measure for a System from scratch, ready to track further changes to it. */
+      virtual void reset (System &sys) = 0;
+      /** The measure for the tracked System. */
+      virtual double currentPerformance () = 0;
+   };
+   
+   /** A dynamics performance measure that is calculated while the simulation runs, so that the 
+    *  trajectory never has to be stored. For each simulation reducer is called to create a new 
+    *  SimReducer (deleted by the caller) that observes the run, after which result gives the 
+    *  measure from it. performance(sys, dyn) replays a stored trajectory through a reducer. */
+   class StreamingPerformance : public Performance {
+   public:
+      /** Streaming measures require the dynamics. */
+      performance_type_e getType () { return DYNAMICS_ONLY; }
+      /** Create a reducer for a simulation of the System. */
+      virtual SimReducer * reducer (System &sys) = 0;
+      /** The measure once a simulation has been observed (by default the reducer result). */
+      virtual double result (System &sys, SimReducer &reducer) { return reducer.result(); }
+      /** Calculates the measure from a stored trajectory. */
+      double performance (System &sys, pair<vector<State>*,vector<double>*> *dyn);
+   };
+   
+   /** A streaming performance measure that can bound its result part way through a simulation. 
+    *  A run that can no longer give a good enough result may then be abandoned early (see 
+    *  EvolveSAParams::abandonProb). */
+   class BoundedPerformance : public StreamingPerformance {
+   public:
+      /** Lower bound on the result of a run (ending at tMax) from what its reducer has observed. */
+      virtual double lowerBound (System &sys, SimReducer &reducer, double tMax) = 0;
+      /** Lowest result that any run can give. */
+      virtual double minimum () = 0;
+   };
+   
    class EvoObserver {
    public:
       /** This should be overwritten by any observer. By default does nothing. */
       virtual void operator() (System &sys, double perf, int t) { };
    };
    
+   /** Receives the counters and timers of the Profile during an evolutionary process. */
+   class ProfileObserver {
+   public:
+      /** This should be overwritten by any observer. By default does nothing. */
+      virtual void operator() (const profile_data_t &data, int t) { };
+   };
+   
+   /** Writes each profile observed as a line of JSON (see Profile::writeJSON). */
+   class ProfileObserverJSON : public ProfileObserver {
+   private:
+      ostream &mOut;
+   public:
+      ProfileObserverJSON (ostream &outStream) : mOut(outStream) { }
+      void operator() (const profile_data_t &data, int t) { Profile::writeJSON(mOut, data); }
+   };
+   
+   /** Passes every observation on to another EvoObserver and a copy of the Profile to a 
+    *  ProfileObserver every so many iterations (the Profile is only filled if the library was 
+    *  built with NE_PROFILE, see Profile). */
+   class EvoObserverProfile : public EvoObserver {
+   private:
+      EvoObserver     &mObs;
+      ProfileObserver &mProf;
+      int              mEvery;
+   public:
+      EvoObserverProfile (EvoObserver &obs, ProfileObserver &prof, int every = 1) 
+         : mObs(obs), mProf(prof), mEvery((every < 1) ? 1 : every) { }
+      void operator() (System &sys, double perf, int t) {
+         mObs(sys, perf, t);
+         if (t % mEvery == 0) { mProf(Profile::instance().data(), t); }
+      }
+   };
+   
    class EvoInitialStates {
    public:
       /** A vector of initial states to be used during the evolutionary process. Called for each 
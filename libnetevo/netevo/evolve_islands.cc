@@ -0,0 +1,162 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "evolve_islands.h"
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace netevo {
+   
+   System * EvolveIslands::evolve (System &sys, Simulate &sim, EvoInitialStates &initial, EvoObserver &obs, ChangeLog &logger) {
+      int i, g, epoch;
+      int n = (mParams.islands < 1) ? 1 : mParams.islands;
+      int stage = (mParams.migrationIterations < 1) ? 1 : mParams.migrationIterations;
+      
+      if (mMut.empty()) {
+         cerr << "No mutation given (EvolveIslands::evolve)" << endl;
+         return NULL;
+      }
+      mMigrations = 0;
+      
+      // Each island has its own annealing process and random number streams
+      vector<lemon::Random> rnd(n);
+      vector<EvolveSA*> island(n);
+      vector<System*> curSys(n);
+      vector<evolve_sa_state_t> state(n);
+      vector<char> running(n), resumed(n, 0);
+      for (i=0; i<n; ++i) {
+         rnd[i].seed(mParams.rnd.integer(2147483647));
+         Mutate *mut = mMut[i % mMut.size()];
+         if (mMut.size() > 1) { mut->seedRnd(mParams.rnd.integer(2147483647)); }
+         island[i] = new EvolveSA(mSAParams, mQ, *mut);
+         island[i]->mRnd = &rnd[i];
+         island[i]->mIsland = true;
+         curSys[i] = new System();
+         curSys[i]->copySystem(sys);
+         island[i]->mCache.setCapacity(mSAParams.fitnessCache);
+         island[i]->track(curSys[i], mSAParams.batchTrials <= 1);
+      }
+      
+      // Islands are observed together and their changes are not logged
+      EvoObserver islandObs;
+      vector<ChangeLog> islandLog(n);
+      
+      // Islands sharing a Mutate (island i uses Mutate i % mMut.size()) form a group that is run 
+      // serially, in island order, so a Mutate is never called concurrently and the sequence of 
+      // calls it sees does not depend on the number of threads
+      int groups = min((int)mMut.size(), n);
+#ifdef _OPENMP
+      int threads = (mParams.threads > 0) ? mParams.threads : omp_get_max_threads();
+      if (threads > groups) { threads = groups; }
+#endif
+      
+      // Initial performance and temperature of every island
+#ifdef _OPENMP
+      #pragma omp parallel for private(i) schedule(dynamic) num_threads(threads) if(threads > 1)
+#endif
+      for (g=0; g<groups; ++g) {
+         for (i=g; i<n; i+=groups) {
+            running[i] = island[i]->start(curSys[i], state[i], sim, initial, islandObs, islandLog[i]);
+         }
+      }
+      
+      vector<vector<char> > buffers(n);
+      vector<double> Q(n);
+      int best = 0, active = n;
+      for (epoch=0; active > 0; ++epoch) {
+         
+         // Run every island for a stage (islands that have stopped are left as they are)
+#ifdef _OPENMP
+         #pragma omp parallel for private(i) schedule(dynamic) num_threads(threads) if(threads > 1)
+#endif
+         for (g=0; g<groups; ++g) {
+            for (i=g; i<n; i+=groups) {
+               if (running[i]) {
+                  bool done = island[i]->anneal(curSys[i], state[i], resumed[i], sim, initial, islandObs, 
+                                                islandLog[i], state[i].iteration + stage);
+                  running[i] = !done;
+                  resumed[i] = 1;
+               }
+            }
+         }
+         
+         // Migrate the current Systems
+         for (i=0; i<n; ++i) {
+            curSys[i]->saveBinary(buffers[i]);
+            Q[i] = state[i].Q1;
+         }
+         exchange(buffers, Q, epoch);
+         active = 0;
+         for (i=0; i<n; ++i) {
+            if (running[i] && !buffers[i].empty() && Q[i] < state[i].Q1) {
+               if (curSys[i]->openBinary(&buffers[i][0], buffers[i].size()) == 0) {
+                  state[i].Q1 = Q[i];
+                  mMigrations++;
+               }
+               island[i]->track(curSys[i], mSAParams.batchTrials <= 1);
+            }
+            if (running[i]) { active++; }
+         }
+         
+         // Observe the best System
+         int iterations = 0;
+         best = 0;
+         for (i=0; i<n; ++i) {
+            iterations += state[i].iteration;
+            if (state[i].Q1 < state[best].Q1) { best = i; }
+         }
+         obs(*curSys[best], state[best].Q1, iterations);
+         logger.endStep(EVO_STEP);
+         logger.commit();
+      }
+      
+      // Keep the best System
+      System *result = curSys[best];
+      for (i=0; i<n; ++i) {
+         island[i]->track(NULL, false);
+         if (i != best) { delete curSys[i]; }
+         delete island[i];
+      }
+      return result;
+   }
+   
+   void EvolveIslands::exchange (vector<vector<char> > &buffers, vector<double> &Q, int epoch) {
+      
+      // Pass every System on to the next island in the ring
+      int n = buffers.size();
+      if (n < 2) {
+         if (n == 1) { buffers[0].clear(); }
+         return;
+      }
+      vector<char> last;
+      last.swap(buffers[n-1]);
+      double lastQ = Q[n-1];
+      for (int i=n-1; i>0; --i) {
+         buffers[i].swap(buffers[i-1]);
+         Q[i] = Q[i-1];
+      }
+      buffers[0].swap(last);
+      Q[0] = lastQ;
+   }
+   
+} // netevo namespace
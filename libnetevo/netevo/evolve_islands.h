@@ -0,0 +1,107 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_EVOLVE_ISLANDS_H
+#define NE_EVOLVE_ISLANDS_H
+
+#include "system.h"
+#include "simulate.h"
+#include "evolve.h"
+#include "evolve_sa.h"
+#include <lemon/random.h>
+
+namespace netevo {
+   
+   /** Object encapsulating the parameters for the island model (see EvolveIslands) */
+   class EvolveIslandsParams {
+   public:
+      /** Number of islands */
+      int islands;
+      /** Iterations each island runs between migrations */
+      int migrationIterations;
+      /** Number of threads used to run the islands (0 = OpenMP default) */
+      int threads;
+      /** Seed for the random number generator (each island is seeded from it) */
+      lemon::Random rnd;
+      
+      /** Constructor that generates default parameter values. */
+      EvolveIslandsParams () {
+         islands             = 4;
+         migrationIterations = 100;
+         threads             = 0;
+         rnd.seed();
+      }
+   };
+   
+   /** Island model of simulated annealing.
+    *  Each island is an independent EvolveSA chain (using the EvolveSAParams given, with its own 
+    *  random number generator seeded from EvolveIslandsParams::rnd) that starts from a copy of 
+    *  the System. The islands run in parallel (when OpenMP is available) for 
+    *  migrationIterations iterations at a time, after which the current System of every island is 
+    *  saved as a binary snapshot (see System::saveBinary) and exchanged. By default the islands 
+    *  form a ring and each receives the System of the previous island, replacing its own if the 
+    *  migrant performs better. The exchange only deals in snapshots so a subclass can move them 
+    *  between processes instead (e.g. MPI ranks each running some of the islands). Islands 
+    *  stop when their own annealing process does and the run ends when every island has stopped.
+    *  For a given seed the result does not depend on the number of threads.
+    *  
+    *  The Performance, Simulate and EvoInitialStates objects are shared and must be safe to call 
+    *  concurrently on different Systems (as for batches in EvolveSA). Island i uses Mutate 
+    *  i % mut.size() (each is seeded when the run starts if more than one is given). Islands that 
+    *  share a Mutate are run one after another, so give one Mutate per island for the islands to 
+    *  run fully in parallel. The observer is called after each migration 
+    *  with the best System of all islands and the total number of iterations made. As the islands 
+    *  change different Systems at the same time their changes are not logged, the ChangeLog is 
+    *  only sent an EVO_STEP (and committed) after each migration. Changes are not tracked by 
+    *  incremental performance measures and EvolveSAParams::checkpointIterations is ignored. Each 
+    *  island has its own FitnessCache (if EvolveSAParams::fitnessCache is set). */
+   class EvolveIslands {
+   private:
+      EvolveIslandsParams &mParams;
+      EvolveSAParams      &mSAParams;
+      Performance         &mQ;
+      vector<Mutate*>      mMut;
+      
+      /** Migrants accepted during the last run */
+      int mMigrations;
+      
+   protected:
+      /** Exchange migrants between the islands. On entry buffers[i] holds a snapshot of the 
+       *  current System of island i and Q[i] its performance, on return they should hold the 
+       *  migrant offered to island i (an empty buffer if there is none). */
+      virtual void exchange (vector<vector<char> > &buffers, vector<double> &Q, int epoch);
+      
+   public:
+      EvolveIslands (EvolveIslandsParams &params, EvolveSAParams &saParams, Performance &Q, 
+                     vector<Mutate*> &mut) : mParams(params), mSAParams(saParams), mQ(Q), mMut(mut), 
+                                             mMigrations(0) { }
+      virtual ~EvolveIslands () { }
+      
+      /** Evolve a System, returning the best System found (to be deleted by the caller). */
+      System * evolve (System &sys, Simulate &sim, EvoInitialStates &initial, EvoObserver &obs, ChangeLog &logger);
+      
+      /** Migrants accepted during the last run */
+      int migrations () { return mMigrations; }
+   };
+   
+} // netevo namespace
+
+#endif // NE_EVOLVE_ISLANDS_H
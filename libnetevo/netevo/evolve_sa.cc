@@ -19,26 +19,111 @@
  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
  ============================================================================*/
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "evolve_sa.h"
+#include "mapped_file.h"
+#include "profile.h"
 #include <lemon/random.h>
+#include <cstdio>
+#include <cstring>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace netevo {
    
-   System * EvolveSA::evolve (System &sys, Simulate &sim, EvoInitialStates &initial, EvoObserver &obs, ChangeLog &logger) {
+   const char     SA_CHECKPOINT_MAGIC[8] = { 'N', 'E', 'T', 'E', 'V', 'O', 'S', 'A' };
+   const uint32_t SA_CHECKPOINT_VERSION  = 1;
+   
+   /** Passes the observations of a run on to the reducer of a BoundedPerformance and stops the 
+    *  run once the lower bound of the trial performance (from this run and the lowest total 
+    *  the other runs can give) would almost certainly be rejected. */
+   class SimObserverAbandon : public SimObserver {
+   private:
+      System             &mSys;
+      BoundedPerformance &mQ;
+      SimReducer         &mReducer;
+      EvolveSAParams     &mParams;
+      double              mOthers;
+      int                 mRuns;
+      double              mQ1;
+      double              mTemp;
+      bool                mStopped;
+      double              mBound;
+   public:
+      SimObserverAbandon (System &sys, BoundedPerformance &Q, SimReducer &reducer, EvolveSAParams &params, 
+                          double others, int runs, double Q1, double temp) 
+         : mSys(sys), mQ(Q), mReducer(reducer), mParams(params), mOthers(others), mRuns(runs), 
+           mQ1(Q1), mTemp(temp), mStopped(false), mBound(0.0) { }
       
-      // Declare variables
-      int iteration, i, accepts;
-      double temp, minQ, maxQ, initialPerf, tempQ;
-      bool noChange;
-      evolve_sa_result_t result;
+      void operator() (const State &x, double t) { mReducer(x, t); }
+      void stateDelta (const State &x, const vector<int> &changed, double t) { mReducer.stateDelta(x, changed, t); }
+      bool stop () {
+         double runBound = mQ.lowerBound(mSys, mReducer, mParams.simTMax);
+         double bound = (mOthers + runBound) / mRuns;
+         if (bound > mQ1 && mParams.acceptProb(bound - mQ1, mTemp) < mParams.abandonProb) {
+            mStopped = true;
+            mBound = runBound;
+         }
+         return mStopped;
+      }
       
-      // Systems to hold the current and trail systems
+      /** Whether the run was stopped early */
+      bool stopped () { return mStopped; }
+      /** Lower bound on the result of the run when it was stopped */
+      double bound () { return mBound; }
+   };
+   
+   System * EvolveSA::evolve (System &sys, Simulate &sim, EvoInitialStates &initial, EvoObserver &obs, ChangeLog &logger) {
+      
+      // Systems to hold the current system
       System *curSys = new System();
-      System *newSys, *tempSys;
       
       // Copy the current system
       curSys->copySystem(sys);
-      tempSys = curSys;
+      
+      // Batches must contain at least one trial
+      int batchSize = (mParams.batchTrials < 1) ? 1 : mParams.batchTrials;
+      
+      // Incremental performance measures can track the current System when trials are made in place
+      mCache.clear();
+      mCache.setCapacity(mParams.fitnessCache);
+      track(curSys, batchSize == 1);
+      
+      // Ensure the temperature does not start at 0
+      evolve_sa_state_t state;
+      if (start(curSys, state, sim, initial, obs, logger)) {
+         anneal(curSys, state, false, sim, initial, obs, logger);
+      }
+      
+      // Stop tracking the System
+      track(NULL, false);
+      
+      // Return the evolved System
+      return curSys;
+   }
+   
+   bool EvolveSA::start (System *curSys, evolve_sa_state_t &state, Simulate &sim, EvoInitialStates &initial, 
+                         EvoObserver &obs, ChangeLog &logger) {
+      
+      // Declare variables
+      int iteration, i, j, batch;
+      double temp, minQ, maxQ, initialPerf;
+      evolve_sa_result_t result;
+      vector<System*> candidates;
+      vector<double> candQ;
+      vector<bool> candValid;
+      System *tempSys;
+      
+      // Batches must contain at least one trial
+      int batchSize = (mParams.batchTrials < 1) ? 1 : mParams.batchTrials;
+      
+      // Serial trials are made in place and rolled back if rejected (no copies are needed)
+      bool inPlace = (batchSize == 1);
+      ChangeLogDelta delta(logger);
       
       // Initise the results structure
       result.Q1 = 0.0;
@@ -53,180 +138,532 @@ namespace netevo {
       // Calculate the initial performance of the System
       initialPerf = performance(*curSys, sim, initial);
       result.Q1 = initialPerf;
+      if (mCache.capacity() > 0) { mCache.insert(SystemHash::hash(*curSys), initialPerf); }
       
       // Record the initial iteration
       obs(*curSys, initialPerf, iteration);
       
-      // Run the initial trials to estimate starting temperature (these are not observed)
+      // Run the initial trials to estimate starting temperature (these are not observed). Each trial
+      // mutates the previous one so candidates are generated as a chain and then evaluated together.
       minQ = initialPerf;
       maxQ = initialPerf;
-      for (i=0; i<mParams.initialTrials; ++i) {
-         
-         cout << "Initial Trail: " << i+1 << endl;
+      tempSys = curSys;
+      if (inPlace) { curSys->beginDelta(); }
+      for (i=0; i<mParams.initialTrials; i+=batch) {
          
-         // Generate a new System
-         newSys = trial(temp, *tempSys, sim, initial, result, logger);
+         batch = min(batchSize, mParams.initialTrials - i);
+         candidates.clear();
+         for (j=0; j<batch; ++j) {
+            cout << "Initial Trail: " << i+j+1 << endl;
+            if (inPlace) {
+               trial(*curSys, delta);
+            }
+            else {
+               tempSys = candidate(*tempSys, logger);
+            }
+            candidates.push_back(tempSys);
+         }
          
-         // Free memory
-         if (i > 0) { delete(tempSys); }
+         // Estimate the performance of the batch
+         evaluate(candidates, candQ, candValid, sim, initial);
          
          // Keep track of max and min performances
-         if (result.Q2 < minQ) { minQ = result.Q2; }
-         if (result.Q2 > maxQ) { maxQ = result.Q2; }
+         for (j=0; j<batch; ++j) {
+            if (candValid[j]) {
+               if (candQ[j] < minQ) { minQ = candQ[j]; }
+               if (candQ[j] > maxQ) { maxQ = candQ[j]; }
+            }
+         }
          
-         // Swap System pointers
-         tempSys = newSys;
+         // Free memory (keeping the end of the chain for the next batch)
+         if (!inPlace) {
+            for (j=0; j<batch-1; ++j) { mPool.release(candidates[j]); }
+         }
       }
       
-      // Free used memory
-      delete(newSys);
+      // Return to the initial System and free used memory
+      if (inPlace) {
+         curSys->rollbackDelta();
+         logger.rollback();
+      }
+      else if (tempSys != curSys) {
+         mPool.release(tempSys);
+      }
       
       // Set the initial temperature
       temp = mParams.initialTemperature(minQ, maxQ);
       
-      // Start the SA process properly
-      noChange = false;
+      state.iteration = iteration;
+      state.trial     = 0;
+      state.accepts   = 0;
+      state.noChange  = 0;
+      state.temp      = temp;
+      state.Q1        = result.Q1;
+      state.Q2        = result.Q2;
+      return (temp > 0.0);
+   }
+   
+   System * EvolveSA::resume (string filename, System &sys, Simulate &sim, EvoInitialStates &initial, 
+                              EvoObserver &obs, ChangeLog &logger) {
+      MappedFile file;
+      sa_checkpoint_t head;
       
-      // Ensure the temperature does not start at 0
-      if ( temp > 0.0 ) {
+      if (file.open(filename) != 0) { return NULL; }
+      if (file.size() < sizeof(sa_checkpoint_t)) {
+         cerr << "Checkpoint is too small (EvolveSA::resume)" << endl;
+         return NULL;
+      }
+      memcpy(&head, file.data(), sizeof(sa_checkpoint_t));
+      if (memcmp(head.magic, SA_CHECKPOINT_MAGIC, 8) != 0 || head.version != SA_CHECKPOINT_VERSION) {
+         cerr << "Not a checkpoint of this version (EvolveSA::resume)" << endl;
+         return NULL;
+      }
+      
+      // The System passed in provides the dynamics (the saved System replaces its structure)
+      System *curSys = new System();
+      curSys->copySystem(sys);
+      if (curSys->openBinary(file.data() + sizeof(sa_checkpoint_t), file.size() - sizeof(sa_checkpoint_t)) != 0) {
+         delete curSys;
+         return NULL;
+      }
+      
+      // Continue with the random number streams started when the checkpoint was written
+      mRnd->seed(head.state.paramsSeed);
+      mMut.seedRnd(head.state.mutateSeed);
+      
+      int batchSize = (mParams.batchTrials < 1) ? 1 : mParams.batchTrials;
+      mCache.clear();
+      mCache.setCapacity(mParams.fitnessCache);
+      track(curSys, batchSize == 1);
+      anneal(curSys, head.state, true, sim, initial, obs, logger);
+      track(NULL, false);
+      return curSys;
+   }
+   
+   int EvolveSA::checkpoint (System *&curSys, evolve_sa_state_t &state) {
+      vector<char> buffer;
+      sa_checkpoint_t head;
+      
+      // New random number streams are started from every checkpoint, so that the run can be 
+      // continued exactly without access to the internal state of the generators
+      state.paramsSeed = mRnd->integer(2147483647);
+      state.mutateSeed = mRnd->integer(2147483647);
+      
+      memset(&head, 0, sizeof(sa_checkpoint_t));
+      memcpy(head.magic, SA_CHECKPOINT_MAGIC, 8);
+      head.version = SA_CHECKPOINT_VERSION;
+      head.state = state;
+      
+      // Write to a temporary file and then move it into place so that a job stopped part way 
+      // through writing leaves the last checkpoint intact
+      curSys->saveBinary(buffer);
+      string tmpFile = mParams.checkpointFile + ".tmp";
+      ofstream out(tmpFile.c_str(), ios::out | ios::binary | ios::trunc);
+      int err = 0;
+      if (out.is_open()) {
+         out.write((const char *)&head, sizeof(sa_checkpoint_t));
+         out.write(&buffer[0], buffer.size());
+         out.close();
+      }
+      if (!out.good() || rename(tmpFile.c_str(), mParams.checkpointFile.c_str()) != 0) {
+         cerr << "Could not write checkpoint " << mParams.checkpointFile << " (EvolveSA::checkpoint)" << endl;
+         err = -1;
+      }
+      
+      // Carry on from the saved System and streams exactly as a resumed run would
+      curSys->openBinary(&buffer[0], buffer.size());
+      if (mIncQ != NULL) { mIncQ->reset(*curSys); }
+      if (mHash.system() != NULL) { mHash.reset(curSys); }
+      mRnd->seed(state.paramsSeed);
+      mMut.seedRnd(state.mutateSeed);
+      return err;
+   }
+   
+   void EvolveSA::track (System *sys, bool inPlace) {
+      if (mIncQ != NULL && mIncSys != NULL) {
+         mIncSys->detach(mIncQ);
+      }
+      mIncQ = (sys != NULL && inPlace && !mIsland) ? dynamic_cast<IncrementalPerformance*>(&mQ) : NULL;
+      mIncSys = NULL;
+      if (mIncQ != NULL) {
+         mIncQ->reset(*sys);
+         sys->attach(mIncQ);
+         mIncSys = sys;
+      }
+      
+      // The hash of a System changed in place is kept up to date for the cache
+      mHash.reset((sys != NULL && inPlace && mCache.capacity() > 0) ? sys : NULL);
+   }
+   
+   bool EvolveSA::anneal (System *&curSys, evolve_sa_state_t &state, bool resumed, Simulate &sim, 
+                          EvoInitialStates &initial, EvoObserver &obs, ChangeLog &logger, int stopIteration) {
+      int i, j, k, batch = 0;
+      double tempQ;
+      evolve_sa_result_t result;
+      vector<System*> candidates;
+      vector<double> candQ;
+      vector<bool> candValid, candAbandoned;
+      int batchSize = (mParams.batchTrials < 1) ? 1 : mParams.batchTrials;
+      bool inPlace = (batchSize == 1);
+      ChangeLogDelta delta(logger);
+      
+      // The annealing state (kept in one place so that it can be checkpointed)
+      int &iteration = state.iteration, &accepts = state.accepts, &noChange = state.noChange;
+      double &temp = state.temp;
+      int lastCheckpoint = iteration;
+      result.Q1 = state.Q1;
+      result.Q2 = state.Q2;
+      result.dQ = 0.0;
+      result.a  = false;
+      
+      // Check the conditions to continue the search
+      while (noChange <= mParams.acceptRunsNoChange && 
+             temp > mParams.minTemp && 
+             iteration <= mParams.maxIterations) {
          
-         // Check the conditions to continue the search
-         while (noChange <= mParams.acceptRunsNoChange && 
-                temp > mParams.minTemp && 
-                iteration <= mParams.maxIterations) {
-            
-            /* Run for mainTrials more trials or acceptTrials accepting trials */
+         /* Run for mainTrials more trials or acceptTrials accepting trials (a resumed run 
+            continues part way through) */
+         if (!resumed) {
             accepts = 0;
-            for ( i=0; i<mParams.mainTrials; i++ ) {
-               
+            state.trial = 0;
+         }
+         resumed = false;
+         for ( i=state.trial; i<mParams.mainTrials; i+=batch ) {
+            
+            /* Stop part way through (to be continued as if resumed) */
+            if (stopIteration >= 0 && iteration >= stopIteration) {
+               state.trial = i;
+               state.Q1 = result.Q1;
+               state.Q2 = result.Q2;
+               return false;
+            }
+            
+            /* Save the state periodically (between batches) */
+            if (!mIsland && mParams.checkpointIterations > 0 && 
+                iteration - lastCheckpoint >= mParams.checkpointIterations) {
+               state.trial = i;
+               state.Q1 = result.Q1;
+               state.Q2 = result.Q2;
+               checkpoint(curSys, state);
+               lastCheckpoint = iteration;
+            }
+            
+            /* Check if we have reached the maximum number of iterations */
+            if (iteration >= mParams.maxIterations) {
                iteration++;
+               break;
+            }
+            
+            /* Generate a batch of independent trials from the current System */
+            batch = min(batchSize, min(mParams.mainTrials - i, mParams.maxIterations - iteration));
+            candidates.clear();
+            if (inPlace) {
+               curSys->beginDelta();
+               trial(*curSys, delta);
+               candidates.push_back(curSys);
+            }
+            else {
+               for (j=0; j<batch; ++j) {
+                  candidates.push_back(candidate(*curSys, logger));
+               }
+            }
+            NE_PROFILE_COUNT(PROF_TRIALS, candidates.size());
+            evaluate(candidates, candQ, candValid, sim, initial, result.Q1, temp, &candAbandoned);
+            
+            /* Decide on each trial in order, the first accepted trial replaces the current 
+               System and the remaining trials (generated from the old System) are discarded */
+            for (j=0; j<batch; ++j) {
                
-               /* Check if we have reached the maximum number of iterations */
-               if (iteration > mParams.maxIterations) {
-                  break;
-               }				
+               iteration++;
                
-               /* Run a trail */
-               newSys = trial(temp, *curSys, sim, initial, result, logger);
+               result.a = false;
+               if (candValid[j]) {
+                  result.Q2 = candQ[j];
+                  accept(temp, result);
+                  // Only a bound is known for an abandoned trial, so it is always rejected (the 
+                  // random number is still drawn to keep the sequence independent of performance)
+                  if (candAbandoned[j]) { result.a = false; }
+               }
+               NE_PROFILE_DECISION(temp, result.a);
                
                /* Check to see if accepted and output result */
                if ( result.a == true ){
-                  delete(curSys);
-                  curSys = newSys;
+                  if (inPlace) {
+                     curSys->commitDelta();
+                     logger.commit();
+                  }
+                  else {
+                     mPool.release(curSys);
+                     curSys = candidates[j];
+                     for (k=j+1; k<batch; ++k) { mPool.release(candidates[k]); }
+                  }
                   tempQ = result.Q1;
                   result.Q1 = result.Q2;
                   result.Q2 = tempQ;
                }
                else{
-                  delete(newSys);
+                  if (inPlace) {
+                     curSys->rollbackDelta();
+                     logger.rollback();
+                  }
+                  else {
+                     mPool.release(candidates[j]);
+                  }
                }
                
                // Observe the current System
                obs(*curSys, result.Q1, iteration);
                
                /* Update accepting counters */
-               if ( result.a == true ){ accepts++; }
-               if ( accepts >= mParams.acceptTrials ) { break; }
+               if ( result.a == true ){ accepts++; break; }
             }
             
-            /* Update the counter to check if no changes are made at lower temps */
-            if ( accepts == 0 ) { noChange++; }
-            else { noChange = 0; }
-            
-            /* Reduce temperature */
-            temp = mParams.newTemperature(temp, result.Q1, result.Q2);
+            /* Only count the trials that were used */
+            if (j < batch) { batch = j + 1; }
+            if ( accepts >= mParams.acceptTrials ) { break; }
          }
+         
+         /* Update the counter to check if no changes are made at lower temps */
+         if ( accepts == 0 ) { noChange++; }
+         else { noChange = 0; }
+         
+         /* Reduce temperature */
+         temp = mParams.newTemperature(temp, result.Q1, result.Q2);
       }
-      
-      // Return the evolved System
-      return curSys;
+      state.Q1 = result.Q1;
+      state.Q2 = result.Q2;
+      return true;
    }
    
-   System * EvolveSA::trial (double temp, System &sys, Simulate &sim, EvoInitialStates &initial, evolve_sa_result_t &result, ChangeLog &logger) {
+   System * EvolveSA::candidate (System &sys, ChangeLog &logger) {
       
-      // Don't accept by default
-      result.a = false;
+      // Make a copy of the system for the trial (reusing the storage of discarded trials)
+      System *newSys = mPool.acquire();
+      {
+         NE_PROFILE_SCOPE(PROF_COPY);
+         newSys->copySystem(sys);
+      }
+      
+      // Mutate the copy
+      trial(*newSys, logger);
       
-      // Make a copy of the system for the trial
-      System *newSys = new System();
-      newSys->copySystem(sys);
+      return newSys;
+   }
+   
+   void EvolveSA::trial (System &sys, ChangeLog &logger) {
       
-      // Mutate the System
-      mMut.mutate(*newSys, logger);
+      // Give the trial its own random number stream so that results do not depend on the
+      // order in which trials are evaluated
+      sys.seedRnd(mRnd->integer(2147483647));
       
-      // Check if network needs to be connected
+      // Mutate the System (mutation is always performed serially)
+      NE_PROFILE_SCOPE(PROF_MUTATE);
+      mMut.mutate(sys, logger);
+   }
+   
+   void EvolveSA::evaluate (vector<System*> &candidates, vector<double> &Q, vector<bool> &valid, 
+                            Simulate &sim, EvoInitialStates &initial, double Q1, double temp, 
+                            vector<bool> *abandoned) {
+      int n = candidates.size();
+      Q.assign(n, 0.0);
+      valid.assign(n, true);
+      vector<char> stopped(n, 0);
+      
+      // Check if network needs to be connected (we just want to check there are no isolated nodes)
       if (mParams.ensureWeaklyConnected) {
-         // We just want to check there are no isolated nodes (weakly connected)
-         if (newSys->weaklyConnectedComponents() != 1) {
-            return newSys;
+         for (int i=0; i<n; ++i) {
+            valid[i] = (candidates[i]->weaklyConnectedComponents() == 1);
+         }
+      }
+      
+      // Reuse the performance of Systems that have already been evaluated
+      vector<uint64_t> hash(n, 0);
+      vector<char> cached(n, 0);
+      if (mCache.capacity() > 0) {
+         for (int i=0; i<n; ++i) {
+            if (valid[i]) {
+               hash[i] = (candidates[i] == mHash.system()) ? mHash.value() : SystemHash::hash(*candidates[i]);
+               cached[i] = mCache.find(hash[i], Q[i]);
+            }
+         }
+      }
+      
+      // Estimate the new performances (in parallel if possible)
+#ifdef _OPENMP
+      int threads = (mParams.threads > 0) ? mParams.threads : omp_get_max_threads();
+      if (threads > n) { threads = n; }
+      #pragma omp parallel for schedule(dynamic) num_threads(threads) if(threads > 1)
+#endif
+      for (int i=0; i<n; ++i) {
+         if (valid[i] && !cached[i]) {
+            bool abandon = false;
+            Q[i] = performance(*candidates[i], sim, initial, Q1, temp, &abandon);
+            // Only the bound is known for abandoned trials so they are not cached
+            if (abandon) {
+               cached[i] = 1;
+               stopped[i] = 1;
+            }
+         }
+      }
+      
+      if (mCache.capacity() > 0) {
+         for (int i=0; i<n; ++i) {
+            if (valid[i] && !cached[i]) { mCache.insert(hash[i], Q[i]); }
          }
       }
+      if (abandoned != NULL) { abandoned->assign(stopped.begin(), stopped.end()); }
+   }
+   
+   bool EvolveSA::accept (double temp, evolve_sa_result_t &result) {
       
-      // Estimate the new performance
-      result.Q2 = performance(sys, sim, initial);
+      // Always draw from the random number generator so that its sequence does not depend on
+      // the performance of earlier trials
+      double r = (*mRnd)();
       
-      // Decide if this should be selected
-      result.dQ =  result.Q1 - result.Q2;
-      if (result.dQ > 0.0) {
+      // Decide if this should be selected (smaller is better)
+      result.a = false;
+      result.dQ = result.Q2 - result.Q1;
+      if (result.dQ < 0.0) {
          // Accept as improvement
-			result.a = true;
-		}
-		else {
-			// To ensure no divide by zero
-			if (temp != 0.0 && temp > 0.0) {
-				// Calculate probability of still accepting
-				if (mParams.rnd() <= mParams.acceptProb(result.dQ, temp)) {
-					// Make change even though worse performance
-					result.a = true;
-				}
-			}
+         result.a = true;
+      }
+      else {
+         // To ensure no divide by zero
+         if (temp > 0.0) {
+            // Calculate probability of still accepting
+            if (r <= mParams.acceptProb(result.dQ, temp)) {
+               // Make change even though worse performance
+               result.a = true;
+            }
+         }
          else {
             // Don't accept and warn of error
-            cerr << "Divide by zero avoided (EvolveSA::trial)" << endl;
+            cerr << "Divide by zero avoided (EvolveSA::accept)" << endl;
          }
-		}
-      
-      // Return the new System (caller will decide whether to use or not)
-      return newSys;
+      }
+      return result.a;
    }
    
-   double EvolveSA::performance (System &sys, Simulate &sim, EvoInitialStates &initial) {
+   double EvolveSA::performance (System &sys, Simulate &sim, EvoInitialStates &initial, double Q1, 
+                                 double temp, bool *abandoned) {
+      NE_PROFILE_SCOPE(PROF_PERFORMANCE);
       
       // Start with a bad performance (smaller is better)
       double perf = 100000000000.0;
       
       // Declare other variables
-      int numOfSims, qSum;
+      int numOfSims;
+      double qSum, qErr, y, t;
       vector<State> initialConds;
-      vector<double> tOut;
-      vector<State> xOut;
-      SimObserverToVectors simObs(xOut, tOut);
-      ChangeLog chLog;
+      vector<double> runQ;
+      StreamingPerformance *streamQ = dynamic_cast<StreamingPerformance *>(&mQ);
+      
+      // Runs can be abandoned once the trial would almost certainly be rejected
+      BoundedPerformance *boundQ = NULL;
+      if (mParams.abandonProb > 0.0 && temp > 0.0) { boundQ = dynamic_cast<BoundedPerformance *>(&mQ); }
+      vector<char> runStopped;
       
       // Find the performance type and simulate dynamics if necessary
       switch (mQ.getType()) {
          case TOPOLOGY_ONLY:
-            // No need to simulate the dynamics
-            perf = mQ.performance(sys, NULL);
+            // No need to simulate the dynamics (or even recalculate if tracking the System)
+            if (mIncQ != NULL && &sys == mIncSys) {
+               perf = mIncQ->currentPerformance();
+            }
+            else {
+               perf = mQ.performance(sys, NULL);
+            }
             break;
          
          case DYNAMICS_ONLY:
          case TOPOLOGY_AND_DYNAMICS:
             // Have to simulate the dynamics to estimate performance
-            qSum = 0.0;
             initialConds = initial.initialStates(sys);
 
             numOfSims = initialConds.size();
             if (numOfSims > 0) {
+               
+               // The System is shared between runs so make sure the state IDs are valid first
+               if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
+               
+               // Simulate each initial state (in parallel if possible)
+               runQ.assign(numOfSims, 0.0);
+               runStopped.assign(numOfSims, 0);
+               bool serialSims = true;
+#ifdef _OPENMP
+               int threads = (mParams.threads > 0) ? mParams.threads : omp_get_max_threads();
+               if (threads > numOfSims) { threads = numOfSims; }
+               serialSims = !(mParams.parallelSims && threads > 1);
+               #pragma omp parallel for schedule(dynamic) num_threads(threads) if(!serialSims)
+#endif
+               for (int i=0; i<numOfSims; ++i) {
+                  ChangeLog chLog;
+                  if (boundQ != NULL) {
+                     // Once a serial run is abandoned the rest need not be simulated
+                     if (serialSims && i > 0 && runStopped[i-1]) {
+                        runQ[i] = boundQ->minimum();
+                        runStopped[i] = 1;
+                        continue;
+                     }
+                     // Lowest total the other runs can give (earlier serial runs are known)
+                     double others = (numOfSims - 1) * boundQ->minimum();
+                     if (serialSims) {
+                        for (int j=0; j<i; ++j) { others += runQ[j] - boundQ->minimum(); }
+                     }
+                     SimReducer *reducer = boundQ->reducer(sys);
+                     SimObserverAbandon simObs(sys, *boundQ, *reducer, mParams, others, numOfSims, Q1, temp);
+                     {
+                        NE_PROFILE_SCOPE(PROF_SIMULATE);
+                        sim.simulate(sys, mParams.simTMax, initialConds[i], simObs, chLog);
+                     }
+                     if (simObs.stopped()) {
+                        runQ[i] = simObs.bound();
+                        runStopped[i] = 1;
+                     }
+                     else {
+                        runQ[i] = boundQ->result(sys, *reducer);
+                     }
+                     delete reducer;
+                  }
+                  else if (streamQ != NULL) {
+                     // Reduce the run as it is simulated (nothing is stored)
+                     SimReducer *simObs = streamQ->reducer(sys);
+                     {
+                        NE_PROFILE_SCOPE(PROF_SIMULATE);
+                        sim.simulate(sys, mParams.simTMax, initialConds[i], *simObs, chLog);
+                     }
+                     runQ[i] = streamQ->result(sys, *simObs);
+                     delete simObs;
+                  }
+                  else {
+                     vector<double> tOut;
+                     vector<State> xOut;
+                     SimObserverToVectors simObs(xOut, tOut);
+                     {
+                        NE_PROFILE_SCOPE(PROF_SIMULATE);
+                        sim.simulate(sys, mParams.simTMax, initialConds[i], simObs, chLog);
+                     }
+                     pair<vector<State>*,vector<double>*> dyn(&xOut,&tOut);
+                     runQ[i] = mQ.performance(sys, &dyn);
+                  }
+               }
+               
+               // Reduce in a fixed order using compensated summation
+               qSum = 0.0;
+               qErr = 0.0;
                for (int i=0; i<numOfSims; ++i) {
-                  State &runInit = initialConds[i];
-                  sim.simulate(sys, mParams.simTMax, initialConds[i], simObs, chLog);
-                  pair<vector<State>*,vector<double>*> dyn(&xOut,&tOut);
-                  qSum += mQ.performance(sys, &dyn);
-                  tOut.clear();
-                  xOut.clear();
+                  y = runQ[i] - qErr;
+                  t = qSum + y;
+                  qErr = (t - qSum) - y;
+                  qSum = t;
+               }
+               perf = qSum/numOfSims;
+               
+               if (abandoned != NULL) {
+                  for (int i=0; i<numOfSims; ++i) {
+                     if (runStopped[i]) { *abandoned = true; }
+                  }
                }
-               perf = qSum/initialConds.size();
             }
             break;
          
@@ -25,7 +25,9 @@
 #include "system.h"
 #include "simulate.h"
 #include "evolve.h"
+#include "fitness_cache.h"
 #include <lemon/random.h>
+#include <stdint.h>
 
 namespace netevo {
 
@@ -37,6 +39,27 @@ namespace netevo {
       bool   a;             /**< Accept flag */
    } evolve_sa_result_t;
    
+   /** State of the annealing process saved in a checkpoint. */
+   typedef struct {
+      int32_t iteration;    /**< Iteration reached */
+      int32_t trial;        /**< Trial reached at the current temperature */
+      int32_t accepts;      /**< Accepted trials at the current temperature */
+      int32_t noChange;     /**< Temperatures since a trial was last accepted */
+      double  temp;         /**< Current temperature */
+      double  Q1;           /**< Performance of the current System */
+      double  Q2;           /**< Performance of the last trial */
+      int32_t paramsSeed;   /**< Seed for EvolveSAParams::rnd from the checkpoint */
+      int32_t mutateSeed;   /**< Seed for the Mutate random number generator from the checkpoint */
+   } evolve_sa_state_t;
+   
+   /** Checkpoint file header (followed by the current System, see System::saveBinary). */
+   typedef struct {
+      char               magic[8];   /**< "NETEVOSA" */
+      uint32_t           version;    /**< Format version */
+      uint32_t           reserved;
+      evolve_sa_state_t  state;
+   } sa_checkpoint_t;
+   
    /** Object encapsulating the parameters for the simulated annealing supervisor */
    class EvolveSAParams {
    public:
@@ -56,6 +79,33 @@ namespace netevo {
       bool ensureWeaklyConnected;
       /** Time to simulate for */
       double simTMax;
+      /** Number of candidate trials mutated and evaluated together. With 1 the mutation is made 
+       *  in place as a delta (see System::beginDelta) that an IncrementalPerformance follows, so 
+       *  mutations must report data changes through ChangeLog::update. Larger batches mutate copies 
+       *  and accept in candidate order, so the result does not depend on the number of threads. */
+      int batchTrials;
+      /** Number of threads used to evaluate a batch of trials (0 = OpenMP default). With more than 
+       *  one the Performance, Simulate and EvoInitialStates must be safe to call concurrently. */
+      int threads;
+      /** Simulate the initial states of a performance evaluation in parallel (each run has its 
+       *  own observer and ChangeLog and must only read from the System) */
+      bool parallelSims;
+      /** Iterations between checkpoints of the current System and annealing state (0 = never). 
+       *  New seeds are drawn at each checkpoint, so a run continued by EvolveSA::resume follows the 
+       *  checkpointed run exactly, though both differ from a run without checkpoints. */
+      int checkpointIterations;
+      /** File the checkpoints are written to between batches (replaced each time) */
+      string checkpointFile;
+      /** Number of performance values remembered by structural hash (0 = off, least recently used 
+       *  first out), so a trial returning to a System already seen is not simulated again. Only for 
+       *  a performance that is the same each time and mutations that report data changes through 
+       *  ChangeLog::update, see FitnessCache. */
+      int fitnessCache;
+      /** Acceptance probability below which a trial is abandoned part way through its simulation 
+       *  (see SimObserver::stop) and rejected, uncached (0 = never, requires a BoundedPerformance). 
+       *  Parallel runs (see parallelSims) are only stopped by their own bound and the trials for 
+       *  the initial temperature are always simulated in full. */
+      double abandonProb;
       /** Seed for the random number generator */
       lemon::Random rnd;
 
@@ -70,6 +120,13 @@ namespace netevo {
          maxIterations         = 100000;
          ensureWeaklyConnected = true;
          simTMax               = 100.0;
+         batchTrials           = 1;
+         threads               = 0;
+         parallelSims          = false;
+         checkpointIterations  = 0;
+         checkpointFile        = "evolve_sa.chk";
+         fitnessCache          = 0;
+         abandonProb           = 0.0;
          rnd.seed();
       }
       
@@ -81,18 +138,65 @@ namespace netevo {
       virtual double acceptProb (double dQ, double temp) { return exp(-dQ/temp); }
    };
    
+   /** Simulated annealing supervisor. Each trial is a mutation of the current System (see 
+    *  Mutate) that is accepted with EvolveSAParams::acceptProb at the current temperature. The 
+    *  optional features are described with their EvolveSAParams (batchTrials, parallelSims, 
+    *  checkpointIterations, fitnessCache and abandonProb). */
    class EvolveSA {
    private:
       EvolveSAParams &mParams;
       Performance    &mQ;
       Mutate         &mMut;
       
-      System * trial (double temp, System &sys, Simulate &sim, EvoInitialStates &initial, evolve_sa_result_t &result, ChangeLog &logger);
-      double   performance (System &sys, Simulate &sim, EvoInitialStates &initial);
+      /** Incremental form of the performance measure (if available) */
+      IncrementalPerformance *mIncQ;
+      /** System being tracked by the incremental performance measure */
+      System                 *mIncSys;
+      
+      /** Random number generator for the trials and acceptance (EvolveSAParams::rnd by default) */
+      lemon::Random *mRnd;
+      /** Whether this is one of the islands of an EvolveIslands (no tracking or checkpoints) */
+      bool           mIsland;
+      
+      /** Performance of Systems already evaluated */
+      FitnessCache   mCache;
+      /** Hash of the current System (when trials are made in place and the cache is used) */
+      SystemHash     mHash;
+      /** Discarded trial Systems kept for reuse by candidate */
+      SystemPool     mPool;
+      
+      System * candidate (System &sys, ChangeLog &logger);
+      void     trial (System &sys, ChangeLog &logger);
+      void     evaluate (vector<System*> &candidates, vector<double> &Q, vector<bool> &valid, 
+                         Simulate &sim, EvoInitialStates &initial, double Q1 = 0.0, double temp = 0.0, 
+                         vector<bool> *abandoned = NULL);
+      bool     accept (double temp, evolve_sa_result_t &result);
+      double   performance (System &sys, Simulate &sim, EvoInitialStates &initial, double Q1 = 0.0, 
+                            double temp = 0.0, bool *abandoned = NULL);
+      
+      void     track (System *sys, bool inPlace);
+      bool     start (System *curSys, evolve_sa_state_t &state, Simulate &sim, EvoInitialStates &initial, 
+                      EvoObserver &obs, ChangeLog &logger);
+      bool     anneal (System *&curSys, evolve_sa_state_t &state, bool resumed, Simulate &sim, 
+                       EvoInitialStates &initial, EvoObserver &obs, ChangeLog &logger, 
+                       int stopIteration = -1);
+      int      checkpoint (System *&curSys, evolve_sa_state_t &state);
+      
+      // Islands run the annealing process in stages
+      friend class EvolveIslands;
       
    public:
-      EvolveSA (EvolveSAParams &params, Performance &Q, Mutate &mut) : mParams(params), mQ(Q), mMut(mut) { }
+      EvolveSA (EvolveSAParams &params, Performance &Q, Mutate &mut) : mParams(params), mQ(Q), mMut(mut), 
+                                                                       mIncQ(NULL), mIncSys(NULL), 
+                                                                       mRnd(&params.rnd), mIsland(false) { }
       System * evolve (System &sys, Simulate &sim, EvoInitialStates &initial, EvoObserver &obs, ChangeLog &logger);
+      /** Continue a run from a checkpoint file. The System given provides the dynamics that the 
+       *  saved System uses (as for System::openBinary). Returns NULL if the file can not be read. */
+      System * resume (string filename, System &sys, Simulate &sim, EvoInitialStates &initial, 
+                       EvoObserver &obs, ChangeLog &logger);
+      
+      /** Performance values cached during the last run (see EvolveSAParams::fitnessCache) */
+      FitnessCache & cache () { return mCache; }
    };
 
 } // netevo namespace
@@ -0,0 +1,176 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "fitness_cache.h"
+#include <cstring>
+
+namespace netevo {
+   
+   // ---------- Hashing ----------
+   
+   /** Mix the bits of a value (splitmix64 finaliser) */
+   static inline uint64_t mix (uint64_t x) {
+      x += 0x9e3779b97f4a7c15ULL;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      return x ^ (x >> 31);
+   }
+   
+   /** Combine a value into a running hash (order dependent) */
+   static inline uint64_t combine (uint64_t h, uint64_t v) { return mix(h ^ mix(v)); }
+   
+   static inline uint64_t hashDouble (double d) {
+      // Both zeros hash the same
+      if (d == 0.0) { d = 0.0; }
+      uint64_t bits;
+      memcpy(&bits, &d, sizeof(double));
+      return bits;
+   }
+   
+   static uint64_t hashString (const string &s) {
+      // FNV-1a
+      uint64_t h = 0xcbf29ce484222325ULL;
+      for (size_t i=0; i<s.size(); ++i) {
+         h ^= (unsigned char)s[i];
+         h *= 0x100000001b3ULL;
+      }
+      return h;
+   }
+   
+   static uint64_t hashParams (uint64_t h, const vector<double> &params) {
+      h = combine(h, params.size());
+      for (size_t i=0; i<params.size(); ++i) { h = combine(h, hashDouble(params[i])); }
+      return h;
+   }
+   
+   uint64_t SystemHash::nodeHash (System &sys, Node v) {
+      NodeData &data = sys.nodeData(v);
+      uint64_t h = combine(data.key, hashString(data.dynamic->getName()));
+      h = hashParams(h, data.dynamicParams);
+      
+      // The in-arcs form a multiset (summed so that their order does not matter)
+      uint64_t in = 0;
+      for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+         ArcData &arc = sys.arcData(e);
+         uint64_t a = combine(sys.nodeData(sys.source(e)).key, hashDouble(arc.weight));
+         a = combine(a, hashString(arc.dynamic->getName()));
+         in += hashParams(a, arc.dynamicParams);
+      }
+      return combine(h, in);
+   }
+   
+   uint64_t SystemHash::hash (System &sys) {
+      uint64_t h = 0;
+      for (System::NodeIt v(sys); v != INVALID; ++v) { h += nodeHash(sys, v); }
+      return h;
+   }
+   
+   // ---------- SystemHash ----------
+   
+   void SystemHash::reset (System *sys) {
+      if (mSys != NULL) { mSys->detach(this); }
+      mSys = sys;
+      mValue = 0;
+      mNodeHash.clear();
+      mDirty.clear();
+      if (mSys != NULL) {
+         for (System::NodeIt v(*mSys); v != INVALID; ++v) {
+            uint64_t h = nodeHash(*mSys, v);
+            mNodeHash[mSys->nodeData(v).key] = h;
+            mValue += h;
+         }
+         mSys->attach(this);
+      }
+   }
+   
+   void SystemHash::mark (Node v) {
+      if (mSys != NULL) { mDirty[mSys->nodeData(v).key] = v; }
+   }
+   
+   void SystemHash::erase (System &sys, Node n) {
+      int key = sys.nodeData(n).key;
+      unordered_map<int, uint64_t>::iterator it = mNodeHash.find(key);
+      if (it != mNodeHash.end()) {
+         mValue -= it->second;
+         mNodeHash.erase(it);
+      }
+      mDirty.erase(key);
+   }
+   
+   uint64_t SystemHash::value () {
+      if (mSys == NULL) { return 0; }
+      for (unordered_map<int, Node>::iterator d = mDirty.begin(); d != mDirty.end(); ++d) {
+         uint64_t h = nodeHash(*mSys, d->second);
+         uint64_t &old = mNodeHash[d->first];
+         mValue += h - old;
+         old = h;
+      }
+      mDirty.clear();
+      return mValue;
+   }
+   
+   // ---------- FitnessCache ----------
+   
+   void FitnessCache::setCapacity (int capacity) {
+      mCapacity = (capacity < 0) ? 0 : capacity;
+      while ((int)mIndex.size() > mCapacity) {
+         mIndex.erase(mEntries.back().first);
+         mEntries.pop_back();
+      }
+   }
+   
+   bool FitnessCache::find (uint64_t hash, double &Q) {
+      unordered_map<uint64_t, list<pair<uint64_t, double> >::iterator>::iterator it = mIndex.find(hash);
+      if (it == mIndex.end()) {
+         mMisses++;
+         return false;
+      }
+      // Move to the front (most recently used)
+      mEntries.splice(mEntries.begin(), mEntries, it->second);
+      Q = it->second->second;
+      mHits++;
+      return true;
+   }
+   
+   void FitnessCache::insert (uint64_t hash, double Q) {
+      if (mCapacity <= 0) { return; }
+      unordered_map<uint64_t, list<pair<uint64_t, double> >::iterator>::iterator it = mIndex.find(hash);
+      if (it != mIndex.end()) {
+         it->second->second = Q;
+         mEntries.splice(mEntries.begin(), mEntries, it->second);
+         return;
+      }
+      mEntries.push_front(make_pair(hash, Q));
+      mIndex[hash] = mEntries.begin();
+      if ((int)mIndex.size() > mCapacity) {
+         mIndex.erase(mEntries.back().first);
+         mEntries.pop_back();
+      }
+   }
+   
+   void FitnessCache::clear () {
+      mEntries.clear();
+      mIndex.clear();
+      mHits = 0;
+      mMisses = 0;
+   }
+   
+} // netevo namespace
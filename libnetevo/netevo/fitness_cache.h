@@ -0,0 +1,129 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_FITNESS_CACHE_H
+#define NE_FITNESS_CACHE_H
+
+#include "system.h"
+#include <list>
+#include <unordered_map>
+#include <stdint.h>
+
+using namespace std;
+
+namespace netevo {
+   
+   /** Structural hash of a System, kept up to date as the System changes.
+    *  Covers the topology (nodes are identified by their key), arc weights and the dynamics and 
+    *  dynamic parameters of every node and arc (names, positions and properties are ignored). 
+    *  The hash is the sum of a 64 bit hash for each node, which covers the node and its in-arcs, 
+    *  so it does not depend on the order of nodes and arcs. Once reset the hash is attached to the 
+    *  System as a listener (see System::attach) and every change only marks the nodes affected, 
+    *  which are rehashed when value is next called. Changes to node or arc data must be reported 
+    *  through System::recordUpdate (as ChangeLogDelta does) and reset must be called after any 
+    *  bulk change (e.g. System::openBinary). */
+   class SystemHash : public ChangeLog {
+   private:
+      System  *mSys;
+      uint64_t mValue;
+      /** Current contribution of each node (by key) */
+      unordered_map<int, uint64_t> mNodeHash;
+      /** Nodes to rehash (by key) */
+      unordered_map<int, Node> mDirty;
+      
+      void mark (Node v);
+      
+   public:
+      SystemHash () : mSys(NULL), mValue(0) { }
+      ~SystemHash () { reset(NULL); }
+      
+      /** Hash of a System calculated from scratch */
+      static uint64_t hash (System &sys);
+      /** Hash of a single node (and its in-arcs) */
+      static uint64_t nodeHash (System &sys, Node v);
+      
+      /** Start tracking a System (NULL to stop tracking) */
+      void reset (System *sys);
+      /** System being tracked */
+      System * system () { return mSys; }
+      /** Hash of the System being tracked */
+      uint64_t value ();
+      
+      void addNode  (System &sys, Node n) { mark(n); }
+      void addArc   (System &sys, Node source, Node target) { mark(target); }
+      void erase    (System &sys, Node n);
+      void erase    (System &sys, Arc e) { mark(sys.target(e)); }
+      
+      void update   (System &sys, Node n) { mark(n); }
+      void update   (System &sys, Arc e) { mark(sys.target(e)); }
+   };
+   
+   /** Bounded cache of performance values keyed on SystemHash values. When full the least 
+    *  recently used value is dropped (LRU eviction, both find and insert count as a use). 
+    *  Collisions between distinct Systems are not detected (with 64 bit hashes they are very 
+    *  unlikely for the number of Systems a search visits).
+    *
+    *  EvolveSA clears its cache at the start of evolve and resume, so values are only reused 
+    *  within a run and always for the same Performance. A value is reused for every later trial 
+    *  with the same hash, i.e. the EvoInitialStates is not called again and the Performance is 
+    *  treated as a function of the structure alone. If the initial states are random a hit returns 
+    *  the value found for the states drawn when the System was first evaluated.
+    *
+    *  When trials are made in place the hash is kept up to date as a listener of the System 
+    *  (see SystemHash). A Mutate must therefore report every change to node or arc data through 
+    *  logger.update (the ChangeLogDelta it is given calls System::recordUpdate) before making it. 
+    *  Data changed without being reported leaves the hash of the old System in place and later 
+    *  look ups return stale performance values. */
+   class FitnessCache {
+   private:
+      int mCapacity;
+      long mHits;
+      long mMisses;
+      /** Entries from most to least recently used */
+      list<pair<uint64_t, double> > mEntries;
+      unordered_map<uint64_t, list<pair<uint64_t, double> >::iterator> mIndex;
+      
+   public:
+      FitnessCache (int capacity = 0) : mCapacity(capacity), mHits(0), mMisses(0) { }
+      
+      /** Change the number of entries held (0 disables the cache) */
+      void setCapacity (int capacity);
+      /** Maximum number of entries */
+      int capacity () { return mCapacity; }
+      /** Number of entries held */
+      int size () { return (int)mIndex.size(); }
+      
+      /** Look up the performance of a System. Returns false if it is not held. */
+      bool find (uint64_t hash, double &Q);
+      /** Store the performance of a System. */
+      void insert (uint64_t hash, double Q);
+      /** Remove all entries (and reset the counts) */
+      void clear ();
+      
+      /** Number of successful look ups */
+      long hits () { return mHits; }
+      /** Number of failed look ups */
+      long misses () { return mMisses; }
+   };
+   
+} // netevo namespace
+
+#endif // NE_FITNESS_CACHE_H
@@ -0,0 +1,332 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "system.h"
+#include "mapped_file.h"
+#include <cstdlib>
+#include <cstring>
+
+// Single pass GML loader (see System::openFromGMLFast). The file is memory mapped and scanned by a
+// small tokenizer; strings are returned as views into the mapped file so nothing is allocated per
+// token, and nodes and arcs are added as soon as they are complete.
+
+namespace netevo {
+   
+   /** Kinds of token returned by GMLScanner. */
+   enum gml_token_e { 
+      GML_TOK_KEY, GML_TOK_NUMBER, GML_TOK_STRING, GML_TOK_OPEN, GML_TOK_CLOSE, GML_TOK_END, 
+      GML_TOK_ERROR 
+   };
+   
+   /** A view of part of the mapped file. */
+   typedef struct {
+      const char *p;
+      size_t      n;
+   } gml_view_t;
+   
+   class GMLScanner {
+   private:
+      const char *mP;
+      const char *mEnd;
+      int         mLine;
+      
+   public:
+      gml_token_e kind;
+      gml_view_t  text;
+      double      number;
+      bool        integer;
+      
+      GMLScanner (const char *data, size_t size) : mP(data), mEnd(data + size), mLine(1) { }
+      
+      int line () { return mLine; }
+      
+      bool is (const char *key) { return text.n == strlen(key) && memcmp(text.p, key, text.n) == 0; }
+      
+      gml_token_e next () {
+         // Skip white space and comments (# to the end of the line)
+         while (mP < mEnd) {
+            if (*mP == '\n') { mLine++; mP++; }
+            else if (*mP == ' ' || *mP == '\t' || *mP == '\r') { mP++; }
+            else if (*mP == '#') { while (mP < mEnd && *mP != '\n') { mP++; } }
+            else { break; }
+         }
+         if (mP >= mEnd) { return kind = GML_TOK_END; }
+         
+         char c = *mP;
+         text.p = mP;
+         if (c == '[') { mP++; text.n = 1; return kind = GML_TOK_OPEN; }
+         if (c == ']') { mP++; text.n = 1; return kind = GML_TOK_CLOSE; }
+         if (c == '"') {
+            text.p = ++mP;
+            while (mP < mEnd && *mP != '"') { if (*mP == '\n') { mLine++; } mP++; }
+            if (mP >= mEnd) { return kind = GML_TOK_ERROR; }
+            text.n = mP - text.p;
+            mP++;
+            return kind = GML_TOK_STRING;
+         }
+         if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            while (mP < mEnd && ((*mP >= 'a' && *mP <= 'z') || (*mP >= 'A' && *mP <= 'Z') || 
+                                 (*mP >= '0' && *mP <= '9') || *mP == '_')) { mP++; }
+            text.n = mP - text.p;
+            return kind = GML_TOK_KEY;
+         }
+         if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.') {
+            while (mP < mEnd && ((*mP >= '0' && *mP <= '9') || *mP == '-' || *mP == '+' || 
+                                 *mP == '.' || *mP == 'e' || *mP == 'E')) { mP++; }
+            text.n = mP - text.p;
+            integer = (memchr(text.p, '.', text.n) == NULL && memchr(text.p, 'e', text.n) == NULL && 
+                       memchr(text.p, 'E', text.n) == NULL);
+            number = toDouble(text);
+            return kind = GML_TOK_NUMBER;
+         }
+         return kind = GML_TOK_ERROR;
+      }
+      
+      /** Skip the value of a key that is not used (a single token or a whole list). */
+      bool skipValue () {
+         if (next() != GML_TOK_OPEN) { return kind == GML_TOK_NUMBER || kind == GML_TOK_STRING; }
+         int depth = 1;
+         while (depth > 0) {
+            switch (next()) {
+               case GML_TOK_OPEN:  depth++; break;
+               case GML_TOK_CLOSE: depth--; break;
+               case GML_TOK_END:
+               case GML_TOK_ERROR: return false;
+               default: break;
+            }
+         }
+         return true;
+      }
+      
+      /** Convert a view to a double (copied to the stack as the mapped file is not terminated). */
+      static double toDouble (gml_view_t v) {
+         char buf[64];
+         size_t n = (v.n < 63) ? v.n : 63;
+         memcpy(buf, v.p, n);
+         buf[n] = '\0';
+         return strtod(buf, NULL);
+      }
+      
+      /** Parse a comma separated list of numbers into values (reusing its storage). */
+      static void toList (gml_view_t v, vector<double> &values) {
+         const char *p = v.p, *end = v.p + v.n, *q;
+         values.clear();
+         while (p < end) {
+            q = (const char *)memchr(p, ',', end - p);
+            if (q == NULL) { q = end; }
+            gml_view_t item = { p, (size_t)(q - p) };
+            values.push_back(toDouble(item));
+            p = q + 1;
+         }
+      }
+   };
+   
+   /** Attributes of an edge, kept until its source and target are known. */
+   typedef struct {
+      long       source;
+      long       target;
+      bool       hasSource;
+      bool       hasTarget;
+      double     weight;
+      bool       hasWeight;
+      gml_view_t label;
+      gml_view_t properties;
+      gml_view_t dynName;
+      gml_view_t dynParams;
+   } gml_edge_t;
+   
+   int System::openFromGMLFast (string filename) {
+      MappedFile file;
+      if (file.open(filename) != 0) { return 1; }
+      
+      GMLScanner scan(file.data(), file.size());
+      vector<Node> idNodes;
+      map<long,Node> sparseIds;
+      vector<gml_edge_t> pending;
+      string name;
+      int maxKey = -1;
+      bool inGraph = false, ok = true;
+      
+      // Node ids in a file are nearly always small, so they index a vector directly (a file of N 
+      // bytes cannot hold more than N nodes). Any others fall back to a map.
+      const long denseIds = (long)file.size() + 1;
+      idNodes.reserve(file.size() / 64 + 16);
+      
+      // Nodes added so far, so that an invalid file leaves the System as it was (erasing them in 
+      // reverse order also restores the IDs of the nodes and arcs already in the System)
+      vector<Node> added;
+      int prevNextKey = mNextKey;
+      auto rollback = [&] () {
+         for (int i=(int)added.size()-1; i>=0; --i) { erase(added[i]); }
+         mNextKey = prevNextKey;
+      };
+      
+      // Find a node from its id in the file
+      auto findNode = [&] (long id) -> Node {
+         if (id >= 0 && id < (long)idNodes.size()) { return idNodes[id]; }
+         if (id >= 0 && id < denseIds) { return INVALID; }
+         map<long,Node>::iterator it = sparseIds.find(id);
+         return (it == sparseIds.end()) ? Node(INVALID) : it->second;
+      };
+      
+      // Add an edge once its nodes are known
+      auto addEdge = [&] (const gml_edge_t &e) -> bool {
+         Node u = findNode(e.source), v = findNode(e.target);
+         if (u == INVALID || v == INVALID) { return false; }
+         Arc a = addArc(u, v);
+         ArcData &eData = mArcData[a];
+         if (e.hasWeight) { eData.weight = e.weight; }
+         if (e.label.p != NULL) { eData.name.assign(e.label.p, e.label.n); }
+         if (e.properties.p != NULL) { GMLScanner::toList(e.properties, eData.properties); }
+         if (e.dynName.p != NULL) {
+            name.assign(e.dynName.p, e.dynName.n);
+            std::map<string, ArcDynamic*>::iterator it = mDynamics->arcs.find(name);
+            if (it != mDynamics->arcs.end()) { eData.dynamic = it->second; }
+            else { cerr << "Unknown arc dynamic " << name << " (System::openFromGMLFast)" << endl; }
+         }
+         if (e.dynParams.p != NULL) { GMLScanner::toList(e.dynParams, eData.dynamicParams); }
+         return true;
+      };
+      
+      while (ok && scan.next() != GML_TOK_END) {
+         
+         // Enter the graph list (anything else at the top level is skipped)
+         if (!inGraph) {
+            if (scan.kind != GML_TOK_KEY) { ok = false; break; }
+            if (scan.is("graph")) {
+               if (scan.next() != GML_TOK_OPEN) { ok = false; break; }
+               inGraph = true;
+            }
+            else if (!scan.skipValue()) { ok = false; }
+            continue;
+         }
+         if (scan.kind == GML_TOK_CLOSE) { inGraph = false; continue; }
+         if (scan.kind != GML_TOK_KEY) { ok = false; break; }
+         
+         if (scan.is("node")) {
+            if (scan.next() != GML_TOK_OPEN) { ok = false; break; }
+            Node v = addNode();
+            added.push_back(v);
+            NodeData &nData = mNodeData[v];
+            bool hasId = false;
+            while (ok && scan.next() == GML_TOK_KEY) {
+               if (scan.is("id")) {
+                  // Every node needs a single id that no other node has
+                  if (hasId || scan.next() != GML_TOK_NUMBER) { ok = false; break; }
+                  long id = (long)scan.number;
+                  if (findNode(id) != INVALID) { ok = false; break; }
+                  if (id >= 0 && id < denseIds) {
+                     if (id >= (long)idNodes.size()) { idNodes.resize(id + 1, INVALID); }
+                     idNodes[id] = v;
+                  }
+                  else { sparseIds[id] = v; }
+                  hasId = true;
+               }
+               else if (scan.is("key")) {
+                  if (scan.next() != GML_TOK_NUMBER) { ok = false; break; }
+                  nData.key = (int)scan.number;
+                  if (nData.key > maxKey) { maxKey = nData.key; }
+               }
+               else if (scan.is("label")) {
+                  if (scan.next() != GML_TOK_STRING) { ok = false; break; }
+                  nData.name.assign(scan.text.p, scan.text.n);
+               }
+               else if (scan.is("graphics")) {
+                  if (scan.next() != GML_TOK_OPEN) { ok = false; break; }
+                  while (ok && scan.next() == GML_TOK_KEY) {
+                     double *coord = scan.is("x") ? &nData.position.x : scan.is("y") ? &nData.position.y : 
+                                     scan.is("z") ? &nData.position.z : NULL;
+                     if (coord == NULL) { ok = scan.skipValue(); }
+                     else if (scan.next() == GML_TOK_NUMBER) { *coord = scan.number; }
+                     else { ok = false; }
+                  }
+                  if (scan.kind != GML_TOK_CLOSE) { ok = false; }
+               }
+               else if (scan.is("properties")) {
+                  if (scan.next() != GML_TOK_STRING) { ok = false; break; }
+                  GMLScanner::toList(scan.text, nData.properties);
+               }
+               else if (scan.is("dynName")) {
+                  if (scan.next() != GML_TOK_STRING) { ok = false; break; }
+                  name.assign(scan.text.p, scan.text.n);
+                  std::map<string, NodeDynamic*>::iterator it = mDynamics->nodes.find(name);
+                  if (it != mDynamics->nodes.end()) { nData.dynamic = it->second; }
+                  else { cerr << "Unknown node dynamic " << name << " (System::openFromGMLFast)" << endl; }
+               }
+               else if (scan.is("dynParams")) {
+                  if (scan.next() != GML_TOK_STRING) { ok = false; break; }
+                  GMLScanner::toList(scan.text, nData.dynamicParams);
+               }
+               else { ok = scan.skipValue(); }
+            }
+            if (scan.kind != GML_TOK_CLOSE || !hasId) { ok = false; }
+         }
+         else if (scan.is("edge")) {
+            if (scan.next() != GML_TOK_OPEN) { ok = false; break; }
+            gml_edge_t e;
+            memset(&e, 0, sizeof(gml_edge_t));
+            while (ok && scan.next() == GML_TOK_KEY) {
+               if (scan.is("source") || scan.is("target") || scan.is("weight")) {
+                  bool isSource = scan.is("source"), isTarget = scan.is("target");
+                  if (scan.next() != GML_TOK_NUMBER) { ok = false; break; }
+                  if (isSource)      { e.source = (long)scan.number; e.hasSource = true; }
+                  else if (isTarget) { e.target = (long)scan.number; e.hasTarget = true; }
+                  else               { e.weight = scan.number; e.hasWeight = true; }
+               }
+               else if (scan.is("label") || scan.is("properties") || scan.is("dynName") || scan.is("dynParams")) {
+                  gml_view_t *v = scan.is("label") ? &e.label : scan.is("properties") ? &e.properties : 
+                                  scan.is("dynName") ? &e.dynName : &e.dynParams;
+                  if (scan.next() != GML_TOK_STRING) { ok = false; break; }
+                  *v = scan.text;
+               }
+               else { ok = scan.skipValue(); }
+            }
+            if (scan.kind != GML_TOK_CLOSE || !e.hasSource || !e.hasTarget) { ok = false; break; }
+            // Edges that come before their nodes wait until the end
+            if (!addEdge(e)) { pending.push_back(e); }
+         }
+         else { ok = scan.skipValue(); }
+      }
+      
+      
+      if (!ok || scan.kind == GML_TOK_ERROR || inGraph) {
+         cerr << "Error in GML file " << filename << " near line " << scan.line() << " (System::openFromGMLFast)" << endl;
+         rollback();
+         return 2;
+      }
+      for (int i=0; i<(int)pending.size(); ++i) {
+         if (!addEdge(pending[i])) { ok = false; }
+      }
+      if (!ok) {
+         cerr << "Edges reference unknown nodes in GML file " << filename << " (System::openFromGMLFast)" << endl;
+         rollback();
+         return 2;
+      }
+      
+      // Keys read from the file must not be handed out again
+      if (mNextKey <= maxKey) { mNextKey = maxKey + 1; }
+      
+      // Update the state ID mappings
+      refreshStateIDs();
+      return 0;
+   }
+   
+} // netevo namespace
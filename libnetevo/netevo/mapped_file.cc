@@ -0,0 +1,66 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "mapped_file.h"
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace netevo {
+   
+   int MappedFile::open (const string &filename) {
+      struct stat info;
+      close();
+      mFile = ::open(filename.c_str(), O_RDONLY);
+      if (mFile == -1) {
+         cerr << "Could not open file: " << filename << " (MappedFile::open)" << endl;
+         return -1;
+      }
+      if (fstat(mFile, &info) != 0) {
+         cerr << "Could not read size of file: " << filename << " (MappedFile::open)" << endl;
+         close();
+         return -1;
+      }
+      mSize = info.st_size;
+      // An empty file cannot be mapped but is still valid
+      if (mSize > 0) {
+         void *p = mmap(NULL, mSize, PROT_READ, MAP_SHARED, mFile, 0);
+         if (p == MAP_FAILED) {
+            cerr << "Could not map file: " << filename << " (MappedFile::open)" << endl;
+            close();
+            return -1;
+         }
+         mData = (const char *)p;
+      }
+      return 0;
+   }
+   
+   void MappedFile::close () {
+      if (mData != NULL) { munmap((void *)mData, mSize); }
+      if (mFile != -1) { ::close(mFile); }
+      mData = NULL;
+      mSize = 0;
+      mFile = -1;
+   }
+   
+} // netevo namespace
@@ -0,0 +1,61 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_MAPPED_FILE_H
+#define NE_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+namespace netevo {
+   
+   /** A read-only file mapped into memory, so that its contents can be accessed directly without 
+    *  copying. Pages are only read from disk when they are touched. */
+   class MappedFile {
+   private:
+      const char *mData;
+      size_t      mSize;
+      int         mFile;
+      
+      MappedFile (const MappedFile &from);
+      MappedFile & operator= (const MappedFile &from);
+      
+   public:
+      MappedFile () : mData(NULL), mSize(0), mFile(-1) { }
+      ~MappedFile () { close(); }
+      
+      /** Map a file (any file already mapped is closed). Returns 0 if successful, -1 otherwise. */
+      int open (const string &filename);
+      /** Unmap the file. */
+      void close ();
+      /** Whether a file is mapped. */
+      bool isOpen () { return mFile != -1; }
+      /** Start of the mapped contents. */
+      const char * data () { return mData; }
+      /** Size of the file in bytes. */
+      size_t size () { return mSize; }
+   };
+   
+} // netevo namespace
+
+#endif // NE_MAPPED_FILE_H
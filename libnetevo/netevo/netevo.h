@@ -24,8 +24,21 @@
 
 // Files that make up the core of the NetEvo library
 #include "system.h"
+#include "changelog_async.h"
+#include "snapshot.h"
+#include "compiled.h"
+#include "dynamics.h"
+#include "spectral.h"
 #include "simulate.h"
+#include "ensemble.h"
+#include "device.h"
+#include "stiff.h"
+#include "trajectory.h"
+#include "profile.h"
 #include "evolve.h"
+#include "fitness_cache.h"
+#include "performance.h"
 #include "evolve_sa.h"
+#include "evolve_islands.h"
 
 #endif // NE_NETEVO_H
@@ -0,0 +1,441 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "performance.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace netevo {
+   
+   // ---------- Neighbours ----------
+   
+   void Neighbours::reset (System &sys) {
+      delete mNeighbours;
+      mNeighbours = new System::NodeMap< map<Node,int> >(sys);
+      for (System::ArcIt e(sys); e != INVALID; ++e) {
+         add(sys.source(e), sys.target(e));
+      }
+   }
+   
+   bool Neighbours::add (Node u, Node v) {
+      if (u == v) { return false; }
+      int &count = (*mNeighbours)[u][v];
+      count++;
+      (*mNeighbours)[v][u]++;
+      return (count == 1);
+   }
+   
+   bool Neighbours::remove (Node u, Node v) {
+      if (u == v) { return false; }
+      map<Node,int> &nu = (*mNeighbours)[u];
+      map<Node,int>::iterator it = nu.find(v);
+      if (it == nu.end()) { return false; }
+      it->second--;
+      if (it->second > 0) {
+         (*mNeighbours)[v][u]--;
+         return false;
+      }
+      nu.erase(it);
+      (*mNeighbours)[v].erase(u);
+      return true;
+   }
+   
+   int Neighbours::common (Node u, Node v) {
+      // Look up the neighbours of the smaller set in the larger one
+      map<Node,int> *small = &(*mNeighbours)[u], *large = &(*mNeighbours)[v];
+      if (small->size() > large->size()) { swap(small, large); }
+      int c = 0;
+      for (map<Node,int>::iterator it = small->begin(); it != small->end(); ++it) {
+         if (large->find(it->first) != large->end()) { c++; }
+      }
+      return c;
+   }
+   
+   // ---------- DegreeVariancePerformance ----------
+   
+   double DegreeVariancePerformance::performance (System &sys, pair<vector<State>*,vector<double>*> *dyn) {
+      int n = 0;
+      double sum = 0.0, sumSq = 0.0, mean, var;
+      for (System::NodeIt v(sys); v != INVALID; ++v) {
+         double d = countOutArcs(sys, v) + countInArcs(sys, v);
+         sum += d;
+         sumSq += d * d;
+         n++;
+      }
+      if (n == 0) { return 0.0; }
+      mean = sum / n;
+      var = sumSq / n - mean * mean;
+      return mMaximise ? -var : var;
+   }
+   
+   void DegreeVariancePerformance::reset (System &sys) {
+      delete mDegree;
+      mDegree = new System::NodeMap<int>(sys, 0);
+      mNodes = 0;
+      mSum = 0.0;
+      mSumSq = 0.0;
+      for (System::NodeIt v(sys); v != INVALID; ++v) {
+         mNodes++;
+      }
+      for (System::ArcIt e(sys); e != INVALID; ++e) {
+         changeDegree(sys.source(e), 1);
+         changeDegree(sys.target(e), 1);
+      }
+   }
+   
+   void DegreeVariancePerformance::changeDegree (Node v, int d) {
+      int &k = (*mDegree)[v];
+      mSum += d;
+      mSumSq += (double)(k + d) * (k + d) - (double)k * k;
+      k += d;
+   }
+   
+   double DegreeVariancePerformance::currentPerformance () {
+      if (mNodes == 0) { return 0.0; }
+      double mean = mSum / mNodes;
+      double var = mSumSq / mNodes - mean * mean;
+      return mMaximise ? -var : var;
+   }
+   
+   void DegreeVariancePerformance::addNode (System &sys, Node n) {
+      (*mDegree)[n] = 0;
+      mNodes++;
+   }
+   
+   void DegreeVariancePerformance::addArc (System &sys, Node source, Node target) {
+      changeDegree(source, 1);
+      changeDegree(target, 1);
+   }
+   
+   void DegreeVariancePerformance::erase (System &sys, Node n) {
+      // All arcs have already been erased
+      mNodes--;
+   }
+   
+   void DegreeVariancePerformance::erase (System &sys, Arc e) {
+      changeDegree(sys.source(e), -1);
+      changeDegree(sys.target(e), -1);
+   }
+   
+   // ---------- ClusteringPerformance ----------
+   
+   double ClusteringPerformance::performance (System &sys, pair<vector<State>*,vector<double>*> *dyn) {
+      // Calculate from scratch without changing the tracked System
+      ClusteringPerformance perf(mMaximise);
+      perf.reset(sys);
+      return perf.currentPerformance();
+   }
+   
+   void ClusteringPerformance::reset (System &sys) {
+      mNeighbours.reset(sys);
+      mTriangles = 0.0;
+      mTriples = 0.0;
+      for (System::NodeIt u(sys); u != INVALID; ++u) {
+         map<Node,int> &nu = mNeighbours.of(u);
+         double d = nu.size();
+         mTriples += d * (d - 1.0) / 2.0;
+         // Each triangle is found once from each of its edges
+         for (map<Node,int>::iterator it = nu.begin(); it != nu.end(); ++it) {
+            if (u < it->first) { mTriangles += mNeighbours.common(u, it->first); }
+         }
+      }
+      mTriangles /= 3.0;
+   }
+   
+   double ClusteringPerformance::currentPerformance () {
+      double c = (mTriples > 0.0) ? (3.0 * mTriangles / mTriples) : 0.0;
+      return mMaximise ? -c : c;
+   }
+   
+   void ClusteringPerformance::addNode (System &sys, Node n) {
+      mNeighbours.clear(n);
+   }
+   
+   void ClusteringPerformance::addArc (System &sys, Node source, Node target) {
+      // Only a new pair of neighbours changes the measure (their common neighbours are unchanged)
+      if (mNeighbours.add(source, target)) {
+         mTriangles += mNeighbours.common(source, target);
+         mTriples += (mNeighbours.degree(source) - 1) + (mNeighbours.degree(target) - 1);
+      }
+   }
+   
+   void ClusteringPerformance::erase (System &sys, Node n) {
+      // All arcs have already been erased
+   }
+   
+   void ClusteringPerformance::erase (System &sys, Arc e) {
+      Node source = sys.source(e);
+      Node target = sys.target(e);
+      if (mNeighbours.remove(source, target)) {
+         mTriangles -= mNeighbours.common(source, target);
+         mTriples -= mNeighbours.degree(source) + mNeighbours.degree(target);
+      }
+   }
+   
+   // ---------- ComponentsPerformance ----------
+   
+   double ComponentsPerformance::performance (System &sys, pair<vector<State>*,vector<double>*> *dyn) {
+      return sys.weaklyConnectedComponents();
+   }
+   
+   void ComponentsPerformance::reset (System &sys) {
+      mNeighbours.reset(sys);
+      delete mLabel;
+      delete mMark;
+      mLabel = new System::NodeMap<int>(sys, -1);
+      mMark = new System::NodeMap<int>(sys, 0);
+      mSize.clear();
+      mNextLabel = 0;
+      mStamp = 0;
+      for (System::NodeIt v(sys); v != INVALID; ++v) {
+         if ((*mLabel)[v] == -1) {
+            relabel(v, mNextLabel);
+            mNextLabel++;
+         }
+      }
+   }
+   
+   void ComponentsPerformance::relabel (Node v, int label) {
+      // Breadth first search of the component containing v
+      vector<Node> &queue = mVisited[0];
+      queue.clear();
+      queue.push_back(v);
+      (*mLabel)[v] = label;
+      for (int i=0; i<(int)queue.size(); ++i) {
+         map<Node,int> &nw = mNeighbours.of(queue[i]);
+         for (map<Node,int>::iterator it = nw.begin(); it != nw.end(); ++it) {
+            if ((*mLabel)[it->first] != label) {
+               (*mLabel)[it->first] = label;
+               queue.push_back(it->first);
+            }
+         }
+      }
+      mSize[label] += queue.size();
+   }
+   
+   double ComponentsPerformance::currentPerformance () {
+      return (double)mSize.size();
+   }
+   
+   void ComponentsPerformance::addNode (System &sys, Node n) {
+      mNeighbours.clear(n);
+      (*mLabel)[n] = mNextLabel;
+      (*mMark)[n] = 0;
+      mSize[mNextLabel] = 1;
+      mNextLabel++;
+   }
+   
+   void ComponentsPerformance::addArc (System &sys, Node source, Node target) {
+      if (mNeighbours.add(source, target)) {
+         int a = (*mLabel)[source], b = (*mLabel)[target];
+         if (a != b) {
+            // Join the components by relabelling the smaller one
+            if (mSize[a] < mSize[b]) {
+               mSize.erase(a);
+               relabel(source, b);
+            }
+            else {
+               mSize.erase(b);
+               relabel(target, a);
+            }
+         }
+      }
+   }
+   
+   void ComponentsPerformance::erase (System &sys, Node n) {
+      // All arcs have already been erased so the node is a component on its own
+      mSize.erase((*mLabel)[n]);
+   }
+   
+   void ComponentsPerformance::erase (System &sys, Arc e) {
+      Node source = sys.source(e);
+      Node target = sys.target(e);
+      if (!mNeighbours.remove(source, target)) { return; }
+      
+      // Search from both ends at the same time until the searches meet (still connected) or one
+      // runs out of nodes (becoming a new component)
+      int stamp[2] = {mStamp + 1, mStamp + 2};
+      mStamp += 2;
+      int head[2] = {0, 0};
+      mVisited[0].clear();
+      mVisited[1].clear();
+      mVisited[0].push_back(source);
+      mVisited[1].push_back(target);
+      (*mMark)[source] = stamp[0];
+      (*mMark)[target] = stamp[1];
+      while (true) {
+         for (int s=0; s<2; ++s) {
+            if (head[s] == (int)mVisited[s].size()) {
+               // Split off the exhausted side
+               int oldLabel = (*mLabel)[source];
+               int n = mVisited[s].size();
+               for (int i=0; i<n; ++i) {
+                  (*mLabel)[mVisited[s][i]] = mNextLabel;
+               }
+               mSize[mNextLabel] = n;
+               mSize[oldLabel] -= n;
+               mNextLabel++;
+               return;
+            }
+            map<Node,int> &nw = mNeighbours.of(mVisited[s][head[s]]);
+            head[s]++;
+            for (map<Node,int>::iterator it = nw.begin(); it != nw.end(); ++it) {
+               int m = (*mMark)[it->first];
+               if (m == stamp[1-s]) { return; }
+               if (m != stamp[s]) {
+                  (*mMark)[it->first] = stamp[s];
+                  mVisited[s].push_back(it->first);
+               }
+            }
+         }
+      }
+   }
+   
+   // ---------- LaplacianSpectrum ----------
+   
+   void LaplacianSpectrum::reset (System &sys) {
+      mSys = &sys;
+      mTop.resize(0, 0);
+      mBottom.resize(0, 0);
+      mValid = false;
+   }
+   
+   void LaplacianSpectrum::solve () {
+      if (mValid || mSys == NULL) { return; }
+      SparseMatrixXd L;
+      mSys->sparseLaplacian(L);
+      int n = L.rows();
+      mIterations = 0;
+      if (n < 2) {
+         mLambda2 = 0.0;
+         mLambdaN = 0.0;
+         mTop = MatrixXd::Zero(n, 2);
+         mBottom = MatrixXd::Zero(n, 1);
+         mValid = true;
+         return;
+      }
+      
+      // The laplacian eigenvalues are all <= 0 so lambda_2 is found with the zero eigenvalue at 
+      // the top of the spectrum (the solver fails for directed Systems)
+      mSolver.keepVectors = warmVectors;
+      mValid = true;
+      if (mSolver.compute(L, 2, true, (mTop.rows() == n) ? &mTop : (const MatrixXd *)NULL) == -1 || 
+          mSolver.eigenvalues().size() < 2) {
+         failed();
+         return;
+      }
+      mLambda2 = fabs(mSolver.eigenvalues()(1));
+      mTop = mSolver.eigenvectors();
+      mIterations += mSolver.iterations();
+      
+      if (mSolver.compute(L, 1, false, (mBottom.rows() == n) ? &mBottom : (const MatrixXd *)NULL) == -1 || 
+          mSolver.eigenvalues().size() < 1) {
+         failed();
+         return;
+      }
+      mLambdaN = fabs(mSolver.eigenvalues()(0));
+      mBottom = mSolver.eigenvectors();
+      mIterations += mSolver.iterations();
+   }
+   
+   void LaplacianSpectrum::failed () {
+      mLambda2 = numeric_limits<double>::quiet_NaN();
+      mLambdaN = numeric_limits<double>::quiet_NaN();
+      mTop.resize(0, 0);
+      mBottom.resize(0, 0);
+   }
+   
+   void LaplacianSpectrum::addEntry (MatrixXd &x, int ID) {
+      // The node that held the ID (if any) has moved to the end
+      int n = x.rows();
+      if (n == 0 || ID < 0 || ID > n) { x.resize(0, 0); return; }
+      x.conservativeResize(n + 1, NoChange);
+      if (ID < n) {
+         x.row(n) = x.row(ID);
+      }
+      x.row(ID).setZero();
+   }
+   
+   void LaplacianSpectrum::eraseEntry (MatrixXd &x, int ID) {
+      // The node with the last ID takes over the ID
+      int n = x.rows();
+      if (n == 0 || ID < 0 || ID >= n) { x.resize(0, 0); return; }
+      x.row(ID) = x.row(n - 1);
+      x.conservativeResize(n - 1, NoChange);
+   }
+   
+   void LaplacianSpectrum::addNode (System &sys, Node n) {
+      addEntry(mTop, sys.nodeID(n));
+      addEntry(mBottom, sys.nodeID(n));
+      mValid = false;
+   }
+   
+   void LaplacianSpectrum::addArc (System &sys, Node source, Node target) {
+      mValid = false;
+   }
+   
+   void LaplacianSpectrum::erase (System &sys, Node n) {
+      eraseEntry(mTop, sys.nodeID(n));
+      eraseEntry(mBottom, sys.nodeID(n));
+      mValid = false;
+   }
+   
+   void LaplacianSpectrum::erase (System &sys, Arc e) {
+      mValid = false;
+   }
+   
+   // ---------- EigenratioPerformance ----------
+   
+   double EigenratioPerformance::performance (System &sys, pair<vector<State>*,vector<double>*> *dyn) {
+      return sys.eigenratio();
+   }
+   
+   double EigenratioPerformance::currentPerformance () {
+      double l2 = mSpectrum.lambda2(), ln = mSpectrum.lambdaN();
+      // Also infinite if the spectrum could not be found (NaN)
+      if (!(l2 >= 1e-10 * ln)) { return numeric_limits<double>::infinity(); }
+      return ln / l2;
+   }
+   
+   // ---------- Streaming bounds ----------
+   
+   /** Lower bound on the mean of non-negative values, given the sum of those observed so far, 
+    *  assuming the rest are evenly spaced in time up to tMax (and may all be 0). */
+   static double meanBound (double sum, int count, double tFirst, double tLast, double tMax) {
+      if (count < 2 || tLast <= tFirst) { return 0.0; }
+      double dt = (tLast - tFirst) / (count - 1);
+      double remaining = floor((tMax - tLast) / dt + 1e-9);
+      return sum / (count + max(remaining, 0.0));
+   }
+   
+   double OrderParameterPerformance::lowerBound (System &sys, SimReducer &reducer, double tMax) {
+      SimObserverOrderParameter &r = static_cast<SimObserverOrderParameter &>(reducer);
+      // Averaging 1 - r(t) rather than r(t)
+      return meanBound(r.count() - r.sum(), r.count(), r.firstTime(), r.lastTime(), tMax);
+   }
+   
+   double SyncErrorPerformance::lowerBound (System &sys, SimReducer &reducer, double tMax) {
+      SimObserverSyncError &r = static_cast<SimObserverSyncError &>(reducer);
+      return meanBound(r.sum(), r.count(), r.firstTime(), r.lastTime(), tMax);
+   }
+   
+} // netevo namespace
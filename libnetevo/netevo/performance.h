@@ -0,0 +1,249 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_PERFORMANCE_H
+#define NE_PERFORMANCE_H
+
+#include "system.h"
+#include "evolve.h"
+
+using namespace std;
+
+namespace netevo {
+   
+   /** Undirected neighbours of every node in a System (arc direction and self-loops are ignored).
+    *  Each neighbour is stored with the number of arcs (in either direction) joining the nodes. 
+    *  Used by the incremental performance measures to update in time proportional to the degree. */
+   class Neighbours {
+   private:
+      System::NodeMap< map<Node,int> > *mNeighbours;
+   public:
+      Neighbours () : mNeighbours(NULL) { }
+      ~Neighbours () { delete mNeighbours; }
+      
+      /** Find the neighbours of all nodes in a System. */
+      void reset (System &sys);
+      /** Clear the neighbours of a node (e.g. when it is added). */
+      void clear (Node v) { (*mNeighbours)[v].clear(); }
+      /** Record an arc between two nodes. Returns true if they were not already neighbours. */
+      bool add (Node u, Node v);
+      /** Remove an arc between two nodes. Returns true if they are no longer neighbours. */
+      bool remove (Node u, Node v);
+      /** Neighbours of a node. */
+      map<Node,int> & of (Node v) { return (*mNeighbours)[v]; }
+      /** Number of neighbours of a node. */
+      int degree (Node v) { return (int)(*mNeighbours)[v].size(); }
+      /** Number of neighbours that two nodes have in common. */
+      int common (Node u, Node v);
+   };
+   
+   /** Variance of the node degree (in + out arcs). For a System with N nodes and degrees d_i this
+    *  is sum_i d_i^2 / N - (sum_i d_i / N)^2 and is updated in constant time. */
+   class DegreeVariancePerformance : public IncrementalPerformance {
+   private:
+      bool          mMaximise;
+      System::NodeMap<int> *mDegree;
+      int           mNodes;
+      double        mSum;
+      double        mSumSq;
+      
+      void changeDegree (Node v, int d);
+      
+   public:
+      /** If maximise is set the negative variance is returned (so that it is maximised). */
+      DegreeVariancePerformance (bool maximise = false) : mMaximise(maximise), mDegree(NULL) { }
+      ~DegreeVariancePerformance () { delete mDegree; }
+      
+      double performance (System &sys, pair<vector<State>*,vector<double>*> *dyn);
+      void   reset (System &sys);
+      double currentPerformance ();
+      
+      void addNode  (System &sys, Node n);
+      void addArc   (System &sys, Node source, Node target);
+      void erase    (System &sys, Node n);
+      void erase    (System &sys, Arc e);
+   };
+   
+   /** Global clustering coefficient (transitivity) of the undirected System, 3 x triangles / 
+    *  connected triples. Adding or removing an arc is updated in time proportional to the degree 
+    *  of its end nodes. */
+   class ClusteringPerformance : public IncrementalPerformance {
+   private:
+      bool       mMaximise;
+      Neighbours mNeighbours;
+      double     mTriangles;
+      double     mTriples;
+      
+   public:
+      /** If maximise is set the negative clustering coefficient is returned (so that it is maximised). */
+      ClusteringPerformance (bool maximise = false) : mMaximise(maximise) { }
+      
+      double performance (System &sys, pair<vector<State>*,vector<double>*> *dyn);
+      void   reset (System &sys);
+      double currentPerformance ();
+      
+      void addNode  (System &sys, Node n);
+      void addArc   (System &sys, Node source, Node target);
+      void erase    (System &sys, Node n);
+      void erase    (System &sys, Arc e);
+   };
+   
+   /** Number of weakly connected components. Each node is labelled with its component, so adding 
+    *  an arc only relabels the smaller of two components that are joined. Removing the last arc 
+    *  between two nodes searches out from both nodes at the same time and stops as soon as the 
+    *  searches meet or one side is exhausted (that side is then relabelled as a new component). */
+   class ComponentsPerformance : public IncrementalPerformance {
+   private:
+      Neighbours            mNeighbours;
+      System::NodeMap<int> *mLabel;
+      System::NodeMap<int> *mMark;
+      map<int,int>          mSize;
+      int                   mNextLabel;
+      int                   mStamp;
+      vector<Node>          mVisited[2];
+      
+      void relabel (Node v, int label);
+      
+   public:
+      ComponentsPerformance () : mLabel(NULL), mMark(NULL) { }
+      ~ComponentsPerformance () { delete mLabel; delete mMark; }
+      
+      double performance (System &sys, pair<vector<State>*,vector<double>*> *dyn);
+      void   reset (System &sys);
+      double currentPerformance ();
+      
+      void addNode  (System &sys, Node n);
+      void addArc   (System &sys, Node source, Node target);
+      void erase    (System &sys, Node n);
+      void erase    (System &sys, Arc e);
+   };
+   
+   /** Extreme laplacian eigenvalues (lambda_2 and lambda_N) of a changing, undirected System. 
+    *  Each solve (see LanczosSolver) is started from the Ritz vectors of the last, so a System 
+    *  that has only changed slightly needs far fewer matrix vector products (less so when lambda_2 
+    *  lies in a tight cluster). Attach to the System (see System::attach) after reset. */
+   class LaplacianSpectrum : public ChangeLog {
+   private:
+      System       *mSys;
+      LanczosSolver mSolver;
+      MatrixXd      mTop;
+      MatrixXd      mBottom;
+      double        mLambda2;
+      double        mLambdaN;
+      bool          mValid;
+      int           mIterations;
+      
+      void solve ();
+      void failed ();
+      void addEntry (MatrixXd &x, int ID);
+      void eraseEntry (MatrixXd &x, int ID);
+      
+   public:
+      /** Number of Ritz vectors kept from each end of the spectrum to start the next solve 
+       *  (indexed by node ID, so kept in step as nodes are added and erased) */
+      int warmVectors;
+      
+      /** The solver tolerance defaults to 1e-8, which gives eigenvalues close to machine precision 
+       *  (their error grows with the square of the residual). */
+      LaplacianSpectrum () : mSys(NULL), mValid(false), mIterations(0), warmVectors(16) { 
+         mSolver.tolerance = 1e-8; 
+      }
+      
+      /** Start tracking a System (forgetting any previous eigenvectors). */
+      void reset (System &sys);
+      /** Second smallest magnitude laplacian eigenvalue (algebraic connectivity). NaN if the 
+       *  spectrum could not be found (e.g. the System is directed), as for lambdaN. */
+      double lambda2 () { solve(); return mLambda2; }
+      /** Largest magnitude laplacian eigenvalue. */
+      double lambdaN () { solve(); return mLambdaN; }
+      /** Eigenvector for lambda_2 (indexed by node ID). */
+      VectorXd fiedler () { solve(); return (mTop.cols() > 1) ? VectorXd(mTop.col(1)) : VectorXd(); }
+      /** Eigenvector for lambda_N (indexed by node ID). */
+      VectorXd dominant () { solve(); return (mBottom.cols() > 0) ? VectorXd(mBottom.col(0)) : VectorXd(); }
+      /** Number of matrix vector products used by the last solve. */
+      int iterations () { return mIterations; }
+      /** The underlying solver (to change its tolerance or basis size). */
+      LanczosSolver & solver () { return mSolver; }
+      
+      void addNode  (System &sys, Node n);
+      void addArc   (System &sys, Node source, Node target);
+      void erase    (System &sys, Node n);
+      void erase    (System &sys, Arc e);
+   };
+   
+   /** Eigenratio lambda_N / lambda_2 of the laplacian (smaller is more synchronisable). While 
+    *  tracking a System each evaluation is warm started from the last (see LaplacianSpectrum). */
+   class EigenratioPerformance : public IncrementalPerformance {
+   private:
+      LaplacianSpectrum mSpectrum;
+      
+   public:
+      double performance (System &sys, pair<vector<State>*,vector<double>*> *dyn);
+      void   reset (System &sys) { mSpectrum.reset(sys); }
+      double currentPerformance ();
+      
+      /** The spectrum of the tracked System. */
+      LaplacianSpectrum & spectrum () { return mSpectrum; }
+      
+      void addNode  (System &sys, Node n)                    { mSpectrum.addNode(sys, n); }
+      void addArc   (System &sys, Node source, Node target)  { mSpectrum.addArc(sys, source, target); }
+      void erase    (System &sys, Node n)                    { mSpectrum.erase(sys, n); }
+      void erase    (System &sys, Arc e)                     { mSpectrum.erase(sys, e); }
+   };
+   
+   /** One minus the Kuramoto order parameter of the given node state, averaged over the 
+    *  simulation from time tStart (see SimObserverOrderParameter). 0 when the phases stay 
+    *  synchronised. Calculated while simulating, without storing the trajectory. The lower bound 
+    *  part way through a run assumes the remaining observations are evenly spaced in time (as for 
+    *  SimulateMap, SimulateOdeFixed and SimulateOdeConst) and all fully synchronised. */
+   class OrderParameterPerformance : public BoundedPerformance {
+   private:
+      int    mState;
+      double mTStart;
+      
+   public:
+      OrderParameterPerformance (int state = 0, double tStart = 0.0) : mState(state), mTStart(tStart) { }
+      
+      SimReducer * reducer (System &sys) { return new SimObserverOrderParameter(sys, mState, mTStart); }
+      double       result (System &sys, SimReducer &reducer) { return 1.0 - reducer.result(); }
+      double       lowerBound (System &sys, SimReducer &reducer, double tMax);
+      double       minimum () { return 0.0; }
+   };
+   
+   /** Synchronisation error of the node states averaged over the simulation from time tStart 
+    *  (see SimObserverSyncError). Calculated while simulating, without storing the trajectory. 
+    *  The lower bound part way through a run assumes the remaining observations are evenly 
+    *  spaced in time and all have no error (see OrderParameterPerformance). */
+   class SyncErrorPerformance : public BoundedPerformance {
+   private:
+      double mTStart;
+      
+   public:
+      SyncErrorPerformance (double tStart = 0.0) : mTStart(tStart) { }
+      
+      SimReducer * reducer (System &sys) { return new SimObserverSyncError(sys, mTStart); }
+      double       lowerBound (System &sys, SimReducer &reducer, double tMax);
+      double       minimum () { return 0.0; }
+   };
+   
+} // netevo namespace
+
+#endif // NE_PERFORMANCE_H
@@ -0,0 +1,112 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ NetEvo is a computing framework designed to allow researchers to investigate
+ evolutionary aspects of dynamical complex networks. By providing tools to
+ easily integrate each of these factors in a coherent way, it is hoped a
+ greater understanding can be gained of key attributes and features displayed
+ by complex systems.
+
+ NetEvo is open-source software released under the Open Source Initiative
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0.
+ Detailed information about this licence can be found in the COPYING file
+ included as part of the source distribution.
+
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "profile.h"
+
+namespace netevo {
+
+   Profile & Profile::instance () {
+      static Profile profile;
+      return profile;
+   }
+
+   bool Profile::enabled () {
+#ifdef NE_PROFILE
+      return true;
+#else
+      return false;
+#endif
+   }
+
+   void Profile::reset () {
+      for (int i=0; i<PROF_COUNTERS; ++i) { mCounters[i].store(0, memory_order_relaxed); }
+      for (int i=0; i<PROF_TIMERS; ++i) {
+         mTimerCalls[i].store(0, memory_order_relaxed);
+         mTimerNanos[i].store(0, memory_order_relaxed);
+      }
+      lock_guard<mutex> lock(mTempsLock);
+      mTemps.clear();
+   }
+
+   void Profile::decision (double temp, bool accepted) {
+      count(accepted ? PROF_ACCEPTS : PROF_REJECTS, 1);
+      lock_guard<mutex> lock(mTempsLock);
+      map<double, profile_temp_t>::iterator it = mTemps.find(temp);
+      if (it == mTemps.end()) {
+         profile_temp_t entry = { 0, 0 };
+         it = mTemps.insert(pair<double, profile_temp_t>(temp, entry)).first;
+      }
+      if (accepted) { it->second.accepts++; }
+      else { it->second.rejects++; }
+   }
+
+   profile_data_t Profile::data () {
+      profile_data_t data;
+      data.enabled = enabled();
+      for (int i=0; i<PROF_COUNTERS; ++i) { data.counters[i] = mCounters[i].load(memory_order_relaxed); }
+      for (int i=0; i<PROF_TIMERS; ++i) {
+         data.timerCalls[i] = mTimerCalls[i].load(memory_order_relaxed);
+         data.timerSeconds[i] = mTimerNanos[i].load(memory_order_relaxed) * 1e-9;
+      }
+      lock_guard<mutex> lock(mTempsLock);
+      data.temps = mTemps;
+      return data;
+   }
+
+   const char * Profile::name (profile_counter_e counter) {
+      static const char *names[PROF_COUNTERS] = { "rhs_calls", "steps_accepted", "steps_rejected",
+                                                  "trials", "accepts", "rejects", "bytes_logged" };
+      return names[counter];
+   }
+
+   const char * Profile::name (profile_timer_e timer) {
+      static const char *names[PROF_TIMERS] = { "copy", "mutate", "simulate", "observe", "log",
+                                                "performance" };
+      return names[timer];
+   }
+
+   void Profile::writeJSON (ostream &out, const profile_data_t &data) {
+      streamsize prevPrecision = out.precision(17);
+      out << "{\"enabled\":" << (data.enabled ? "true" : "false") << ",\"counters\":{";
+      for (int i=0; i<PROF_COUNTERS; ++i) {
+         out << (i > 0 ? "," : "") << "\"" << name((profile_counter_e)i) << "\":" << data.counters[i];
+      }
+      out << "},\"timers\":{";
+      for (int i=0; i<PROF_TIMERS; ++i) {
+         out << (i > 0 ? "," : "") << "\"" << name((profile_timer_e)i) << "\":{\"calls\":"
+             << data.timerCalls[i] << ",\"seconds\":" << data.timerSeconds[i] << "}";
+      }
+      // Temperatures from the highest (the order they are visited)
+      out << "},\"temperatures\":[";
+      for (map<double, profile_temp_t>::const_reverse_iterator it = data.temps.rbegin();
+           it != data.temps.rend(); ++it) {
+         out << (it != data.temps.rbegin() ? "," : "") << "{\"temp\":" << it->first
+             << ",\"accepts\":" << it->second.accepts << ",\"rejects\":" << it->second.rejects << "}";
+      }
+      out << "]}" << endl;
+      out.precision(prevPrecision);
+   }
+
+} // netevo namespace
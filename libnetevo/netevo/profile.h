@@ -0,0 +1,156 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ NetEvo is a computing framework designed to allow researchers to investigate
+ evolutionary aspects of dynamical complex networks. By providing tools to
+ easily integrate each of these factors in a coherent way, it is hoped a
+ greater understanding can be gained of key attributes and features displayed
+ by complex systems.
+
+ NetEvo is open-source software released under the Open Source Initiative
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0.
+ Detailed information about this licence can be found in the COPYING file
+ included as part of the source distribution.
+
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_PROFILE_H
+#define NE_PROFILE_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+
+using namespace std;
+
+namespace netevo {
+
+   /** Events counted by the Profile */
+   enum profile_counter_e {
+      PROF_RHS_CALLS      = 0, /** Evaluations of the dynamics (System::operator()) */
+      PROF_STEPS_ACCEPTED = 1, /** Steps accepted by the controlled steppers */
+      PROF_STEPS_REJECTED = 2, /** Steps rejected (and retried) by the controlled steppers */
+      PROF_TRIALS         = 3, /** Trial Systems generated by EvolveSA */
+      PROF_ACCEPTS        = 4, /** Trials accepted by EvolveSA */
+      PROF_REJECTS        = 5, /** Trials rejected by EvolveSA */
+      PROF_BYTES_LOGGED   = 6, /** Bytes written by ChangeLogs and trajectory files */
+      PROF_COUNTERS       = 7
+   };
+
+   /** Sections of code timed by the Profile */
+   enum profile_timer_e {
+      PROF_COPY        = 0, /** Copying trial Systems (EvolveSA) */
+      PROF_MUTATE      = 1, /** Mutating trial Systems (EvolveSA) */
+      PROF_SIMULATE    = 2, /** Simulating trial Systems (EvolveSA, includes observing and logging) */
+      PROF_OBSERVE     = 3, /** SimObservers called by the simulators */
+      PROF_LOG         = 4, /** ChangeLogs called by the simulators */
+      PROF_PERFORMANCE = 5, /** Performance of trial Systems (EvolveSA, includes simulating) */
+      PROF_TIMERS      = 6
+   };
+
+   /** Trials decided by EvolveSA at a single temperature */
+   typedef struct {
+      uint64_t accepts;
+      uint64_t rejects;
+   } profile_temp_t;
+
+   /** Copy of the counters and timers of the Profile at some point in time */
+   typedef struct {
+      bool     enabled;
+      uint64_t counters[PROF_COUNTERS];
+      uint64_t timerCalls[PROF_TIMERS];
+      double   timerSeconds[PROF_TIMERS];
+      /** Accepts and rejects of EvolveSA by temperature */
+      map<double, profile_temp_t> temps;
+   } profile_data_t;
+
+   /** Counters and timers for the simulation and evolution code of the library.
+    *  The library is only instrumented when built with NE_PROFILE defined (configure with
+    *  --enable-profile). Otherwise the NE_PROFILE_* macros compile to nothing and the Profile
+    *  stays empty. Counters and timers are shared by all threads and Systems (so the time of
+    *  sections run in parallel is summed over the threads). Timed sections can be nested, e.g.
+    *  PROF_PERFORMANCE includes PROF_SIMULATE which includes PROF_OBSERVE and PROF_LOG. */
+   class Profile {
+   private:
+      atomic<uint64_t> mCounters[PROF_COUNTERS];
+      atomic<uint64_t> mTimerCalls[PROF_TIMERS];
+      atomic<uint64_t> mTimerNanos[PROF_TIMERS];
+      mutex mTempsLock;
+      map<double, profile_temp_t> mTemps;
+
+      Profile () { reset(); }
+      Profile (const Profile &);
+
+   public:
+      /** The Profile used by the library */
+      static Profile & instance ();
+
+      /** Whether the library was built with profiling (NE_PROFILE) */
+      static bool enabled ();
+
+      /** Clear all counters and timers */
+      void reset ();
+
+      void count (profile_counter_e counter, uint64_t n) {
+         mCounters[counter].fetch_add(n, memory_order_relaxed);
+      }
+      void time (profile_timer_e timer, uint64_t nanos) {
+         mTimerCalls[timer].fetch_add(1, memory_order_relaxed);
+         mTimerNanos[timer].fetch_add(nanos, memory_order_relaxed);
+      }
+      /** Count a trial accepted or rejected by EvolveSA at a temperature */
+      void decision (double temp, bool accepted);
+
+      /** Copy of the current counters and timers */
+      profile_data_t data ();
+
+      /** Name of a counter or timer (as used in the JSON output) */
+      static const char * name (profile_counter_e counter);
+      static const char * name (profile_timer_e timer);
+
+      /** Write profile data as a single line JSON object */
+      static void writeJSON (ostream &out, const profile_data_t &data);
+      /** Write the current counters and timers as a single line JSON object */
+      void writeJSON (ostream &out) { writeJSON(out, data()); }
+   };
+
+   /** Adds the time from construction to destruction to a timer of the Profile */
+   class ProfileTimer {
+   private:
+      profile_timer_e mTimer;
+      chrono::steady_clock::time_point mStart;
+   public:
+      ProfileTimer (profile_timer_e timer) : mTimer(timer), mStart(chrono::steady_clock::now()) { }
+      ~ProfileTimer () {
+         Profile::instance().time(mTimer, (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+                                          chrono::steady_clock::now() - mStart).count());
+      }
+   };
+
+#define NE_PROFILE_JOIN2(a, b) a##b
+#define NE_PROFILE_JOIN(a, b) NE_PROFILE_JOIN2(a, b)
+
+#ifdef NE_PROFILE
+   /** Add n to a counter of the Profile */
+#define NE_PROFILE_COUNT(counter, n) netevo::Profile::instance().count(counter, n)
+   /** Time the rest of the enclosing scope */
+#define NE_PROFILE_SCOPE(timer) netevo::ProfileTimer NE_PROFILE_JOIN(neProfileTimer, __LINE__)(timer)
+   /** Count a trial decided by EvolveSA */
+#define NE_PROFILE_DECISION(temp, accepted) netevo::Profile::instance().decision(temp, accepted)
+#else
+#define NE_PROFILE_COUNT(counter, n) ((void)0)
+#define NE_PROFILE_SCOPE(timer) ((void)0)
+#define NE_PROFILE_DECISION(temp, accepted) ((void)0)
+#endif
+
+} // netevo namespace
+
+#endif // NE_PROFILE_H
@@ -19,14 +19,156 @@
  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
  ============================================================================*/
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "simulate.h"
+#include "compiled.h"
+#include "profile.h"
 #include <boost/numeric/odeint.hpp>
 #include <boost/numeric/odeint/stepper/adams_bashforth_moulton.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#include <boost/numeric/odeint/external/openmp/openmp.hpp>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 using namespace boost::numeric::odeint;
 
 namespace netevo {
 
+   SimObserverToBuffer::SimObserverToBuffer (int capacity, int states) {
+      mCapacity = capacity;
+      mStride = states;
+      mSize = 0;
+      mDropped = 0;
+      mTimes.resize(capacity);
+      if (states > 0) { mData.resize(capacity * states); }
+   }
+   
+   void SimObserverToBuffer::operator() (const State &x, double t) {
+      // The stride is fixed by the first state if not given
+      if (mStride == 0 && mSize == 0) {
+         mStride = x.size();
+         mData.resize(mCapacity * mStride);
+      }
+      if (mSize == mCapacity || (int)x.size() != mStride) {
+         mDropped++;
+         return;
+      }
+      std::copy(x.begin(), x.end(), mData.begin() + (mSize * mStride));
+      mTimes[mSize] = t;
+      mSize++;
+   }
+   
+   SimObserverRing::SimObserverRing (int capacity, int states) {
+      mCapacity = capacity;
+      mStride = states;
+      mHead = 0;
+      mSize = 0;
+      mTimes.resize(capacity);
+      if (states > 0) { mData.resize(capacity * states); }
+   }
+   
+   void SimObserverRing::operator() (const State &x, double t) {
+      if (mCapacity <= 0) { return; }
+      // A change in the number of states starts the ring again
+      if ((int)x.size() != mStride) {
+         mStride = x.size();
+         mData.resize(mCapacity * mStride);
+         mHead = 0;
+         mSize = 0;
+      }
+      std::copy(x.begin(), x.end(), mData.begin() + (mHead * mStride));
+      mTimes[mHead] = t;
+      mHead = (mHead + 1) % mCapacity;
+      if (mSize < mCapacity) { mSize++; }
+   }
+   
+   void SimObserverMeanVar::operator() (const State &x, double t) {
+      int i, n = x.size();
+      double d;
+      if (mCount == 0) {
+         mMean.assign(n, 0.0);
+         mM2.assign(n, 0.0);
+      }
+      else if ((int)mMean.size() != n) {
+         cerr << "State size has changed (SimObserverMeanVar)" << endl;
+         return;
+      }
+      mCount++;
+      for (i=0; i<n; ++i) {
+         d = x[i] - mMean[i];
+         mMean[i] += d / mCount;
+         mM2[i] += d * (x[i] - mMean[i]);
+      }
+   }
+   
+   SimObserverOrderParameter::SimObserverOrderParameter (System &sys, int state, double tStart) {
+      mNodes = sys.nodeCount();
+      mNodeStates = sys.nodeStates();
+      mState = state;
+      mTStart = tStart;
+      mSum = 0.0;
+      mLast = 0.0;
+      mCount = 0;
+      mTFirst = 0.0;
+      mTLast = 0.0;
+   }
+   
+   void SimObserverOrderParameter::operator() (const State &x, double t) {
+      int i;
+      double c = 0.0, s = 0.0;
+      if (t < mTStart || mNodes == 0) { return; }
+      // Node states come first in the state vector, ordered by node ID
+      for (i=0; i<mNodes; ++i) {
+         c += cos(x[i * mNodeStates + mState]);
+         s += sin(x[i * mNodeStates + mState]);
+      }
+      mLast = sqrt(c * c + s * s) / mNodes;
+      mSum += mLast;
+      if (mCount == 0) { mTFirst = t; }
+      mTLast = t;
+      mCount++;
+   }
+   
+   SimObserverSyncError::SimObserverSyncError (System &sys, double tStart) {
+      mNodes = sys.nodeCount();
+      mNodeStates = sys.nodeStates();
+      mMean.assign(mNodeStates, 0.0);
+      mTStart = tStart;
+      mSum = 0.0;
+      mLast = 0.0;
+      mCount = 0;
+      mTFirst = 0.0;
+      mTLast = 0.0;
+   }
+   
+   void SimObserverSyncError::operator() (const State &x, double t) {
+      int i, j;
+      double d, e = 0.0;
+      if (t < mTStart || mNodes == 0) { return; }
+      for (j=0; j<mNodeStates; ++j) { mMean[j] = 0.0; }
+      for (i=0; i<mNodes; ++i) {
+         for (j=0; j<mNodeStates; ++j) { mMean[j] += x[i * mNodeStates + j]; }
+      }
+      for (j=0; j<mNodeStates; ++j) { mMean[j] /= mNodes; }
+      for (i=0; i<mNodes; ++i) {
+         for (j=0; j<mNodeStates; ++j) {
+            d = x[i * mNodeStates + j] - mMean[j];
+            e += d * d;
+         }
+      }
+      mLast = sqrt(e / mNodes);
+      mSum += mLast;
+      if (mCount == 0) { mTFirst = t; }
+      mTLast = t;
+      mCount++;
+   }
+
    void SimulateMap::simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger) {
       
       // We are in discrete time so use integers for time
@@ -51,6 +193,7 @@ namespace netevo {
       logger.endStep(SIM_STEP);
       logger.commit();
       obs(y1, 0.0);
+      if (obs.stop()) { return; }
       
       // Loop through all time steps and calculate new states
       for (t = 1; t <= tEnd; t++) {
@@ -59,29 +202,316 @@ namespace netevo {
             // Simulate the dynamics
             sys(y1, y2, (double)t);
             // Log the state change
-            logger.newState (sys, y2);
-            logger.endStep(SIM_STEP);
-            logger.commit();
+            {
+               NE_PROFILE_SCOPE(PROF_LOG);
+               logger.newState (sys, y2);
+               logger.endStep(SIM_STEP);
+               logger.commit();
+            }
             // Send result to the observer
-            obs(y2, (double)t);
+            {
+               NE_PROFILE_SCOPE(PROF_OBSERVE);
+               obs(y2, (double)t);
+            }
          }
          else {
             // Use y2 as old and y1 as new
             // Simulate the dynamics
             sys(y2, y1, (double)t);
             // Log the state change
-            logger.newState (sys, y1);
-            logger.endStep(SIM_STEP);
-            logger.commit();
+            {
+               NE_PROFILE_SCOPE(PROF_LOG);
+               logger.newState (sys, y1);
+               logger.endStep(SIM_STEP);
+               logger.commit();
+            }
             // Send result to the observer
-            obs(y1, (double)t);
+            {
+               NE_PROFILE_SCOPE(PROF_OBSERVE);
+               obs(y1, (double)t);
+            }
          }
+         // End early if asked to (leaving t as the loop would)
+         if (obs.stop()) {
+            t++;
+            break;
+         }
+      }
+      
+      // Ensure the initial vector is updated to the final result (swapping avoids a copy)
+      initial.swap(( t%2 == 0 )  ? y1 : y2);
+   }
+   
+   void SimulateMapSparse::simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger) {
+      int i, k, a;
+      int t = 0, tEnd = (int)tMax;
+      int states = (countNodes(sys)*sys.nodeStates()) + (countArcs(sys)*sys.arcStates());
+      mUpdates = 0;
+      
+      // Check to ensure that initial conditions are correct size
+      if (initial.size() < states || initial.size() > states) {
+         cerr << "Incorrect number of states for initial conditions (SimulateMapSparse::simulate)" << endl;
+         return;
+      }
+      
+      // Activity is only tracked for nodes
+      if (sys.arcStates() > 0 || sys.nodeStates() == 0) {
+         SimulateMap sim;
+         sim.simulate(sys, tMax, initial, obs, logger);
+         return;
+      }
+      
+      // Check that the state IDs are correct, if not refresh
+      if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
+      
+      int n = sys.nodeCount(), ns = sys.nodeStates();
+      
+      // Dynamics of each node (using fnBatch for single nodes of a compiled System)
+      CompiledSystem *cs = sys.isCompiled() ? sys.compiled() : NULL;
+      vector<Node> node(n);
+      vector<NodeDynamic *> dyn(n);
+      vector<char> batch(n);
+      for (i=0; i<n; ++i) {
+         node[i] = sys.getNode(i);
+         dyn[i] = sys.nodeData(node[i]).dynamic;
+         batch[i] = (cs != NULL && dyn[i]->hasBatch());
       }
       
-      // Ensure the initial vector is updated to the final result
-      initial = ( t%2 == 0 )  ? y1 : y2;
+      // Out-neighbours of each node
+      vector<int> outOffset(n + 1, 0), outTarget(countArcs(sys));
+      for (System::ArcIt e(sys); e != INVALID; ++e) { outOffset[sys.nodeID(sys.source(e)) + 1]++; }
+      for (i=0; i<n; ++i) { outOffset[i + 1] += outOffset[i]; }
+      vector<int> next(outOffset.begin(), outOffset.end() - 1);
+      for (System::ArcIt e(sys); e != INVALID; ++e) {
+         outTarget[next[sys.nodeID(sys.source(e))]++] = sys.nodeID(sys.target(e));
+      }
+      
+      // The state is updated in place, new states being calculated into y
+      State y = State(initial);
+      
+      // Send the observer the initial conditions
+      logger.newState(sys, initial);
+      logger.endStep(SIM_STEP);
+      logger.commit();
+      obs(initial, 0.0);
+      if (obs.stop()) { return; }
+      
+      // Every node is active to begin with
+      vector<int> active(n), changed, nextActive;
+      vector<int> mark(n, 0);
+      for (i=0; i<n; ++i) { active[i] = i; }
+      
+      for (t = 1; t <= tEnd; t++) {
+         // New states of the active nodes (from the previous state)
+         for (k=0; k<(int)active.size(); ++k) {
+            i = active[k];
+            if (batch[i]) { dyn[i]->fnBatch(*cs, i, i + 1, initial, y, (double)t); }
+            else { dyn[i]->fn(node[i], sys, initial, y, (double)t); }
+         }
+         mUpdates += active.size();
+         
+         // Find the nodes that changed
+         changed.clear();
+         for (k=0; k<(int)active.size(); ++k) {
+            int vID = active[k] * ns;
+            for (a=0; a<ns; ++a) {
+               if (y[vID + a] != initial[vID + a]) {
+                  changed.push_back(active[k]);
+                  break;
+               }
+            }
+         }
+         for (k=0; k<(int)changed.size(); ++k) {
+            int vID = changed[k] * ns;
+            for (a=0; a<ns; ++a) { initial[vID + a] = y[vID + a]; }
+         }
+         
+         // Log and observe the changes
+         {
+            NE_PROFILE_SCOPE(PROF_LOG);
+            logger.stateDelta(sys, initial, changed);
+            logger.endStep(SIM_STEP);
+            logger.commit();
+         }
+         {
+            NE_PROFILE_SCOPE(PROF_OBSERVE);
+            obs.stateDelta(initial, changed, (double)t);
+         }
+         if (obs.stop()) { break; }
+         
+         // Nodes that changed and their out-neighbours are active in the next step
+         nextActive.clear();
+         for (k=0; k<(int)changed.size(); ++k) {
+            i = changed[k];
+            if (mark[i] != t) { mark[i] = t; nextActive.push_back(i); }
+            for (int j=outOffset[i]; j<outOffset[i+1]; ++j) {
+               int u = outTarget[j];
+               if (mark[u] != t) { mark[u] = t; nextActive.push_back(u); }
+            }
+         }
+         active.swap(nextActive);
+      }
    }
 
+   /** Thrown to end an odeint integration early (odeint has no other way to stop) */
+   struct sim_stopped_t { };
+   
+   /** Passes observations on (as ObserverPassThrough) until the observer asks to stop. */
+   class ObserverUntilStop {
+   private:
+      System      &mSys;
+      SimObserver &mObs;
+      ChangeLog   &mLogger;
+   public:
+      ObserverUntilStop (System &sys, SimObserver &obs, ChangeLog &logger) : mSys(sys), mObs(obs), mLogger(logger) { }
+      ObserverUntilStop (const ObserverUntilStop &obs) : mSys(obs.mSys), mObs(obs.mObs), mLogger(obs.mLogger) { }
+      void operator() (const State &x, double t) {
+         {
+            NE_PROFILE_SCOPE(PROF_LOG);
+            mLogger.newState(mSys, x);
+            mLogger.endStep(SIM_STEP);
+            mLogger.commit();
+         }
+         {
+            NE_PROFILE_SCOPE(PROF_OBSERVE);
+            mObs(x, t);
+         }
+         if (mObs.stop()) { throw sim_stopped_t(); }
+      }
+   };
+   
+   /** Controlled stepper that counts the steps accepted and rejected (see Profile). Without 
+    *  NE_PROFILE the stepper is used directly. */
+   template <class Controlled>
+   class ControlledCounter {
+   private:
+      Controlled mStepper;
+   public:
+      typedef typename Controlled::state_type state_type;
+      typedef typename Controlled::deriv_type deriv_type;
+      typedef typename Controlled::value_type value_type;
+      typedef typename Controlled::time_type time_type;
+      typedef controlled_stepper_tag stepper_category;
+      
+      ControlledCounter (const Controlled &stepper) : mStepper(stepper) { }
+      
+      template <class Sys, class StateInOut>
+      controlled_step_result try_step (Sys system, StateInOut &x, time_type &t, time_type &dt) {
+         controlled_step_result res = mStepper.try_step(system, x, t, dt);
+         NE_PROFILE_COUNT((res == success) ? PROF_STEPS_ACCEPTED : PROF_STEPS_REJECTED, 1);
+         return res;
+      }
+   };
+   
+#ifdef NE_PROFILE
+   template <class Controlled>
+   static ControlledCounter<Controlled> counted (const Controlled &stepper) { return ControlledCounter<Controlled>(stepper); }
+#else
+   template <class Controlled>
+   static const Controlled & counted (const Controlled &stepper) { return stepper; }
+#endif
+   
+   template <class Algebra>
+   static void integrateFixed (fixed_step_type_e stepper, System &sys, double tMax, State &initial, 
+                               double stepSize, SimObserver &obs, ChangeLog &logger) {
+      
+      // Create the required steppers
+      typedef runge_kutta4<State, double, State, double, Algebra> rk4_stepper_type;
+      typedef adams_bashforth_moulton<5, State, double, State, double, Algebra> adams_bash_moul_stepper_type;
+      
+      // Solve the system (until the end or the observer asks to stop)
+      try {
+         switch (stepper) {
+            case RK_4:
+               integrate_const(rk4_stepper_type(),
+                                       Simulator(&sys), initial, 0.0, tMax, stepSize, ObserverUntilStop(sys, obs, logger));
+               break;
+            case ADAM_BASH_MOUL:
+               integrate_const(adams_bash_moul_stepper_type(), 
+                                       Simulator(&sys), initial, 0.0, tMax, stepSize, ObserverUntilStop(sys, obs, logger));
+               break;
+            default:
+               // Do nothing
+               break;
+         }
+      }
+      catch (sim_stopped_t &) { }
+   }
+   
+   template <class Algebra>
+   static void integrateConst (adaptive_step_type_e stepper, System &sys, double tMax, State &initial, 
+                               double epsAbs, double epsRel, double outputStep, SimObserver &obs, 
+                               ChangeLog &logger) {
+      
+      // Create the required steppers
+      typedef runge_kutta_cash_karp54<State, double, State, double, Algebra> rkck54_error_stepper_type;
+      typedef runge_kutta_dopri5<State, double, State, double, Algebra> dopri5_error_stepper_type;      
+      
+      // Solve the system (until the end or the observer asks to stop)
+      try {
+         switch (stepper) {
+            case RK_CASH_KARP_54:
+               integrate_const(counted(make_controlled( epsAbs , epsRel , rkck54_error_stepper_type() )), 
+                                       Simulator(&sys), initial, 0.0, tMax, outputStep, ObserverUntilStop(sys, obs, logger));
+               break;
+            case RK_DOPRI_5:
+               integrate_const(counted(make_controlled( epsAbs , epsRel , dopri5_error_stepper_type() )), 
+                                       Simulator(&sys), initial, 0.0, tMax, outputStep, ObserverUntilStop(sys, obs, logger));
+               break;
+            case RK_DOPRI_5_DENSE:
+               integrate_const(make_dense_output( epsAbs , epsRel , dopri5_error_stepper_type() ),
+                                       Simulator(&sys), initial, 0.0, tMax, outputStep, ObserverUntilStop(sys, obs, logger));
+               break;
+            default:
+               // Do nothing
+               break;
+         }
+      }
+      catch (sim_stopped_t &) { }
+   }
+   
+   template <class Algebra>
+   static void integrateAdaptive (adaptive_step_type_e stepper, System &sys, double tMax, State &initial, 
+                                  double epsAbs, double epsRel, double initialStep, SimObserver &obs, 
+                                  ChangeLog &logger) {
+      
+      // Create the required steppers
+      typedef runge_kutta_cash_karp54<State, double, State, double, Algebra> rkck54_error_stepper_type;
+      typedef runge_kutta_dopri5<State, double, State, double, Algebra> dopri5_error_stepper_type;     
+      
+      // Solve the system (until the end or the observer asks to stop)
+      try {
+         switch (stepper) {
+            case RK_CASH_KARP_54:
+               integrate_adaptive(counted(make_controlled( epsAbs , epsRel , rkck54_error_stepper_type() )), 
+                                          Simulator(&sys), initial, 0.0, tMax, initialStep, ObserverUntilStop(sys, obs, logger));
+               break;
+            case RK_DOPRI_5:
+               integrate_adaptive(counted(make_controlled( epsAbs , epsRel , dopri5_error_stepper_type() )),
+                                          Simulator(&sys), initial, 0.0, tMax, initialStep, ObserverUntilStop(sys, obs, logger));
+               break;
+            case RK_DOPRI_5_DENSE:
+               integrate_adaptive(make_dense_output( epsAbs , epsRel , dopri5_error_stepper_type() ),
+                                          Simulator(&sys), initial, 0.0, tMax, initialStep, ObserverUntilStop(sys, obs, logger));
+               break;
+            default:
+               // Do nothing
+               break;
+         }
+      }
+      catch (sim_stopped_t &) { }
+   }
+   
+   /** Threads to use for the vector operations of a System (0 if they should be serial) */
+   static int parallelThreads (System &sys) {
+#ifdef _OPENMP
+      if (sys.isCompiled() && sys.threads() != 1) {
+         return (sys.threads() > 0) ? sys.threads() : omp_get_max_threads();
+      }
+#endif
+      return 0;
+   }
+   
    void SimulateOdeFixed::simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger) {
       
       // Check to ensure that initial conditions are correct size
@@ -93,25 +523,19 @@ namespace netevo {
 
       // Check that the state IDs are correct, if not refresh
       if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
-
-      // Create the required steppers
-      typedef runge_kutta4<State> rk4_stepper_type;
-      typedef adams_bashforth_moulton<5,State> adams_bash_moul_stepper_type;
-      
-      // Solve the system
-      switch (mStepper) {
-         case RK_4:
-            integrate_const(rk4_stepper_type(),
-                                    Simulator(&sys), initial, 0.0, tMax, mStepSize, ObserverPassThrough(sys, obs, logger));
-            break;
-         case ADAM_BASH_MOUL:
-            integrate_const(adams_bash_moul_stepper_type(), 
-                                    Simulator(&sys), initial, 0.0, tMax, mStepSize, ObserverPassThrough(sys, obs, logger));
-            break;
-         default:
-            // Do nothing
-            break;
+      
+      // Large Systems share the vector operations between threads as well as the dynamics
+      int threads = parallelThreads(sys);
+#ifdef _OPENMP
+      if (threads > 0) {
+         int prevThreads = omp_get_max_threads();
+         omp_set_num_threads(threads);
+         integrateFixed<openmp_range_algebra>(mStepper, sys, tMax, initial, mStepSize, obs, logger);
+         omp_set_num_threads(prevThreads);
+         return;
       }
+#endif
+      integrateFixed<range_algebra>(mStepper, sys, tMax, initial, mStepSize, obs, logger);
    }
 
 
@@ -127,28 +551,20 @@ namespace netevo {
       // Check that the state IDs are correct, if not refresh
       if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
       
-      // Create the required steppers
-      typedef runge_kutta_cash_karp54<State> rkck54_error_stepper_type;
-      typedef runge_kutta_dopri5<State> dopri5_error_stepper_type;      
-      
-      // Solve the system
-      switch (mStepper) {
-         case RK_CASH_KARP_54:
-            integrate_const(make_controlled( mEpsAbs , mEpsRel , rkck54_error_stepper_type() ), 
-                                    Simulator(&sys), initial, 0.0, tMax, mOutputStep, ObserverPassThrough(sys, obs, logger));
-            break;
-         case RK_DOPRI_5:
-            integrate_const(make_controlled( mEpsAbs , mEpsRel , dopri5_error_stepper_type() ), 
-                                    Simulator(&sys), initial, 0.0, tMax, mOutputStep, ObserverPassThrough(sys, obs, logger));
-            break;
-         case RK_DOPRI_5_DENSE:
-            integrate_const(make_dense_output( mEpsAbs , mEpsRel , dopri5_error_stepper_type() ),
-                                    Simulator(&sys), initial, 0.0, tMax, mOutputStep, ObserverPassThrough(sys, obs, logger));
-            break;
-         default:
-            // Do nothing
-            break;
+      // Large Systems share the vector operations between threads as well as the dynamics
+      int threads = parallelThreads(sys);
+#ifdef _OPENMP
+      if (threads > 0) {
+         int prevThreads = omp_get_max_threads();
+         omp_set_num_threads(threads);
+         integrateConst<openmp_range_algebra>(mStepper, sys, tMax, initial, mEpsAbs, mEpsRel, 
+                                              mOutputStep, obs, logger);
+         omp_set_num_threads(prevThreads);
+         return;
       }
+#endif
+      integrateConst<range_algebra>(mStepper, sys, tMax, initial, mEpsAbs, mEpsRel, mOutputStep, 
+                                    obs, logger);
    }
 
    void SimulateOdeAdaptive::simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger) {
@@ -163,27 +579,176 @@ namespace netevo {
       // Check that the state IDs are correct, if not refresh
       if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
       
-      // Create the required steppers
-      typedef runge_kutta_cash_karp54<State> rkck54_error_stepper_type;
-      typedef runge_kutta_dopri5<State> dopri5_error_stepper_type;     
-      
-      // Solve the system
-      switch (mStepper) {
-         case RK_CASH_KARP_54:
-            integrate_adaptive(make_controlled( mEpsAbs , mEpsRel , rkck54_error_stepper_type() ), 
-                                       Simulator(&sys), initial, 0.0, tMax, mInitialStep, ObserverPassThrough(sys, obs, logger));
-            break;
-         case RK_DOPRI_5:
-            integrate_adaptive(make_controlled( mEpsAbs , mEpsRel , dopri5_error_stepper_type() ),
-                                       Simulator(&sys), initial, 0.0, tMax, mInitialStep, ObserverPassThrough(sys, obs, logger));
-            break;
-         case RK_DOPRI_5_DENSE:
-            integrate_adaptive(make_dense_output( mEpsAbs , mEpsRel , dopri5_error_stepper_type() ),
-                                       Simulator(&sys), initial, 0.0, tMax, mInitialStep, ObserverPassThrough(sys, obs, logger));
-            break;
-         default:
-            // Do nothing
-            break;
+      // Large Systems share the vector operations between threads as well as the dynamics
+      int threads = parallelThreads(sys);
+#ifdef _OPENMP
+      if (threads > 0) {
+         int prevThreads = omp_get_max_threads();
+         omp_set_num_threads(threads);
+         integrateAdaptive<openmp_range_algebra>(mStepper, sys, tMax, initial, mEpsAbs, mEpsRel, 
+                                                 mInitialStep, obs, logger);
+         omp_set_num_threads(prevThreads);
+         return;
+      }
+#endif
+      integrateAdaptive<range_algebra>(mStepper, sys, tMax, initial, mEpsAbs, mEpsRel, mInitialStep, 
+                                       obs, logger);
+   }
+
+   /** Dense output of an accepted Runge Kutta Dormand & Prince (5) step, interpolated using the 
+    *  stages kept by the stepper. */
+   template <class Stepper>
+   class Dopri5Interpolant : public StepInterpolant {
+   private:
+      const Stepper &mStepper;
+      const State   &mX0, &mDx0, &mX1, &mDx1;
+      double         mT0, mT1;
+   public:
+      Dopri5Interpolant (const Stepper &stepper, const State &x0, const State &dx0, double t0, 
+                         const State &x1, const State &dx1, double t1) 
+         : mStepper(stepper), mX0(x0), mDx0(dx0), mX1(x1), mDx1(dx1), mT0(t0), mT1(t1) { }
+      double tStart () const { return mT0; }
+      double tEnd () const { return mT1; }
+      const State & startState () const { return mX0; }
+      const State & endState () const { return mX1; }
+      void state (double t, State &x) const {
+         if (x.size() != mX0.size()) { x.resize(mX0.size()); }
+         mStepper.calc_state(t, x, mX0, mDx0, mT0, mX1, mDx1, mT1);
+      }
+   };
+   
+   /** Evaluates the dynamics of a System, counting the evaluations. */
+   class SimulatorCounted {
+   private:
+      System *mSys;
+      int    *mEvaluations;
+   public:
+      SimulatorCounted (System *sys, int *evaluations) : mSys(sys), mEvaluations(evaluations) { }
+      void operator() (const State &x, State &dx, const double t) {
+         (*mSys)(x, dx, t);
+         (*mEvaluations)++;
+      }
+   };
+   
+   template <class Algebra>
+   static void integrateDense (System &sys, double tMax, State &initial, double epsAbs, double epsRel, 
+                               double initialStep, SimObserver &obs, int &steps, int &rejected, 
+                               int &evaluations, double &minStep, double &maxStep) {
+      typedef runge_kutta_dopri5<State, double, State, double, Algebra> dopri5_error_stepper_type;
+      typedef controlled_runge_kutta<dopri5_error_stepper_type> controlled_stepper_type;
+      typedef Dopri5Interpolant<dopri5_error_stepper_type> interpolant_type;
+      
+      controlled_stepper_type stepper = make_controlled(epsAbs, epsRel, dopri5_error_stepper_type());
+      SimulatorCounted dynamics(&sys, &evaluations);
+      
+      // The states (and derivatives) at the start and end of a step are swapped rather than 
+      // copied, the derivative at the end of a step is reused for the next (FSAL)
+      int n = initial.size();
+      State x0, dx0(n), x1(n), dx1(n);
+      x0.swap(initial);
+      double t = 0.0, dt = initialStep;
+      dynamics(x0, dx0, t);
+      
+      while (t < tMax) {
+         // Do not step past the end
+         bool last = false;
+         if (t + dt >= tMax) {
+            dt = tMax - t;
+            last = true;
+         }
+         double t0 = t, h = dt;
+         if (stepper.try_step(dynamics, x0, dx0, t, x1, dx1, dt) == fail) {
+            rejected++;
+            NE_PROFILE_COUNT(PROF_STEPS_REJECTED, 1);
+            if (dt < 16.0 * numeric_limits<double>::epsilon() * max(fabs(t), 1.0)) {
+               cerr << "Step size too small at t = " << t << " (SimulateOdeDense::simulate)" << endl;
+               break;
+            }
+            continue;
+         }
+         steps++;
+         NE_PROFILE_COUNT(PROF_STEPS_ACCEPTED, 1);
+         if (!last || steps == 1) {
+            minStep = (steps == 1 || h < minStep) ? h : minStep;
+         }
+         if (h > maxStep) { maxStep = h; }
+         if (last) { t = tMax; }
+         
+         // Hand the step to the observer
+         {
+            NE_PROFILE_SCOPE(PROF_OBSERVE);
+            obs.step(interpolant_type(stepper.stepper(), x0, dx0, t0, x1, dx1, t));
+         }
+         x0.swap(x1);
+         dx0.swap(dx1);
+         if (obs.stop()) { break; }
+      }
+      initial.swap(x0);
+   }
+   
+   void SimulateOdeDense::simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger) {
+      mSteps = 0;
+      mRejected = 0;
+      mEvaluations = 0;
+      mMinStep = 0.0;
+      mMaxStep = 0.0;
+      
+      // Check to ensure that initial conditions are correct size
+      int states = (countNodes(sys)*sys.nodeStates()) + (countArcs(sys)*sys.arcStates());
+      if (initial.size() < states || initial.size() > states) {
+         cerr << "Incorrect number of states for initial conditions (SimulateOdeDense::simulate)" << endl;
+         return;
+      }
+      
+      // Check that the state IDs are correct, if not refresh
+      if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
+      
+      // Observe the initial state
+      {
+         NE_PROFILE_SCOPE(PROF_OBSERVE);
+         obs(initial, 0.0);
+      }
+      if (obs.stop()) { return; }
+      
+      // Large Systems share the vector operations between threads as well as the dynamics
+      int threads = parallelThreads(sys);
+#ifdef _OPENMP
+      if (threads > 0) {
+         int prevThreads = omp_get_max_threads();
+         omp_set_num_threads(threads);
+         integrateDense<openmp_range_algebra>(sys, tMax, initial, mEpsAbs, mEpsRel, mInitialStep, obs, 
+                                              mSteps, mRejected, mEvaluations, mMinStep, mMaxStep);
+         omp_set_num_threads(prevThreads);
+      }
+#endif
+      if (threads == 0) {
+         integrateDense<range_algebra>(sys, tMax, initial, mEpsAbs, mEpsRel, mInitialStep, obs, 
+                                       mSteps, mRejected, mEvaluations, mMinStep, mMaxStep);
+      }
+      
+      // Only the final state is logged
+      NE_PROFILE_SCOPE(PROF_LOG);
+      logger.newState(sys, initial);
+      logger.endStep(SIM_STEP);
+      logger.commit();
+   }
+   
+   void SimObserverResample::operator() (const State &x, double t) {
+      // Observations made directly (e.g. the initial state) are passed straight on
+      mObs(x, t);
+      mNext = (long)floor(t / mOutputStep + 1e-9) + 1;
+   }
+   
+   void SimObserverResample::step (const StepInterpolant &step) {
+      double tEnd = step.tEnd();
+      while (mOutputStep > 0.0) {
+         double t = mNext * mOutputStep;
+         if (t > tEnd + 1e-9 * mOutputStep) { break; }
+         if (t > tEnd) { t = tEnd; }
+         step.state(t, mX);
+         mObs(mX, t);
+         mNext++;
+         if (mObs.stop()) { break; }
       }
    }
 
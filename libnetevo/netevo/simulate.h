@@ -41,10 +41,37 @@ namespace netevo {
       RK_DOPRI_5_DENSE = 2  /** Runge Kutta Dormand & Prince (5) Dense Output */
    };
    
+   /** Accepted step of a simulation with dense output (see SimulateOdeDense). The state at any 
+    *  time within the step is interpolated from the stages of the step, so no further evaluations 
+    *  of the dynamics are needed. Only valid during the call to SimObserver::step. */
+   class StepInterpolant {
+   public:
+      virtual ~StepInterpolant () { };
+      /** Time at the start of the step */
+      virtual double tStart () const = 0;
+      /** Time at the end of the step */
+      virtual double tEnd () const = 0;
+      /** State at the start of the step */
+      virtual const State & startState () const = 0;
+      /** State at the end of the step */
+      virtual const State & endState () const = 0;
+      /** Interpolate the state at time t (tStart <= t <= tEnd) into x (resized if necessary) */
+      virtual void state (double t, State &x) const = 0;
+   };
+   
    class SimObserver {
    public:
       /** This should be overwritten by any observer. By default does nothing. */
       virtual void operator() (const State &x, double t) { };
+      /** Observation in which only the nodes with IDs in changed differ from the last state 
+       *  observed (see SimulateMapSparse). By default the whole state is observed. */
+      virtual void stateDelta (const State &x, const vector<int> &changed, double t) { (*this)(x, t); };
+      /** Observation of a whole step (see SimulateOdeDense). By default the state at the end of 
+       *  the step is observed. */
+      virtual void step (const StepInterpolant &step) { (*this)(step.endState(), step.tEnd()); };
+      /** Whether the simulation should end early. Checked by the simulators after each 
+       *  observation, the state passed to simulate is then left undefined. By default never. */
+      virtual bool stop () { return false; };
    };
    
    class SimObserverToVectors : public SimObserver {
@@ -79,7 +106,175 @@ namespace netevo {
       }
    };
 
-   /** Virtual class to define the interface for simulation of a System. */
+   /** Observer that stores the trajectory in a single preallocated buffer. States are stored 
+    *  contiguously with a fixed stride (the size of the first state observed) and nothing is 
+    *  allocated while observing. Observations beyond the capacity are counted but not stored. */
+   class SimObserverToBuffer : public SimObserver {
+   private:
+      vector<double> mData;
+      vector<double> mTimes;
+      int            mCapacity;
+      int            mStride;
+      int            mSize;
+      int            mDropped;
+   public:
+      /** Buffer for capacity observations of the given number of states (if 0 the storage is 
+       *  allocated when the first state is seen). */
+      SimObserverToBuffer (int capacity, int states = 0);
+      void operator() (const State &x, double t);
+      
+      /** Forget all observations (keeping the storage). */
+      void clear () { mSize = 0; mDropped = 0; }
+      /** Number of stored observations. */
+      int size () { return mSize; }
+      /** Number of states in each observation. */
+      int stride () { return mStride; }
+      /** Whether the buffer is full. */
+      bool full () { return mSize == mCapacity; }
+      /** Number of observations that did not fit in the buffer. */
+      int dropped () { return mDropped; }
+      /** Pointer to the states of observation i. */
+      const double * state (int i) { return &mData[i * mStride]; }
+      /** Time of observation i. */
+      double time (int i) { return mTimes[i]; }
+   };
+   
+   /** Observer that keeps only the last capacity observations in a ring buffer. Storage is the 
+    *  same as SimObserverToBuffer, but once full the oldest observation is overwritten. */
+   class SimObserverRing : public SimObserver {
+   private:
+      vector<double> mData;
+      vector<double> mTimes;
+      int            mCapacity;
+      int            mStride;
+      int            mHead;
+      int            mSize;
+   public:
+      SimObserverRing (int capacity, int states = 0);
+      void operator() (const State &x, double t);
+      
+      /** Forget all observations (keeping the storage). */
+      void clear () { mHead = 0; mSize = 0; }
+      /** Number of stored observations. */
+      int size () { return mSize; }
+      /** Number of states in each observation. */
+      int stride () { return mStride; }
+      /** Pointer to the states of observation i (0 is the oldest stored, size()-1 the latest). */
+      const double * state (int i) { return &mData[((mHead + mCapacity - mSize + i) % mCapacity) * mStride]; }
+      /** Time of observation i (ordered as for state). */
+      double time (int i) { return mTimes[(mHead + mCapacity - mSize + i) % mCapacity]; }
+   };
+   
+   /** Observer that passes every n'th observation (starting with the first) on to another. */
+   class SimObserverDecimate : public SimObserver {
+   private:
+      SimObserver &mObs;
+      int          mEvery;
+      int          mCount;
+   public:
+      SimObserverDecimate (SimObserver &obs, int every) : mObs(obs), mEvery(every), mCount(0) { }
+      SimObserverDecimate (const SimObserverDecimate &obs) : mObs(obs.mObs), mEvery(obs.mEvery), mCount(obs.mCount) { }
+      void operator() (const State &x, double t) {
+         if (mCount == 0) { mObs(x, t); }
+         if (++mCount >= mEvery) { mCount = 0; }
+      }
+   };
+   
+   /** Observer that keeps the running mean and variance of each state over all observations 
+    *  (using Welford's method so that it is stable for long simulations). */
+   class SimObserverMeanVar : public SimObserver {
+   private:
+      State mMean;
+      State mM2;
+      int   mCount;
+   public:
+      SimObserverMeanVar () : mCount(0) { }
+      void operator() (const State &x, double t);
+      
+      /** Forget all observations (keeping the storage). */
+      void clear () { mCount = 0; }
+      /** Number of observations. */
+      int count () { return mCount; }
+      /** Mean of state i. */
+      double mean (int i) { return mMean[i]; }
+      /** (Sample) variance of state i. */
+      double variance (int i) { return (mCount > 1) ? mM2[i] / (mCount - 1) : 0.0; }
+   };
+   
+   /** An observer that reduces a simulation to a single value as it runs (see 
+    *  StreamingPerformance). */
+   class SimReducer : public SimObserver {
+   public:
+      /** The value for the observations so far. */
+      virtual double result () = 0;
+   };
+   
+   /** Kuramoto order parameter r(t) = |1/N sum_j exp(i theta_j)|, where theta_j is the given 
+    *  state of each node, averaged over all observations from time tStart. Equals 1 when the 
+    *  phases are synchronised. */
+   class SimObserverOrderParameter : public SimReducer {
+   private:
+      int    mNodes;
+      int    mNodeStates;
+      int    mState;
+      double mTStart;
+      double mSum;
+      double mLast;
+      int    mCount;
+      double mTFirst;
+      double mTLast;
+   public:
+      SimObserverOrderParameter (System &sys, int state = 0, double tStart = 0.0);
+      void operator() (const State &x, double t);
+      
+      /** Mean order parameter over the observations (0 if none). */
+      double result () { return (mCount > 0) ? mSum / mCount : 0.0; }
+      /** Order parameter of the latest observation. */
+      double last () { return mLast; }
+      /** Number of observations averaged. */
+      int count () { return mCount; }
+      /** Sum of the order parameter over the observations. */
+      double sum () { return mSum; }
+      /** Time of the first observation averaged. */
+      double firstTime () { return mTFirst; }
+      /** Time of the latest observation averaged. */
+      double lastTime () { return mTLast; }
+   };
+   
+   /** Synchronisation error e(t) = sqrt(1/N sum_j |x_j - xbar|^2), where x_j are the states of node 
+    *  j and xbar their mean over the nodes, averaged over all observations from time tStart. 
+    *  Equals 0 when the node states are synchronised. */
+   class SimObserverSyncError : public SimReducer {
+   private:
+      State  mMean;
+      int    mNodes;
+      int    mNodeStates;
+      double mTStart;
+      double mSum;
+      double mLast;
+      int    mCount;
+      double mTFirst;
+      double mTLast;
+   public:
+      SimObserverSyncError (System &sys, double tStart = 0.0);
+      void operator() (const State &x, double t);
+      
+      /** Mean synchronisation error over the observations (0 if none). */
+      double result () { return (mCount > 0) ? mSum / mCount : 0.0; }
+      /** Synchronisation error of the latest observation. */
+      double last () { return mLast; }
+      /** Number of observations averaged. */
+      int count () { return mCount; }
+      /** Sum of the synchronisation error over the observations. */
+      double sum () { return mSum; }
+      /** Time of the first observation averaged. */
+      double firstTime () { return mTFirst; }
+      /** Time of the latest observation averaged. */
+      double lastTime () { return mTLast; }
+   };
+
+   /** Virtual class to define the interface for simulation of a System. Simulations end at tMax 
+    *  or as soon as the observer asks to stop (see SimObserver::stop). */
    class Simulate {
       public:
       virtual void simulate (System &sys, double tMax, State &inital, SimObserver &obs, ChangeLog &logger) { };
@@ -91,6 +286,28 @@ namespace netevo {
       void simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger);
    };
 
+   /** Discrete time simulation (as SimulateMap) that only updates the nodes that can change.
+    *  A node can only take a new state if its own state or that of one of its in-neighbours 
+    *  changed in the previous step, so after every node has been updated once only the nodes 
+    *  that changed and their out-neighbours are updated. All updates still use the state at the 
+    *  previous step, which is then changed in place, and the loggers and observers are sent the 
+    *  IDs of the nodes that changed with each new state (see ChangeLog::stateDelta and 
+    *  SimObserver::stateDelta). The cost of each step is therefore proportional to the number of 
+    *  active nodes and their degrees rather than the size of the System.
+    *  
+    *  The node dynamics must be deterministic maps that do not depend on the time. Systems with 
+    *  arc states are simulated by SimulateMap. */
+   class SimulateMapSparse : public Simulate {
+   public:
+      SimulateMapSparse () { mUpdates = 0; };
+      void simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger);
+      
+      /** Node updates made during the last simulation */
+      long updates () { return mUpdates; }
+   private:
+      long mUpdates;
+   };
+
    class SimulateOdeFixed : public Simulate {
    public:
       SimulateOdeFixed (fixed_step_type_e stepper, double stepSize) { 
@@ -135,6 +352,67 @@ namespace netevo {
       double mInitialStep;
    };
    
+   /** Adaptive simulation using Runge Kutta Dormand & Prince (5) that passes each accepted step 
+    *  to the observer as a StepInterpolant (see SimObserver::step). Observers can sample the 
+    *  state at any times within a step without further evaluations of the dynamics (e.g. to find 
+    *  when a phase crosses a threshold) and no state is copied or logged while simulating, the 
+    *  ChangeLog only receives the final state. The initial state is observed as normal and 
+    *  observers that do not override step see the state at the end of each step (as 
+    *  SimulateOdeAdaptive). Use SimObserverResample to observe at fixed times instead. */
+   class SimulateOdeDense : public Simulate {
+   public:
+      SimulateOdeDense (double epsAbs, double epsRel, double initialStep) { 
+         mEpsAbs = epsAbs;
+         mEpsRel = epsRel;
+         mInitialStep = initialStep;
+         mSteps = 0;
+         mRejected = 0;
+         mEvaluations = 0;
+         mMinStep = 0.0;
+         mMaxStep = 0.0;
+      };
+      void simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger);
+      
+      /** Steps accepted during the last simulation */
+      int steps () { return mSteps; }
+      /** Steps rejected during the last simulation */
+      int rejected () { return mRejected; }
+      /** Evaluations of the dynamics during the last simulation */
+      int evaluations () { return mEvaluations; }
+      /** Smallest step accepted during the last simulation (excluding a final step shortened to 
+       *  end at tMax) */
+      double minStep () { return mMinStep; }
+      /** Largest step accepted during the last simulation */
+      double maxStep () { return mMaxStep; }
+      
+   private:
+      double mEpsAbs;
+      double mEpsRel;
+      double mInitialStep;
+      int    mSteps;
+      int    mRejected;
+      int    mEvaluations;
+      double mMinStep;
+      double mMaxStep;
+   };
+   
+   /** Passes the state every outputStep on to another observer, interpolating within each step 
+    *  of a SimulateOdeDense simulation (so it is observed as SimulateOdeConst would). A single 
+    *  state is reused for every observation. */
+   class SimObserverResample : public SimObserver {
+   private:
+      SimObserver &mObs;
+      double       mOutputStep;
+      long         mNext;
+      State        mX;
+   public:
+      SimObserverResample (SimObserver &obs, double outputStep) 
+         : mObs(obs), mOutputStep(outputStep), mNext(0) { }
+      void operator() (const State &x, double t);
+      void step (const StepInterpolant &step);
+      bool stop () { return mObs.stop(); }
+   };
+   
    class SimInitialState {
    public:
       /** A vector of initial states to be used during the evolutionary process. Called for each simulation step. */
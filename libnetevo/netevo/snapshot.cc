@@ -0,0 +1,326 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "system.h"
+#include "snapshot.h"
+#include "mapped_file.h"
+#include <cstring>
+
+namespace netevo {
+   
+   const char     SNAP_MAGIC[8]   = { 'N', 'E', 'T', 'E', 'V', 'O', 'S', 'Y' };
+   const uint32_t SNAP_BYTE_ORDER = 0x01020304;
+   const uint32_t SNAP_VERSION    = 1;
+   
+   /** Append a section to a snapshot being built (padding it to a multiple of 8 bytes). */
+   static void snapSection (vector<char> &buffer, int section, const void *data, size_t bytes) {
+      size_t start = buffer.size();
+      ((snapshot_header_t *)&buffer[0])->offset[section] = start;
+      buffer.resize(start + ((bytes + 7) / 8) * 8, 0);
+      if (bytes > 0) { memcpy(&buffer[start], data, bytes); }
+   }
+   
+   template <typename T>
+   static void snapSection (vector<char> &buffer, int section, const vector<T> &data) {
+      snapSection(buffer, section, data.empty() ? NULL : &data[0], data.size() * sizeof(T));
+   }
+   
+   void System::saveBinary (vector<char> &buffer) {
+      int i, nodes, arcs;
+      if (!mValidNodeIDs || !mValidArcIDs) { refreshStateIDs(); }
+      nodes = nodeCount();
+      arcs = arcCount();
+      
+      // Strings are only stored once
+      std::map<string,int> strings;
+      vector<string> table;
+      auto intern = [&] (const string &s) -> int {
+         std::map<string,int>::iterator it = strings.find(s);
+         if (it != strings.end()) { return it->second; }
+         table.push_back(s);
+         return strings[s] = (int)table.size() - 1;
+      };
+      
+      // Gather the node fields by ID
+      vector<int32_t> nKey(nodes), nName(nodes), nDyn(nodes);
+      vector<double> nPos(3 * nodes), nProp, nParam;
+      vector<uint64_t> nPropOff(nodes + 1, 0), nParamOff(nodes + 1, 0);
+      vector<uint32_t> outOff(nodes + 1, 0), outTarget, outArc;
+      outTarget.reserve(arcs);
+      outArc.reserve(arcs);
+      for (i=0; i<nodes; ++i) {
+         Node v = mIDNodes[i];
+         NodeData &d = mNodeData[v];
+         nKey[i] = d.key;
+         nName[i] = intern(d.name);
+         nDyn[i] = intern(d.dynamic->getName());
+         nPos[3 * i] = d.position.x;
+         nPos[3 * i + 1] = d.position.y;
+         nPos[3 * i + 2] = d.position.z;
+         nProp.insert(nProp.end(), d.properties.begin(), d.properties.end());
+         nPropOff[i + 1] = nProp.size();
+         nParam.insert(nParam.end(), d.dynamicParams.begin(), d.dynamicParams.end());
+         nParamOff[i + 1] = nParam.size();
+         for (OutArcIt e(*this, v); e != INVALID; ++e) {
+            outTarget.push_back(mNodeIDs[target(e)]);
+            outArc.push_back(mArcIDs[e]);
+         }
+         outOff[i + 1] = outTarget.size();
+      }
+      
+      // Gather the arc fields by ID
+      vector<int32_t> aName(arcs), aDyn(arcs);
+      vector<double> aWeight(arcs), aProp, aParam;
+      vector<uint64_t> aPropOff(arcs + 1, 0), aParamOff(arcs + 1, 0);
+      for (i=0; i<arcs; ++i) {
+         ArcData &d = mArcData[mIDArcs[i]];
+         aWeight[i] = d.weight;
+         aName[i] = intern(d.name);
+         aDyn[i] = intern(d.dynamic->getName());
+         aProp.insert(aProp.end(), d.properties.begin(), d.properties.end());
+         aPropOff[i + 1] = aProp.size();
+         aParam.insert(aParam.end(), d.dynamicParams.begin(), d.dynamicParams.end());
+         aParamOff[i + 1] = aParam.size();
+      }
+      
+      // Pack the string table
+      vector<uint64_t> strOff(table.size() + 1, 0);
+      string chars;
+      for (i=0; i<(int)table.size(); ++i) {
+         chars += table[i];
+         strOff[i + 1] = chars.size();
+      }
+      
+      // Write the header and then each section in turn
+      buffer.assign(sizeof(snapshot_header_t), 0);
+      snapshot_header_t *h = (snapshot_header_t *)&buffer[0];
+      memcpy(h->magic, SNAP_MAGIC, 8);
+      h->byteOrder = SNAP_BYTE_ORDER;
+      h->version = SNAP_VERSION;
+      h->nodes = nodes;
+      h->arcs = arcs;
+      h->nodeStates = mNodeStates;
+      h->arcStates = mArcStates;
+      h->nextKey = mNextKey;
+      h->strings = table.size();
+      snapSection(buffer, SNAP_NODE_KEY, nKey);
+      snapSection(buffer, SNAP_NODE_POSITION, nPos);
+      snapSection(buffer, SNAP_NODE_NAME, nName);
+      snapSection(buffer, SNAP_NODE_DYNAMIC, nDyn);
+      snapSection(buffer, SNAP_NODE_PROP_OFFSET, nPropOff);
+      snapSection(buffer, SNAP_NODE_PROP, nProp);
+      snapSection(buffer, SNAP_NODE_PARAM_OFFSET, nParamOff);
+      snapSection(buffer, SNAP_NODE_PARAM, nParam);
+      snapSection(buffer, SNAP_OUT_OFFSET, outOff);
+      snapSection(buffer, SNAP_OUT_TARGET, outTarget);
+      snapSection(buffer, SNAP_OUT_ARC, outArc);
+      snapSection(buffer, SNAP_ARC_WEIGHT, aWeight);
+      snapSection(buffer, SNAP_ARC_NAME, aName);
+      snapSection(buffer, SNAP_ARC_DYNAMIC, aDyn);
+      snapSection(buffer, SNAP_ARC_PROP_OFFSET, aPropOff);
+      snapSection(buffer, SNAP_ARC_PROP, aProp);
+      snapSection(buffer, SNAP_ARC_PARAM_OFFSET, aParamOff);
+      snapSection(buffer, SNAP_ARC_PARAM, aParam);
+      snapSection(buffer, SNAP_STRING_OFFSET, strOff);
+      snapSection(buffer, SNAP_STRING, chars.data(), chars.size());
+      ((snapshot_header_t *)&buffer[0])->bytes = buffer.size();
+   }
+   
+   int System::saveBinary (string filename) {
+      vector<char> buffer;
+      saveBinary(buffer);
+      std::ofstream fileOut(filename.c_str(), ios::out | ios::binary | ios::trunc);
+      if (!fileOut.is_open()) {
+         return 1;
+      }
+      fileOut.write(&buffer[0], buffer.size());
+      fileOut.close();
+      return fileOut.good() ? 0 : 1;
+   }
+   
+   int System::openBinary (string filename) {
+      MappedFile file;
+      if (file.open(filename) != 0) { return 1; }
+      return openBinary(file.data(), file.size());
+   }
+   
+   int System::openBinary (const char *data, size_t bytes) {
+      int i, k;
+      
+      // Check the header and that every section lies within the data
+      if (data == NULL || bytes < sizeof(snapshot_header_t)) {
+         cerr << "Snapshot is too small (System::openBinary)" << endl;
+         return 2;
+      }
+      snapshot_header_t h;
+      memcpy(&h, data, sizeof(snapshot_header_t));
+      if (memcmp(h.magic, SNAP_MAGIC, 8) != 0 || h.version != SNAP_VERSION || h.byteOrder != SNAP_BYTE_ORDER) {
+         cerr << "Not a snapshot of this version and byte order (System::openBinary)" << endl;
+         return 2;
+      }
+      if (h.bytes > bytes) {
+         cerr << "Snapshot is truncated (System::openBinary)" << endl;
+         return 2;
+      }
+      for (i=0; i<SNAP_SECTIONS; ++i) {
+         if (h.offset[i] < sizeof(snapshot_header_t) || h.offset[i] > h.bytes || h.offset[i] % 8 != 0) {
+            cerr << "Snapshot section is invalid (System::openBinary)" << endl;
+            return 2;
+         }
+      }
+      
+      #define NE_SNAP(section, type) ((const type *)(data + h.offset[section]))
+      const int32_t  *nKey      = NE_SNAP(SNAP_NODE_KEY, int32_t);
+      const double   *nPos      = NE_SNAP(SNAP_NODE_POSITION, double);
+      const int32_t  *nName     = NE_SNAP(SNAP_NODE_NAME, int32_t);
+      const int32_t  *nDyn      = NE_SNAP(SNAP_NODE_DYNAMIC, int32_t);
+      const uint64_t *nPropOff  = NE_SNAP(SNAP_NODE_PROP_OFFSET, uint64_t);
+      const double   *nProp     = NE_SNAP(SNAP_NODE_PROP, double);
+      const uint64_t *nParamOff = NE_SNAP(SNAP_NODE_PARAM_OFFSET, uint64_t);
+      const double   *nParam    = NE_SNAP(SNAP_NODE_PARAM, double);
+      const uint32_t *outOff    = NE_SNAP(SNAP_OUT_OFFSET, uint32_t);
+      const uint32_t *outTarget = NE_SNAP(SNAP_OUT_TARGET, uint32_t);
+      const uint32_t *outArc    = NE_SNAP(SNAP_OUT_ARC, uint32_t);
+      const double   *aWeight   = NE_SNAP(SNAP_ARC_WEIGHT, double);
+      const int32_t  *aName     = NE_SNAP(SNAP_ARC_NAME, int32_t);
+      const int32_t  *aDyn      = NE_SNAP(SNAP_ARC_DYNAMIC, int32_t);
+      const uint64_t *aPropOff  = NE_SNAP(SNAP_ARC_PROP_OFFSET, uint64_t);
+      const double   *aProp     = NE_SNAP(SNAP_ARC_PROP, double);
+      const uint64_t *aParamOff = NE_SNAP(SNAP_ARC_PARAM_OFFSET, uint64_t);
+      const double   *aParam    = NE_SNAP(SNAP_ARC_PARAM, double);
+      const uint64_t *strOff    = NE_SNAP(SNAP_STRING_OFFSET, uint64_t);
+      const char     *chars     = NE_SNAP(SNAP_STRING, char);
+      #undef NE_SNAP
+      
+      // Check the sizes and indexes so that a corrupt snapshot cannot be read out of bounds. Counts 
+      // are compared with the space left in a section (never multiplied) so they cannot wrap.
+      uint64_t n = h.nodes, m = h.arcs, ns = h.strings;
+      auto fits = [&] (int section, uint64_t count, uint64_t size) -> bool { 
+         return count <= (h.bytes - h.offset[section]) / size; 
+      };
+      bool valid = n < INT32_MAX && m < INT32_MAX && ns < INT32_MAX;
+      valid = valid && fits(SNAP_NODE_KEY, n, 4) && fits(SNAP_NODE_POSITION, n, 24) && fits(SNAP_NODE_NAME, n, 4) && 
+              fits(SNAP_NODE_DYNAMIC, n, 4) && fits(SNAP_NODE_PROP_OFFSET, n + 1, 8) && 
+              fits(SNAP_NODE_PARAM_OFFSET, n + 1, 8) && fits(SNAP_OUT_OFFSET, n + 1, 4) && 
+              fits(SNAP_OUT_TARGET, m, 4) && fits(SNAP_OUT_ARC, m, 4) && fits(SNAP_ARC_WEIGHT, m, 8) && 
+              fits(SNAP_ARC_NAME, m, 4) && fits(SNAP_ARC_DYNAMIC, m, 4) && 
+              fits(SNAP_ARC_PROP_OFFSET, m + 1, 8) && fits(SNAP_ARC_PARAM_OFFSET, m + 1, 8) && 
+              fits(SNAP_STRING_OFFSET, ns + 1, 8);
+      valid = valid && fits(SNAP_NODE_PROP, nPropOff[n], 8) && fits(SNAP_NODE_PARAM, nParamOff[n], 8) && 
+              fits(SNAP_ARC_PROP, aPropOff[m], 8) && fits(SNAP_ARC_PARAM, aParamOff[m], 8) && 
+              fits(SNAP_STRING, strOff[ns], 1) && outOff[0] == 0 && outOff[n] == m;
+      for (i=0; valid && i<(int)h.nodes; ++i) {
+         valid = (nName[i] >= 0 && nName[i] < (int)h.strings && nDyn[i] >= 0 && nDyn[i] < (int)h.strings && 
+                  nPropOff[i] <= nPropOff[i + 1] && nParamOff[i] <= nParamOff[i + 1] && outOff[i] <= outOff[i + 1]);
+      }
+      for (i=0; valid && i<(int)h.arcs; ++i) {
+         valid = (aName[i] >= 0 && aName[i] < (int)h.strings && aDyn[i] >= 0 && aDyn[i] < (int)h.strings && 
+                  aPropOff[i] <= aPropOff[i + 1] && aParamOff[i] <= aParamOff[i + 1] && 
+                  outTarget[i] < h.nodes && outArc[i] < h.arcs);
+      }
+      for (i=0; valid && i<(int)h.strings; ++i) {
+         valid = (strOff[i] <= strOff[i + 1]);
+      }
+      // Every arc ID must appear exactly once (m IDs below m with no repeats cover them all)
+      vector<bool> seenArc(valid ? m : 0, false);
+      for (i=0; valid && i<(int)h.arcs; ++i) {
+         valid = !seenArc[outArc[i]];
+         seenArc[outArc[i]] = true;
+      }
+      if (!valid) {
+         cerr << "Snapshot is corrupt (System::openBinary)" << endl;
+         return 2;
+      }
+      
+      // Look up the dynamics once for each string (unknown names use no dynamics)
+      vector<string> strings(ns);
+      vector<NodeDynamic*> nodeDyns(ns, NULL);
+      vector<ArcDynamic*> arcDyns(ns, NULL);
+      for (i=0; i<(int)ns; ++i) {
+         strings[i].assign(chars + strOff[i], strOff[i + 1] - strOff[i]);
+      }
+      for (i=0; i<(int)n; ++i) {
+         if (nodeDyns[nDyn[i]] == NULL) {
+            std::map<string, NodeDynamic*>::iterator it = mDynamics->nodes.find(strings[nDyn[i]]);
+            if (it == mDynamics->nodes.end()) {
+               cerr << "Unknown node dynamic " << strings[nDyn[i]] << " (System::openBinary)" << endl;
+               nodeDyns[nDyn[i]] = noNodeDyn;
+            }
+            else { nodeDyns[nDyn[i]] = it->second; }
+         }
+      }
+      for (i=0; i<(int)m; ++i) {
+         if (arcDyns[aDyn[i]] == NULL) {
+            std::map<string, ArcDynamic*>::iterator it = mDynamics->arcs.find(strings[aDyn[i]]);
+            if (it == mDynamics->arcs.end()) {
+               cerr << "Unknown arc dynamic " << strings[aDyn[i]] << " (System::openBinary)" << endl;
+               arcDyns[aDyn[i]] = noArcDyn;
+            }
+            else { arcDyns[aDyn[i]] = it->second; }
+         }
+      }
+      
+      // Rebuild the System with the same IDs (this is a bulk change so listeners are not notified)
+      clear();
+      reserveNode(h.nodes);
+      reserveArc(h.arcs);
+      mIDNodes.reserve(h.nodes);
+      mIDArcs.reserve(h.arcs);
+      for (i=0; i<(int)h.nodes; ++i) {
+         Node v = Parent::addNode();
+         mNodeIDs[v] = i;
+         mIDNodes.push_back(v);
+         NodeData &d = mNodeData[v];
+         d.key = nKey[i];
+         d.name = strings[nName[i]];
+         d.position.x = nPos[3 * i];
+         d.position.y = nPos[3 * i + 1];
+         d.position.z = nPos[3 * i + 2];
+         d.dynamic = nodeDyns[nDyn[i]];
+         d.properties.assign(nProp + nPropOff[i], nProp + nPropOff[i + 1]);
+         d.dynamicParams.assign(nParam + nParamOff[i], nParam + nParamOff[i + 1]);
+      }
+      
+      // Arcs are added in ID order so that they keep their IDs
+      vector<uint32_t> arcSource(h.arcs), arcTarget(h.arcs);
+      for (i=0; i<(int)h.nodes; ++i) {
+         for (k=outOff[i]; k<(int)outOff[i + 1]; ++k) {
+            arcSource[outArc[k]] = i;
+            arcTarget[outArc[k]] = outTarget[k];
+         }
+      }
+      for (i=0; i<(int)h.arcs; ++i) {
+         Arc e = Parent::addArc(mIDNodes[arcSource[i]], mIDNodes[arcTarget[i]]);
+         mArcIDs[e] = i;
+         mIDArcs.push_back(e);
+         ArcData &d = mArcData[e];
+         d.name = strings[aName[i]];
+         d.weight = aWeight[i];
+         d.dynamic = arcDyns[aDyn[i]];
+         d.properties.assign(aProp + aPropOff[i], aProp + aPropOff[i + 1]);
+         d.dynamicParams.assign(aParam + aParamOff[i], aParam + aParamOff[i + 1]);
+      }
+      
+      mNextKey = h.nextKey;
+      return 0;
+   }
+   
+} // netevo namespace
@@ -0,0 +1,75 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_SNAPSHOT_H
+#define NE_SNAPSHOT_H
+
+#include <stdint.h>
+
+namespace netevo {
+   
+   /** Sections of a binary System snapshot (see System::saveBinary). Nodes and arcs are stored in 
+    *  ID order, variable length lists as offsets (n + 1 values) into a packed array, and names 
+    *  and dynamics as indexes into the string table. */
+   enum snapshot_section_e {
+      SNAP_NODE_KEY = 0,         /** int32 key of each node */
+      SNAP_NODE_POSITION,        /** double x, y, z of each node */
+      SNAP_NODE_NAME,            /** int32 string of each node name */
+      SNAP_NODE_DYNAMIC,         /** int32 string of each node dynamic */
+      SNAP_NODE_PROP_OFFSET,     /** uint64 offsets into SNAP_NODE_PROP */
+      SNAP_NODE_PROP,            /** double node properties */
+      SNAP_NODE_PARAM_OFFSET,    /** uint64 offsets into SNAP_NODE_PARAM */
+      SNAP_NODE_PARAM,           /** double node dynamic parameters */
+      SNAP_OUT_OFFSET,           /** uint32 offsets (CSR) of the arcs out of each node */
+      SNAP_OUT_TARGET,           /** uint32 target node ID of each out arc */
+      SNAP_OUT_ARC,              /** uint32 arc ID of each out arc */
+      SNAP_ARC_WEIGHT,           /** double weight of each arc */
+      SNAP_ARC_NAME,             /** int32 string of each arc name */
+      SNAP_ARC_DYNAMIC,          /** int32 string of each arc dynamic */
+      SNAP_ARC_PROP_OFFSET,      /** uint64 offsets into SNAP_ARC_PROP */
+      SNAP_ARC_PROP,             /** double arc properties */
+      SNAP_ARC_PARAM_OFFSET,     /** uint64 offsets into SNAP_ARC_PARAM */
+      SNAP_ARC_PARAM,            /** double arc dynamic parameters */
+      SNAP_STRING_OFFSET,        /** uint64 offsets into SNAP_STRING */
+      SNAP_STRING,               /** characters of the strings (not terminated) */
+      SNAP_SECTIONS
+   };
+   
+   /** Header at the start of a binary System snapshot. Every section starts at an 8 byte aligned 
+    *  offset from the start of the snapshot, so a mapped snapshot can be read in place. Values 
+    *  are in the byte order of the machine that wrote them (recorded by byteOrder). */
+   typedef struct {
+      char     magic[8];
+      uint32_t byteOrder;
+      uint32_t version;
+      uint32_t nodes;
+      uint32_t arcs;
+      uint32_t nodeStates;
+      uint32_t arcStates;
+      int32_t  nextKey;
+      uint32_t strings;
+      uint64_t bytes;
+      uint64_t offset[SNAP_SECTIONS];
+   } snapshot_header_t;
+   
+} // netevo namespace
+
+#endif // NE_SNAPSHOT_H
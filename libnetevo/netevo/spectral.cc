@@ -0,0 +1,186 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#include "spectral.h"
+#include <cmath>
+
+namespace netevo {
+   
+   bool LanczosSolver::orthogonalise (const MatrixXd &V, int cols, VectorXd &v) {
+      // Orthogonalise against the first cols columns of V (twice for accuracy) and normalise
+      double norm0 = v.norm();
+      for (int pass=0; pass<2; ++pass) {
+         if (cols > 0) { v.noalias() -= V.leftCols(cols) * (V.leftCols(cols).transpose() * v); }
+      }
+      double norm = v.norm();
+      if (norm <= 1e-10 * norm0 || norm == 0.0) { return false; }
+      v /= norm;
+      return true;
+   }
+   
+   void LanczosSolver::ritz (const MatrixXd &V, const MatrixXd &W, const MatrixXd &H, int p, int k, bool largest) {
+      // Ritz pairs of the current basis, ordered from the wanted end inwards
+      SelfAdjointEigenSolver<MatrixXd> es(H.topLeftCorner(p, p));
+      mTheta.resize(p);
+      mS.resize(p, p);
+      for (int i=0; i<p; ++i) {
+         int idx = largest ? p-1-i : i;
+         mTheta(i) = es.eigenvalues()(idx);
+         mS.col(i) = es.eigenvectors().col(idx);
+      }
+      
+      // Residuals of the wanted Ritz pairs, A y - theta y = W s - theta V s
+      mR.resize(V.rows(), k);
+      for (int i=0; i<k; ++i) {
+         mR.col(i).noalias() = W.leftCols(p) * mS.col(i);
+         mR.col(i).noalias() -= mTheta(i) * (V.leftCols(p) * mS.col(i));
+      }
+   }
+   
+   int LanczosSolver::compute (const SparseMatrixXd &A, int k, bool largest, const VectorXd *start) {
+      if (start == NULL) { return compute(A, k, largest, (const MatrixXd *)NULL); }
+      MatrixXd block = *start;
+      return compute(A, k, largest, &block);
+   }
+   
+   int LanczosSolver::compute (const SparseMatrixXd &A, int k, bool largest, const MatrixXd *start) {
+      int n = A.rows();
+      mRestarts = 0;
+      mIterations = 0;
+      mConverged = false;
+      
+      // Check the problem is valid
+      if (A.cols() != n || k < 1 || k > n) {
+         cerr << "Invalid matrix or number of eigenvalues (LanczosSolver::compute)" << endl;
+         return -1;
+      }
+      SparseMatrixXd At = A.transpose();
+      if ((A - At).norm() > 1e-12 * A.norm()) {
+         cerr << "Matrix is not symmetric (LanczosSolver::compute)" << endl;
+         return -1;
+      }
+      
+      // Size of the basis (must leave room for more than the wanted vectors) and number of Ritz
+      // vectors returned
+      int m = (maxBasis > 0) ? maxBasis : max(2*k + 20, 60);
+      if (m < k + 2) { m = k + 2; }
+      int nVec = min(max(k, keepVectors), min(n, m - 1));
+      
+      // Small problems are solved directly
+      if (m >= n) {
+         SelfAdjointEigenSolver<MatrixXd> es((MatrixXd(A)));
+         mValues.resize(k);
+         mVectors.resize(n, nVec);
+         for (int i=0; i<nVec; ++i) {
+            int idx = largest ? n-1-i : i;
+            if (i < k) { mValues(i) = es.eigenvalues()(idx); }
+            mVectors.col(i) = es.eigenvectors().col(idx);
+         }
+         mConverged = true;
+         return 0;
+      }
+      
+      // Basis (V), products with the basis (W = AV) and projected matrix (H = V'AV). The first p
+      // columns have their products, the first q are filled.
+      MatrixXd V(n, m), W(n, m), H = MatrixXd::Zero(m, m);
+      VectorXd v(n);
+      double anorm = 0.0;
+      int p = 0, q = 0, checked = 0;
+      bool lanczos = false;
+      lemon::Random rnd;
+      rnd.seed(seed);
+      
+      // Start from the given vectors (leaving room to extend the basis)
+      if (start != NULL && start->rows() == n) {
+         for (int i=0; i<start->cols() && q < m/2; ++i) {
+            v = start->col(i);
+            if (orthogonalise(V, q, v)) { V.col(q++) = v; }
+         }
+      }
+      
+      while (true) {
+         
+         // Products with the new basis vectors
+         for (; p<q; ++p) {
+            W.col(p).noalias() = A * V.col(p);
+            mIterations++;
+            H.block(0, p, p+1, 1).noalias() = V.leftCols(p+1).transpose() * W.col(p);
+            H.block(p, 0, 1, p+1) = H.block(0, p, p+1, 1).transpose();
+            anorm = max(anorm, W.col(p).norm());
+         }
+         
+         // Check for convergence every few steps (so that a good start finishes early)
+         if (p >= k && (p == m || p - checked >= 10 || !lanczos)) {
+            ritz(V, W, H, p, k, largest);
+            checked = p;
+            double tol = tolerance * max(anorm, 1e-300);
+            mConverged = true;
+            for (int i=0; i<k; ++i) {
+               if (mR.col(i).norm() > tol) { mConverged = false; break; }
+            }
+            
+            // Return the results
+            if (mConverged || (p == m && mRestarts >= maxRestarts)) {
+               mValues = mTheta.head(k);
+               mVectors = V.leftCols(p) * mS.leftCols(min(nVec, p));
+               return mConverged ? 0 : 1;
+            }
+            
+            // Thick restart from the Ritz vectors nearest the wanted end
+            if (p == m) {
+               int keep = max(nVec, min(m - 1, k + (m - k)/2));
+               MatrixXd Y = V * mS.leftCols(keep);
+               V.leftCols(keep) = Y;
+               Y = W * mS.leftCols(keep);
+               W.leftCols(keep) = Y;
+               H.setZero();
+               for (int i=0; i<keep; ++i) {
+                  H(i, i) = mTheta(i);
+               }
+               p = q = checked = keep;
+               lanczos = false;
+               mRestarts++;
+            }
+         }
+         
+         // Extend the basis, by the product of the last vector (the Lanczos process) or otherwise 
+         // by the residuals of the wanted Ritz pairs
+         if (q == 0) {
+            for (int i=0; i<n; ++i) { v(i) = rnd() - 0.5; }
+         }
+         else if (lanczos) {
+            v = W.col(q-1);
+         }
+         else {
+            v = mR.rowwise().sum();
+         }
+         lanczos = true;
+         if (!orthogonalise(V, q, v)) {
+            // Invariant subspace found so continue in a new direction
+            do {
+               for (int i=0; i<n; ++i) { v(i) = rnd() - 0.5; }
+            } while (!orthogonalise(V, q, v));
+         }
+         V.col(q++) = v;
+      }
+   }
+   
+} // netevo namespace
@@ -0,0 +1,108 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_SPECTRAL_H
+#define NE_SPECTRAL_H
+
+#include <iostream>
+#include <lemon/random.h>
+#include <Eigen/Sparse>
+#include <Eigen/Eigenvalues>
+
+using namespace std;
+using namespace Eigen;
+
+namespace netevo {
+   
+   /** Sparse matrix type used for the network matrices (row major so products can use OpenMP) */
+   typedef SparseMatrix<double, RowMajor> SparseMatrixXd;
+   
+   /** Partial eigensolver for large sparse symmetric matrices.
+    *  Uses the Lanczos process with full reorthogonalisation to build a basis of at most maxBasis 
+    *  vectors, from which Ritz values are extracted. If the wanted Ritz values have not converged 
+    *  the basis is thick restarted: the Ritz vectors nearest the wanted end of the spectrum are 
+    *  kept (so converged directions stay deflated) and the process is continued from their 
+    *  residuals. The residuals are calculated explicitly, so the basis can also be started from 
+    *  a block of vectors, such as Ritz vectors of a slightly different matrix (see keepVectors), 
+    *  in which case convergence is checked straight away and a few iterations are often enough.
+    *  Only matrix vector products with the matrix are needed, so the cost is 
+    *  O(nnz x basis + n x basis^2) per restart. Matrices no larger than the basis are solved 
+    *  directly. */
+   class LanczosSolver {
+   private:
+      VectorXd mValues;
+      MatrixXd mVectors;
+      int      mRestarts;
+      int      mIterations;
+      bool     mConverged;
+      /** Ritz values, Ritz vectors (in the basis) and residuals of the current basis */
+      VectorXd mTheta;
+      MatrixXd mS;
+      MatrixXd mR;
+      
+      bool orthogonalise (const MatrixXd &V, int cols, VectorXd &v);
+      void ritz (const MatrixXd &V, const MatrixXd &W, const MatrixXd &H, int p, int k, bool largest);
+      
+   public:
+      /** Maximum size of the basis (0 = automatic) */
+      int    maxBasis;
+      /** Maximum number of restarts */
+      int    maxRestarts;
+      /** Convergence tolerance for the residual of each Ritz pair (relative to the matrix norm) */
+      double tolerance;
+      /** Number of Ritz vectors to return (at least the number of eigenvalues), e.g. to start a 
+       *  later computation from */
+      int    keepVectors;
+      /** Seed for the random starting vector */
+      int    seed;
+      
+      LanczosSolver () {
+         maxBasis    = 0;
+         maxRestarts = 500;
+         tolerance   = 1e-10;
+         keepVectors = 0;
+         seed        = 1;
+      }
+      
+      /** Compute the k algebraically largest (largest = true) or smallest eigenvalues of a 
+       *  symmetric matrix, optionally starting from a given vector. Returns 0 if successful, 1 if
+       *  the eigenvalues did not converge (the best estimates are still available) or -1 if the 
+       *  matrix is not symmetric or k is invalid. */
+      int compute (const SparseMatrixXd &A, int k, bool largest, const VectorXd *start = NULL);
+      /** As above, starting from a block of vectors (the columns of start). */
+      int compute (const SparseMatrixXd &A, int k, bool largest, const MatrixXd *start);
+      
+      /** Eigenvalues from the wanted end of the spectrum inwards */
+      const VectorXd & eigenvalues () { return mValues; }
+      /** Eigenvectors (as columns, in the same order as the eigenvalues) followed by any further 
+       *  Ritz vectors requested by keepVectors */
+      const MatrixXd & eigenvectors () { return mVectors; }
+      /** Number of restarts used by the last computation */
+      int  restarts () { return mRestarts; }
+      /** Number of matrix vector products used by the last computation */
+      int  iterations () { return mIterations; }
+      /** Whether the last computation converged */
+      bool converged () { return mConverged; }
+   };
+   
+} // netevo namespace
+
+#endif // NE_SPECTRAL_H
@@ -0,0 +1,292 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "stiff.h"
+#include "profile.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace netevo {
+   
+   // ---------- SparseJacobian ----------
+   
+   void SparseJacobian::compile (System &sys) {
+      int i, a, b;
+      if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
+      int ns = sys.nodeStates(), as = sys.arcStates();
+      mStates = sys.totalStates();
+      
+      // Pattern from the structure of the graph (and the diagonal)
+      vector<Triplet<double> > pattern;
+      for (i=0; i<mStates; ++i) { pattern.push_back(Triplet<double>(i, i, 0.0)); }
+      for (System::NodeIt v(sys); v != INVALID; ++v) {
+         int vID = sys.stateID(v);
+         for (a=0; a<ns; ++a) {
+            for (b=0; b<ns; ++b) { pattern.push_back(Triplet<double>(vID+a, vID+b, 0.0)); }
+            for (System::InArcIt e(sys, v); e != INVALID; ++e) {
+               int jID = sys.stateID(sys.source(e)), eID = sys.stateID(e);
+               for (b=0; b<ns; ++b) { pattern.push_back(Triplet<double>(vID+a, jID+b, 0.0)); }
+               for (b=0; b<as; ++b) { pattern.push_back(Triplet<double>(vID+a, eID+b, 0.0)); }
+            }
+         }
+      }
+      if (as > 0) {
+         for (System::ArcIt e(sys); e != INVALID; ++e) {
+            int eID = sys.stateID(e), sID = sys.stateID(sys.source(e)), tID = sys.stateID(sys.target(e));
+            for (a=0; a<as; ++a) {
+               for (b=0; b<as; ++b) { pattern.push_back(Triplet<double>(eID+a, eID+b, 0.0)); }
+               for (b=0; b<ns; ++b) { 
+                  pattern.push_back(Triplet<double>(eID+a, sID+b, 0.0));
+                  pattern.push_back(Triplet<double>(eID+a, tID+b, 0.0));
+               }
+            }
+         }
+      }
+      J.resize(mStates, mStates);
+      J.setFromTriplets(pattern.begin(), pattern.end());
+      J.makeCompressed();
+      
+      // Analytic only if every dynamic can provide its derivatives
+      mAnalytic = true;
+      for (System::NodeIt v(sys); v != INVALID; ++v) {
+         if (!sys.nodeData(v).dynamic->hasJacobian()) { mAnalytic = false; }
+      }
+      for (System::ArcIt e(sys); e != INVALID; ++e) {
+         if (!sys.arcData(e).dynamic->hasJacobian()) { mAnalytic = false; }
+      }
+      
+      // Greedy colouring of the columns (columns sharing a row must differ)
+      SparseMatrix<double, RowMajor> rows(J);
+      vector<int> colour(mStates, -1), mark(mStates + 1, -1);
+      mColours = 0;
+      for (i=0; i<mStates; ++i) {
+         for (SparseMatrix<double>::InnerIterator p(J, i); p; ++p) {
+            for (SparseMatrix<double, RowMajor>::InnerIterator q(rows, p.row()); q; ++q) {
+               if (colour[q.col()] >= 0) { mark[colour[q.col()]] = i; }
+            }
+         }
+         int c = 0;
+         while (mark[c] == i) { ++c; }
+         colour[i] = c;
+         if (c + 1 > mColours) { mColours = c + 1; }
+      }
+      mGroupOffset.assign(mColours + 1, 0);
+      for (i=0; i<mStates; ++i) { mGroupOffset[colour[i] + 1]++; }
+      for (i=0; i<mColours; ++i) { mGroupOffset[i + 1] += mGroupOffset[i]; }
+      mGroup.resize(mStates);
+      vector<int> next(mGroupOffset.begin(), mGroupOffset.end() - 1);
+      for (i=0; i<mStates; ++i) { mGroup[next[colour[i]]++] = i; }
+      
+      mX.resize(mStates);
+      mF.resize(mStates);
+   }
+   
+   int SparseJacobian::evaluate (System &sys, const State &x, const State &f0, const double t) {
+      int k, c;
+      double *values = J.valuePtr();
+      const int *inner = J.innerIndexPtr(), *outer = J.outerIndexPtr();
+      
+      if (mAnalytic) {
+         std::fill(values, values + J.nonZeros(), 0.0);
+         mEntries.clear();
+         for (System::NodeIt v(sys); v != INVALID; ++v) { sys.nodeData(v).dynamic->jacobian(v, sys, x, t, mEntries); }
+         for (System::ArcIt e(sys); e != INVALID; ++e) { sys.arcData(e).dynamic->jacobian(e, sys, x, t, mEntries); }
+         int ignored = 0;
+         for (k=0; k<(int)mEntries.size(); ++k) {
+            jacobian_entry_t &entry = mEntries[k];
+            const int *p = std::lower_bound(inner + outer[entry.col], inner + outer[entry.col + 1], entry.row);
+            if (p != inner + outer[entry.col + 1] && *p == entry.row) { values[p - inner] += entry.value; }
+            else { ignored++; }
+         }
+         if (ignored > 0) {
+            cerr << "Jacobian entries outside of the graph structure ignored (SparseJacobian::evaluate)" << endl;
+         }
+         return 0;
+      }
+      
+      // Finite differences, perturbing every column of a group at once
+      const double root = sqrt(numeric_limits<double>::epsilon());
+      std::copy(x.begin(), x.end(), mX.begin());
+      for (c=0; c<mColours; ++c) {
+         for (k=mGroupOffset[c]; k<mGroupOffset[c+1]; ++k) {
+            int j = mGroup[k];
+            mX[j] = x[j] + root * max(fabs(x[j]), 1.0);
+         }
+         std::fill(mF.begin(), mF.end(), 0.0);
+         sys(mX, mF, t);
+         for (k=mGroupOffset[c]; k<mGroupOffset[c+1]; ++k) {
+            int j = mGroup[k];
+            // The step actually taken (after rounding)
+            double h = mX[j] - x[j];
+            for (int p=outer[j]; p<outer[j+1]; ++p) { values[p] = (mF[inner[p]] - f0[inner[p]]) / h; }
+            mX[j] = x[j];
+         }
+      }
+      return mColours;
+   }
+   
+   // ---------- SimulateOdeStiff ----------
+   
+   void SimulateOdeStiff::simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger) {
+      int i, k;
+      
+      // Check to ensure that initial conditions are correct size
+      int states = (countNodes(sys)*sys.nodeStates()) + (countArcs(sys)*sys.arcStates());
+      if (initial.size() < states || initial.size() > states) {
+         cerr << "Incorrect number of states for initial conditions (SimulateOdeStiff::simulate)" << endl;
+         return;
+      }
+      if (mOutputStep <= 0.0) {
+         cerr << "Output step must be positive (SimulateOdeStiff::simulate)" << endl;
+         return;
+      }
+      
+      // Check that the state IDs are correct, if not refresh
+      if (!sys.validStateIDs()) { sys.refreshStateIDs(); }
+      
+      mSteps = 0;
+      mRejected = 0;
+      mEvaluations = 0;
+      mJacobian.compile(sys);
+      
+      // Rosenbrock (2,3) coefficients
+      const double d = 1.0 / (2.0 + sqrt(2.0));
+      const double e32 = 6.0 + sqrt(2.0);
+      const double eps = numeric_limits<double>::epsilon();
+      
+      int n = states;
+      State &y = initial;
+      State F0(n), F1(n), F2(n), T(n), k1(n), k2(n), k3(n), yNew(n), rhs(n);
+      SparseMatrix<double> W;
+      SparseLU<SparseMatrix<double>, COLAMDOrdering<int> > lu;
+      bool analysed = false;
+      
+      // Evaluate the dynamics (states without dynamics have zero derivative)
+      auto dynamics = [&] (double tt, const State &xx, State &dxx) {
+         std::fill(dxx.begin(), dxx.end(), 0.0);
+         sys(xx, dxx, tt);
+         mEvaluations++;
+      };
+      auto solve = [&] (State &b, State &out) {
+         Map<VectorXd>(out.data(), n) = lu.solve(Map<VectorXd>(b.data(), n));
+      };
+      
+      ObserverPassThrough output(sys, obs, logger);
+      double t = 0.0;
+      output(y, t);
+      if (obs.stop()) { return; }
+      dynamics(t, y, F0);
+      
+      // Initial step from the rate of change (as ode23s)
+      double rate = 0.0;
+      for (i=0; i<n; ++i) { rate = max(rate, fabs(F0[i]) / (mEpsAbs + mEpsRel * fabs(y[i]))); }
+      rate /= 0.8 * pow(max(mEpsRel, eps), 1.0 / 3.0);
+      double h = (rate * mOutputStep > 1.0) ? 1.0 / rate : mOutputStep;
+      
+      bool newJacobian = true;
+      int outputs = (int)floor(tMax / mOutputStep + 1e-9);
+      for (k=1; k<=outputs; ++k) {
+         double tOut = k * mOutputStep;
+         while (t < tOut) {
+            // Do not step past the next output
+            double hStep = h;
+            bool last = false;
+            if (t + hStep >= tOut) { 
+               hStep = tOut - t;
+               last = true;
+            }
+            
+            // Jacobian and time derivative at the start of the step
+            if (newJacobian) {
+               mEvaluations += mJacobian.evaluate(sys, y, F0, t);
+               double dt = sqrt(eps) * max(fabs(t), 1.0);
+               dynamics(t + dt, y, T);
+               for (i=0; i<n; ++i) { T[i] = (T[i] - F0[i]) / dt; }
+               newJacobian = false;
+            }
+            
+            // Factorise W = I - h*d*J (the pattern only needs analysing once)
+            W = mJacobian.J * (-hStep * d);
+            for (i=0; i<n; ++i) { W.coeffRef(i, i) += 1.0; }
+            if (!analysed) {
+               lu.analyzePattern(W);
+               analysed = true;
+            }
+            lu.factorize(W);
+            
+            double error = numeric_limits<double>::infinity();
+            if (lu.info() == Success) {
+               // Stages
+               for (i=0; i<n; ++i) { rhs[i] = F0[i] + hStep * d * T[i]; }
+               solve(rhs, k1);
+               for (i=0; i<n; ++i) { yNew[i] = y[i] + 0.5 * hStep * k1[i]; }
+               dynamics(t + 0.5 * hStep, yNew, F1);
+               for (i=0; i<n; ++i) { rhs[i] = F1[i] - k1[i]; }
+               solve(rhs, k2);
+               for (i=0; i<n; ++i) { k2[i] += k1[i]; yNew[i] = y[i] + hStep * k2[i]; }
+               dynamics(t + hStep, yNew, F2);
+               for (i=0; i<n; ++i) {
+                  rhs[i] = F2[i] - e32 * (k2[i] - F1[i]) - 2.0 * (k1[i] - F0[i]) + hStep * d * T[i];
+               }
+               solve(rhs, k3);
+               
+               // Error estimate (third order)
+               error = 0.0;
+               for (i=0; i<n; ++i) {
+                  double e = (hStep / 6.0) * fabs(k1[i] - 2.0 * k2[i] + k3[i]);
+                  error = max(error, e / (mEpsAbs + mEpsRel * max(fabs(y[i]), fabs(yNew[i]))));
+               }
+            }
+            
+            if (!(error <= 1.0)) {
+               // Reject the step and try again with a smaller one
+               mRejected++;
+               NE_PROFILE_COUNT(PROF_STEPS_REJECTED, 1);
+               h = hStep * ((error < numeric_limits<double>::infinity()) ? max(0.2, 0.8 * pow(error, -1.0 / 3.0)) : 0.2);
+               if (h < 16.0 * eps * max(fabs(t), 1.0)) {
+                  cerr << "Step size too small at t = " << t << " (SimulateOdeStiff::simulate)" << endl;
+                  return;
+               }
+               continue;
+            }
+            
+            // Accept the step (F2 is the dynamics at the new state)
+            t = last ? tOut : t + hStep;
+            y.swap(yNew);
+            F0.swap(F2);
+            mSteps++;
+            NE_PROFILE_COUNT(PROF_STEPS_ACCEPTED, 1);
+            newJacobian = true;
+            double hNew = hStep * ((error > 0.0) ? min(5.0, max(0.2, 0.8 * pow(error, -1.0 / 3.0))) : 5.0);
+            // A step shortened to reach the output says little about the next one
+            if (!last || hStep >= h) { h = hNew; }
+         }
+         output(y, tOut);
+         if (obs.stop()) { return; }
+      }
+   }
+   
+} // netevo namespace
@@ -0,0 +1,126 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_STIFF_H
+#define NE_STIFF_H
+
+#include "system.h"
+#include "simulate.h"
+#include <Eigen/Sparse>
+#include <Eigen/SparseLU>
+
+using namespace std;
+
+namespace netevo {
+   
+   /** Sparse Jacobian of the dynamics of a System.
+    *  The sparsity pattern is taken from the graph: the states of a node may depend on its own 
+    *  states, those of the sources of its in-arcs and those of its in-arcs, and the states of an 
+    *  arc on its own states and those of its source and target (the same data a CompiledSystem 
+    *  gives to fnBatch). If every node and arc dynamic implements jacobian the entries they 
+    *  return are used, otherwise the Jacobian is found by finite differences with the columns 
+    *  grouped so that no two columns in a group share a row (a greedy colouring). Each group 
+    *  needs only a single evaluation of the dynamics, which for networks of bounded degree is a 
+    *  small number independent of the size of the System. The diagonal is always part of the 
+    *  pattern so that I - gamma*J can be factorised with the same pattern. */
+   class SparseJacobian {
+   public:
+      /** Jacobian (column major, with the pattern fixed by compile) */
+      SparseMatrix<double> J;
+      
+      SparseJacobian () : mStates(0), mAnalytic(false), mColours(0) { }
+      
+      /** Build the pattern (and column groups) for the current structure of a System. */
+      void compile (System &sys);
+      /** Evaluate the Jacobian at x, where f0 holds the dynamics at x. Returns the number of 
+       *  evaluations of the dynamics that were needed. */
+      int evaluate (System &sys, const State &x, const State &f0, const double t);
+      
+      /** Number of states (rows and columns) */
+      int states () { return mStates; }
+      /** Number of entries in the pattern */
+      int nonZeros () { return (int)J.nonZeros(); }
+      /** Whether the Jacobian is found from the jacobian methods of the dynamics */
+      bool analytic () { return mAnalytic; }
+      /** Number of column groups (evaluations of the dynamics for a finite difference Jacobian) */
+      int colours () { return mColours; }
+      
+   private:
+      int mStates;
+      bool mAnalytic;
+      int mColours;
+      /** Columns of each group (group c holds mGroup[mGroupOffset[c]] to mGroup[mGroupOffset[c+1]-1]) */
+      vector<int> mGroupOffset;
+      vector<int> mGroup;
+      /** Workspace */
+      State mX;
+      State mF;
+      vector<jacobian_entry_t> mEntries;
+   };
+   
+   /** Implicit methods for stiff dynamics. */
+   enum stiff_step_type_e { 
+      ROSENBROCK_23 = 0 /** Rosenbrock (2,3) of Shampine and Reichelt (as ode23s) */
+   };
+   
+   /** Adaptive simulation of stiff dynamics observed every outputStep (as SimulateOdeConst).
+    *  Each step solves the linear systems of a linearly implicit Rosenbrock method using a sparse 
+    *  LU factorisation of I - h*d*J, where J is a SparseJacobian found once per step. The 
+    *  factorisation reuses the symbolic analysis while the structure of the System is unchanged, 
+    *  so for a sparse network each step costs roughly a few evaluations of the dynamics (plus 
+    *  the number of column groups if the Jacobian is found by finite differences). The error 
+    *  of each step is controlled as odeint does (|err_i| <= epsAbs + epsRel*|x_i|). */
+   class SimulateOdeStiff : public Simulate {
+   public:
+      SimulateOdeStiff (stiff_step_type_e stepper, double epsAbs, double epsRel, double outputStep) { 
+         mStepper = stepper;
+         mEpsAbs = epsAbs;
+         mEpsRel = epsRel;
+         mOutputStep = outputStep;
+         mSteps = 0;
+         mRejected = 0;
+         mEvaluations = 0;
+      };
+      void simulate (System &sys, double tMax, State &initial, SimObserver &obs, ChangeLog &logger);
+      
+      /** Steps accepted during the last simulation */
+      int steps () { return mSteps; }
+      /** Steps rejected during the last simulation */
+      int rejected () { return mRejected; }
+      /** Evaluations of the dynamics during the last simulation (including for the Jacobian) */
+      int evaluations () { return mEvaluations; }
+      /** Jacobian used by the last simulation */
+      SparseJacobian & jacobian () { return mJacobian; }
+      
+   private:
+      stiff_step_type_e mStepper;
+      double mEpsAbs;
+      double mEpsRel;
+      double mOutputStep;
+      int    mSteps;
+      int    mRejected;
+      int    mEvaluations;
+      SparseJacobian mJacobian;
+   };
+   
+} // netevo namespace
+
+#endif // NE_STIFF_H
@@ -19,118 +19,459 @@
  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
  ============================================================================*/
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "system.h"
+#include "compiled.h"
+#include "profile.h"
 #include <iostream>
 #include <fstream>
 #include <ctime>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+#include <stdint.h>
 #include "gml.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace netevo {
 
+   System::~System () {
+      delete mCompiled;
+   }
+   
+   static shared_ptr<DynamicsLibrary> makeDefaultLibrary () {
+      // The null dynamics have no state so one of each serves every System
+      static NoNodeDynamic noNode;
+      static NoArcDynamic  noArc;
+      shared_ptr<DynamicsLibrary> library = make_shared<DynamicsLibrary>();
+      library->nodes["NoNodeDynamic"] = &noNode;
+      library->arcs["NoArcDynamic"] = &noArc;
+      return library;
+   }
+   
+   shared_ptr<DynamicsLibrary> System::defaultLibrary () {
+      static shared_ptr<DynamicsLibrary> library = makeDefaultLibrary();
+      return library;
+   }
+   
+   void System::ownLibrary () {
+      if (mDynamics.use_count() > 1) { mDynamics = make_shared<DynamicsLibrary>(*mDynamics); }
+   }
+   
+   NodeDynamic * System::findNodeDynamic (const string &name) {
+      std::map<string, NodeDynamic*>::iterator it = mDynamics->nodes.find(name);
+      return (it != mDynamics->nodes.end()) ? it->second : NULL;
+   }
+   
+   ArcDynamic * System::findArcDynamic (const string &name) {
+      std::map<string, ArcDynamic*>::iterator it = mDynamics->arcs.find(name);
+      return (it != mDynamics->arcs.end()) ? it->second : NULL;
+   }
+
    void System::operator() (const State &x, State &dx, const double t) {
+      NE_PROFILE_COUNT(PROF_RHS_CALLS, 1);
+      // Use the flat form if available (requires valid state IDs)
+      if (mUseCompiled && mValidCompiled) {
+         (*mCompiled)(*this, x, dx, t);
+         return;
+      }
       // Each vertex updates itself
       if (mNodeStates > 0) {
          for (System::NodeIt v(*this); v != INVALID; ++v) {
-            (*mNodeData)[v].dynamic->fn(v, *this, x, dx, t);
+            mNodeData[v].dynamic->fn(v, *this, x, dx, t);
          }
       }
       // Each edge updates itself
       if (mArcStates > 0) {
          for (System::ArcIt e(*this); e != INVALID; ++e) {
-            (*mArcData)[e].dynamic->fn(e, *this, x, dx, t);
+            mArcData[e].dynamic->fn(e, *this, x, dx, t);
          }
       }        
    }
 
-   void System::addNodeDynamic (NodeDynamic *nodeDynamic) {
-      mNodeDynamics.insert( pair<string,NodeDynamic*>(nodeDynamic->getName(), nodeDynamic) );
+   NodeDynamic * System::addNodeDynamic (NodeDynamic *nodeDynamic) {
+      ownLibrary();
+      std::map<string, NodeDynamic*>::iterator it = 
+         mDynamics->nodes.insert( pair<string,NodeDynamic*>(nodeDynamic->getName(), nodeDynamic) ).first;
       if (nodeDynamic->getStates() > mNodeStates) { mNodeStates = nodeDynamic->getStates(); }
+      return it->second;
    }
 
-   void System::addArcDynamic (ArcDynamic *arcDynamic) {
-      mArcDynamics.insert( pair<string,ArcDynamic*>(arcDynamic->getName(), arcDynamic) );
+   ArcDynamic * System::addArcDynamic (ArcDynamic *arcDynamic) {
+      ownLibrary();
+      std::map<string, ArcDynamic*>::iterator it = 
+         mDynamics->arcs.insert( pair<string,ArcDynamic*>(arcDynamic->getName(), arcDynamic) ).first;
       if (arcDynamic->getStates() > mArcStates) { mArcStates = arcDynamic->getStates(); }
+      return it->second;
    }
 
-   Node System::addNode (string dynamic) {
-      NodeDynamic *dyn = mNodeDynamics.find(dynamic)->second;
+   Node System::addNode (NodeDynamic *dyn) {
       Node v = Parent::addNode();
-      (*mNodeData)[v].key = mNextKey;
+      mNodeData[v].key = mNextKey;
       mNextKey++;
-      (*mNodeData)[v].position.x = 0.0;
-      (*mNodeData)[v].position.y = 0.0;
-      (*mNodeData)[v].position.z = 0.0;
-      (*mNodeData)[v].dynamic = dyn;
-      (*mNodeData)[v].dynamicParams.clear();
+      mNodeData[v].position.x = 0.0;
+      mNodeData[v].position.y = 0.0;
+      mNodeData[v].position.z = 0.0;
+      mNodeData[v].dynamic = dyn;
+      mNodeData[v].dynamicParams.clear();
       dyn->setDefaultParams(v, *this);
-      mValidNodeIDs = false;
+      // New nodes take the next free ID
+      if (mValidNodeIDs) {
+         mNodeIDs[v] = (int)mIDNodes.size();
+         mIDNodes.push_back(v);
+      }
+      if (mInDelta) {
+         delta_change_t c = {DELTA_ADD_NODE, mNodeIDs[v], -1, -1, -1};
+         mDelta.push_back(c);
+      }
+      mValidCompiled = false;
+      for (int i=0; i<(int)mListeners.size(); ++i) {
+         mListeners[i]->addNode(*this, v);
+      }
       return v;
    }
 
-   Node System::addNode (string name, string dynamic) {
+   Node System::addNode (const string &dynamic) {
+      return addNode(mDynamics->nodes.find(dynamic)->second);
+   }
+
+   Node System::addNode (const string &name, const string &dynamic) {
       Node v = addNode(dynamic);
-      (*mNodeData)[v].name = name;
+      mNodeData[v].name = name;
       return v;
    }
+   
+   void System::addNodes (int n, NodeDynamic *dynamic) {
+      reserveNode(maxNodeId() + 1 + n);
+      if (mValidNodeIDs) { mIDNodes.reserve(mIDNodes.size() + n); }
+      if (mInDelta) { mDelta.reserve(mDelta.size() + n); }
+      for (int i=0; i<n; ++i) { addNode(dynamic); }
+   }
 
-   Arc System::addArc (Node u, Node v, string dynamic) {
-      ArcDynamic *dyn = mArcDynamics.find(dynamic)->second;
+   Arc System::addArc (Node u, Node v, ArcDynamic *dyn) {
       Arc e = Parent::addArc(u,v);
-      (*mArcData)[e].weight = 1.0;
-      (*mArcData)[e].dynamic = dyn;
-      (*mArcData)[e].dynamicParams.clear();
+      mArcData[e].weight = 1.0;
+      mArcData[e].dynamic = dyn;
+      mArcData[e].dynamicParams.clear();
       dyn->setDefaultParams(e, *this);
-      mValidArcIDs = false;
+      // New arcs take the next free ID
+      if (mValidArcIDs) {
+         mArcIDs[e] = (int)mIDArcs.size();
+         mIDArcs.push_back(e);
+      }
+      if (mInDelta) {
+         delta_change_t c = {DELTA_ADD_ARC, mArcIDs[e], -1, -1, -1};
+         mDelta.push_back(c);
+      }
+      mValidCompiled = false;
+      for (int i=0; i<(int)mListeners.size(); ++i) {
+         mListeners[i]->addArc(*this, u, v);
+      }
       return e;
    }
 
-   Arc System::addArc (Node u, Node v, string name, string dynamic) {
+   Arc System::addArc (Node u, Node v, const string &dynamic) {
+      return addArc(u, v, mDynamics->arcs.find(dynamic)->second);
+   }
+
+   Arc System::addArc (Node u, Node v, const string &name, const string &dynamic) {
       Arc e = addArc(u, v, dynamic);
-      (*mArcData)[e].name = name;
+      mArcData[e].name = name;
       return e;
    }
+   
+   void System::addArcs (const vector< pair<Node,Node> > &arcs, ArcDynamic *dynamic) {
+      int n = (int)arcs.size();
+      reserveArc(maxArcId() + 1 + n);
+      if (mValidArcIDs) { mIDArcs.reserve(mIDArcs.size() + n); }
+      if (mInDelta) { mDelta.reserve(mDelta.size() + n); }
+      for (int i=0; i<n; ++i) { addArc(arcs[i].first, arcs[i].second, dynamic); }
+   }
 
-   Edge System::addEdge (Node u, Node v, string dynamic) {
+   Edge System::addEdge (Node u, Node v, ArcDynamic *dynamic) {
       Arc a1 = addArc(v, u, dynamic);
       Arc a2 = addArc(u, v, dynamic);
       return pair<Arc,Arc>(a1,a2);
    }
 
-   Edge System::addEdge (Node u, Node v, string name, string dynamic) {
+   Edge System::addEdge (Node u, Node v, const string &dynamic) {
+      return addEdge(u, v, mDynamics->arcs.find(dynamic)->second);
+   }
+
+   Edge System::addEdge (Node u, Node v, const string &name, const string &dynamic) {
       Arc a1 = addArc(v, u, name, dynamic);
       Arc a2 = addArc(u, v, name, dynamic);
       return pair<Arc,Arc>(a1,a2);
    }
    
-   Node System::getNode (int ID) {
-      // Iterate through (change to map in future)
-      System::NodeIt v(*this);
-      for (int i=0; i<ID; ++i) {
-         ++v;
-      }
-      return (Node)v;
+   double System::nodeParam (Node v, int slot) {
+      vector<double> &params = mNodeData[v].dynamicParams;
+      return (slot < (int)params.size()) ? params[slot] : 0.0;
    }
    
-   Arc System::getArc (int ID) {
-      // Iterate through (change to map in future)
-      System::ArcIt e(*this);
-      for (int i=0; i<ID; ++i) {
+   double System::arcParam (Arc e, int slot) {
+      vector<double> &params = mArcData[e].dynamicParams;
+      return (slot < (int)params.size()) ? params[slot] : 0.0;
+   }
+   
+   void System::setNodeParam (Node v, int slot, double value) {
+      vector<double> &params = mNodeData[v].dynamicParams;
+      if (slot >= (int)params.size()) { params.resize(slot + 1, 0.0); }
+      params[slot] = value;
+      if (mUseCompiled && mValidCompiled) { mCompiled->nodeParams.set(nodeID(v), slot, value); }
+   }
+   
+   void System::setArcParam (Arc e, int slot, double value) {
+      vector<double> &params = mArcData[e].dynamicParams;
+      if (slot >= (int)params.size()) { params.resize(slot + 1, 0.0); }
+      params[slot] = value;
+      if (mUseCompiled && mValidCompiled) { mCompiled->arcParams.set(arcID(e), slot, value); }
+   }
+   
+   void System::erase (Node v) {
+      // Remove the arcs first so that their IDs are kept up to date
+      for (OutArcIt e(*this, v); e != INVALID; ) {
+         Arc a = e;
+         ++e;
+         erase(a);
+      }
+      for (InArcIt e(*this, v); e != INVALID; ) {
+         Arc a = e;
          ++e;
+         erase(a);
+      }
+      for (int i=0; i<(int)mListeners.size(); ++i) {
+         mListeners[i]->erase(*this, v);
+      }
+      if (mInDelta) {
+         delta_change_t c = {DELTA_ERASE_NODE, mNodeIDs[v], -1, -1, (int)mDeltaNodeData.size()};
+         mDelta.push_back(c);
+         mDeltaNodeData.push_back(mNodeData[v]);
+      }
+      // Move the node with the last ID into the free slot
+      if (mValidNodeIDs) {
+         int ID = mNodeIDs[v];
+         Node last = mIDNodes.back();
+         mIDNodes[ID] = last;
+         mNodeIDs[last] = ID;
+         mIDNodes.pop_back();
+      }
+      Parent::erase(v);
+      mValidCompiled = false;
+   }
+   
+   void System::erase (Arc e) {
+      for (int i=0; i<(int)mListeners.size(); ++i) {
+         mListeners[i]->erase(*this, e);
+      }
+      if (mInDelta) {
+         delta_change_t c = {DELTA_ERASE_ARC, mArcIDs[e], mNodeIDs[source(e)], 
+                             mNodeIDs[target(e)], (int)mDeltaArcData.size()};
+         mDelta.push_back(c);
+         mDeltaArcData.push_back(mArcData[e]);
+      }
+      // Move the arc with the last ID into the free slot
+      if (mValidArcIDs) {
+         int ID = mArcIDs[e];
+         Arc last = mIDArcs.back();
+         mIDArcs[ID] = last;
+         mArcIDs[last] = ID;
+         mIDArcs.pop_back();
       }
-      return (Arc)e;
+      Parent::erase(e);
+      mValidCompiled = false;
+   }
+   
+   void System::attach (ChangeLog *listener) {
+      mListeners.push_back(listener);
+   }
+   
+   void System::detach (ChangeLog *listener) {
+      for (int i=0; i<(int)mListeners.size(); ++i) {
+         if (mListeners[i] == listener) {
+            mListeners.erase(mListeners.begin() + i);
+            break;
+         }
+      }
+   }
+   
+   void System::beginDelta () {
+      // Changes are recorded by ID so these must be valid
+      if (!mValidNodeIDs || !mValidArcIDs) { refreshStateIDs(); }
+      mDelta.clear();
+      mDeltaNodeData.clear();
+      mDeltaArcData.clear();
+      mDeltaNextKey = mNextKey;
+      mInDelta = true;
+   }
+   
+   int System::rollbackDelta () {
+      if (!mInDelta) {
+         cerr << "No delta to roll back (System::rollbackDelta)" << endl;
+         return -1;
+      }
+      
+      // Stop recording while the changes are undone
+      mInDelta = false;
+      
+      // Undo each change in reverse order so the IDs refer to the same nodes and arcs as when 
+      // the change was made
+      for (int i=(int)mDelta.size()-1; i>=0; --i) {
+         delta_change_t &c = mDelta[i];
+         switch (c.type) {
+            case DELTA_ADD_NODE:
+               erase(mIDNodes[c.ID]);
+               break;
+            
+            case DELTA_ADD_ARC:
+               erase(mIDArcs[c.ID]);
+               break;
+            
+            case DELTA_ERASE_NODE: {
+               Node v = Parent::addNode();
+               mNodeData[v] = mDeltaNodeData[c.data];
+               // Return the node that took over the ID to the end
+               if (c.ID < (int)mIDNodes.size()) {
+                  Node moved = mIDNodes[c.ID];
+                  mNodeIDs[moved] = (int)mIDNodes.size();
+                  mIDNodes.push_back(moved);
+                  mIDNodes[c.ID] = v;
+               }
+               else {
+                  mIDNodes.push_back(v);
+               }
+               mNodeIDs[v] = c.ID;
+               for (int j=0; j<(int)mListeners.size(); ++j) {
+                  mListeners[j]->addNode(*this, v);
+               }
+               break;
+            }
+            
+            case DELTA_ERASE_ARC: {
+               Arc e = Parent::addArc(mIDNodes[c.source], mIDNodes[c.target]);
+               mArcData[e] = mDeltaArcData[c.data];
+               // Return the arc that took over the ID to the end
+               if (c.ID < (int)mIDArcs.size()) {
+                  Arc moved = mIDArcs[c.ID];
+                  mArcIDs[moved] = (int)mIDArcs.size();
+                  mIDArcs.push_back(moved);
+                  mIDArcs[c.ID] = e;
+               }
+               else {
+                  mIDArcs.push_back(e);
+               }
+               mArcIDs[e] = c.ID;
+               for (int j=0; j<(int)mListeners.size(); ++j) {
+                  mListeners[j]->addArc(*this, mIDNodes[c.source], mIDNodes[c.target]);
+               }
+               break;
+            }
+            
+            case DELTA_UPDATE_NODE:
+               mNodeData[mIDNodes[c.ID]] = mDeltaNodeData[c.data];
+               for (int j=0; j<(int)mListeners.size(); ++j) {
+                  mListeners[j]->update(*this, mIDNodes[c.ID]);
+               }
+               break;
+            
+            case DELTA_UPDATE_ARC:
+               mArcData[mIDArcs[c.ID]] = mDeltaArcData[c.data];
+               for (int j=0; j<(int)mListeners.size(); ++j) {
+                  mListeners[j]->update(*this, mIDArcs[c.ID]);
+               }
+               break;
+            
+            default:
+               // Do nothing
+               break;
+         }
+      }
+      if (!mDelta.empty()) { mValidCompiled = false; }
+      mNextKey = mDeltaNextKey;
+      
+      // Clear the delta (keeping the memory for the next one)
+      mDelta.clear();
+      mDeltaNodeData.clear();
+      mDeltaArcData.clear();
+      return 0;
+   }
+   
+   int System::commitDelta () {
+      if (!mInDelta) {
+         cerr << "No delta to commit (System::commitDelta)" << endl;
+         return -1;
+      }
+      mInDelta = false;
+      mDelta.clear();
+      mDeltaNodeData.clear();
+      mDeltaArcData.clear();
+      return 0;
+   }
+   
+   void System::recordUpdate (Node v) {
+      if (mInDelta) {
+         delta_change_t c = {DELTA_UPDATE_NODE, mNodeIDs[v], -1, -1, (int)mDeltaNodeData.size()};
+         mDelta.push_back(c);
+         mDeltaNodeData.push_back(mNodeData[v]);
+      }
+      // The data (and so the dynamic parameters) are about to change
+      mValidCompiled = false;
+      for (int i=0; i<(int)mListeners.size(); ++i) {
+         mListeners[i]->update(*this, v);
+      }
+   }
+   
+   void System::recordUpdate (Arc e) {
+      if (mInDelta) {
+         delta_change_t c = {DELTA_UPDATE_ARC, mArcIDs[e], -1, -1, (int)mDeltaArcData.size()};
+         mDelta.push_back(c);
+         mDeltaArcData.push_back(mArcData[e]);
+      }
+      // The data (and so the dynamic parameters) are about to change
+      mValidCompiled = false;
+      for (int i=0; i<(int)mListeners.size(); ++i) {
+         mListeners[i]->update(*this, e);
+      }
+   }
+   
+   Node System::getNode (int ID) {
+      if (!mValidNodeIDs) { refreshStateIDs(); }
+      return mIDNodes[ID];
+   }
+   
+   Arc System::getArc (int ID) {
+      if (!mValidArcIDs) { refreshStateIDs(); }
+      return mIDArcs[ID];
    }
 
+   void System::reset () {
+      clear();
+      mListeners.clear();
+      mDynamics = defaultLibrary();
+      mNodeStates = 0;
+      mArcStates = 0;
+      mUseCompiled = false;
+      mThreads = 1;
+      mBlockWork = 16384;
+   }
+   
    void System::resetKeys () {
       mNextKey = 0;
       for (System::NodeIt v(*this); v != INVALID; ++v) {
-         (*mNodeData)[v].key = mNextKey;
+         mNodeData[v].key = mNextKey;
          mNextKey++;
       }
    }
 
    int System::saveToGML (string filename) {
       int i, j;
-      std::map<Node,int> nodeMap;
+      NodeMap<int> nodeMap(*this);
       std::ofstream fileOut;
       fileOut.open(filename.c_str());
 
@@ -148,71 +489,71 @@ namespace netevo {
       strftime(buffer, 80, " on %c", timeinfo);
 
       // Write the general header and start graph
-      fileOut << "Creator \"NetEvo 2.0.0" << buffer << "\"" << endl;
-      fileOut << "graph [" << endl;
+      fileOut << "Creator \"NetEvo 2.0.0" << buffer << "\"" << '\n';
+      fileOut << "graph [" << '\n';
 
       // Write directed flag
-      fileOut << " directed 1" << endl;
+      fileOut << " directed 1" << '\n';
 
       // Write the nodes
       i = 0;
       for (System::NodeIt v(*this); v != INVALID; ++v) {
          nodeMap[v] = i;
-         fileOut << " node [" << endl;
-         fileOut << "  id " << i << endl;
-         fileOut << "  key " << (*mNodeData)[v].key << endl;
-         fileOut << "  label \"" << (*mNodeData)[v].name << "\"" << endl;
-         fileOut << "  graphics [" << " x " << (*mNodeData)[v].position.x << " y " << 
-         (*mNodeData)[v].position.y << " z " << (*mNodeData)[v].position.z << " ]" << endl;
+         fileOut << " node [" << '\n';
+         fileOut << "  id " << i << '\n';
+         fileOut << "  key " << mNodeData[v].key << '\n';
+         fileOut << "  label \"" << mNodeData[v].name << "\"" << '\n';
+         fileOut << "  graphics [" << " x " << mNodeData[v].position.x << " y " << 
+         mNodeData[v].position.y << " z " << mNodeData[v].position.z << " ]" << '\n';
          
          // Build properties list
          fileOut << "  properties \"";
-         for (j=0; j<(*mNodeData)[v].properties.size(); j++) {
+         for (j=0; j<mNodeData[v].properties.size(); j++) {
             if (j>0) { fileOut << ","; }
-            fileOut << (*mNodeData)[v].properties[j];
+            fileOut << mNodeData[v].properties[j];
          }
-         fileOut << "\"" << endl;
-         fileOut << "  dynName \"" << (*mNodeData)[v].dynamic->getName() << "\"" << endl;
+         fileOut << "\"" << '\n';
+         fileOut << "  dynName \"" << mNodeData[v].dynamic->getName() << "\"" << '\n';
          
          // Build list of params
          fileOut << "  dynParams \"";
-         for (j=0; j<(*mNodeData)[v].dynamicParams.size(); j++) {
+         for (j=0; j<mNodeData[v].dynamicParams.size(); j++) {
             if (j>0) { fileOut << ","; }
-            fileOut << (*mNodeData)[v].dynamicParams[j];
+            fileOut << mNodeData[v].dynamicParams[j];
          }
-         fileOut << "\"" << endl;
-         fileOut << " ]" << endl;
+         fileOut << "\"" << '\n';
+         fileOut << " ]" << '\n';
          i++;
       }
 
       // Write the edges
       for (System::ArcIt e(*this); e != INVALID; ++e) {
-         fileOut << " edge [" << endl;
-         fileOut << "  source " << nodeMap[source(e)] << endl;
-         fileOut << "  target " << nodeMap[target(e)] << endl;
-         fileOut << "  label \"" << (*mArcData)[e].name << "\"" << endl;
-         fileOut << "  weight " << (*mArcData)[e].weight << endl;
+         fileOut << " edge [" << '\n';
+         fileOut << "  source " << nodeMap[source(e)] << '\n';
+         fileOut << "  target " << nodeMap[target(e)] << '\n';
+         fileOut << "  label \"" << mArcData[e].name << "\"" << '\n';
+         fileOut << "  weight " << mArcData[e].weight << '\n';
          
          // Build properties list
          fileOut << "  properties \"";
-         for (j=0; j<(*mArcData)[e].properties.size(); j++) {
+         for (j=0; j<mArcData[e].properties.size(); j++) {
             if (j>0) { fileOut << ","; }
-            fileOut << (*mArcData)[e].properties[j];
+            fileOut << mArcData[e].properties[j];
          }
-         fileOut << "\"" << endl;
-         fileOut << "  dynName \"" << (*mArcData)[e].dynamic->getName() << "\"" << endl;
+         fileOut << "\"" << '\n';
+         fileOut << "  dynName \"" << mArcData[e].dynamic->getName() << "\"" << '\n';
          
          // Build list of params
          fileOut << "  dynParams \"";
-         for (j=0; j<(*mArcData)[e].dynamicParams.size(); j++) {
+         for (j=0; j<mArcData[e].dynamicParams.size(); j++) {
             if (j>0) { fileOut << ","; }
-            fileOut << (*mArcData)[e].dynamicParams[j];
+            fileOut << mArcData[e].dynamicParams[j];
          }
-         fileOut << "\"" << endl;
-         fileOut << " ]" << endl;
+         fileOut << "\"" << '\n';
+         fileOut << " ]" << '\n';
       }
 
-      // End the file and close
+      // End the file and close (lines are not flushed individually)
       fileOut << "]" << endl;
       fileOut.close();
 
@@ -365,7 +706,7 @@ namespace netevo {
 
          tmp_node = addNode();
          id_2_node[(*it).first] = tmp_node;
-         NodeData &nData = (*mNodeData)[tmp_node];
+         NodeData &nData = mNodeData[tmp_node];
          
          key_list = (*it).second;
          while (key_list) {
@@ -425,7 +766,7 @@ namespace netevo {
             }
             else if (!strcmp (key_list->key, "dynName")) {
                assert (key_list->kind == GML_STRING);
-               nData.dynamic = mNodeDynamics[string(key_list->value.string)];
+               nData.dynamic = findNodeDynamic(string(key_list->value.string));
             }
             else if (!strcmp (key_list->key, "dynParams")) {
                assert (key_list->kind == GML_STRING);
@@ -448,13 +789,10 @@ namespace netevo {
          }
       }
 
-      // Make sure the next key is large enough.
-      int curKey = 0;
+      // Make sure the next key is larger than any loaded.
       for (System::NodeIt v(*this); v != INVALID; ++v) {
-         (*mNodeData)[v].key = curKey;
-         if (mNextKey<curKey) { mNextKey = curKey; }
+         if (mNextKey <= mNodeData[v].key) { mNextKey = mNodeData[v].key + 1; }
       }
-      mNextKey++;
    
       list<pair<pair<int,int>,GML_pair*> >::iterator eit, eend;
       for (eit = edge_entries.begin(), eend = edge_entries.end();
@@ -464,7 +802,7 @@ namespace netevo {
 
          // Handle adding the edge
          tmp_edge = addArc(source, target);
-         ArcData &eData = (*mArcData)[tmp_edge];
+         ArcData &eData = mArcData[tmp_edge];
          
          key_list = (*eit).second;
          while (key_list) {
@@ -496,7 +834,7 @@ namespace netevo {
             }
             else if (!strcmp (key_list->key, "dynName")) {
                assert (key_list->kind == GML_STRING);
-               eData.dynamic = mArcDynamics[string(key_list->value.string)]; 
+               eData.dynamic = findArcDynamic(string(key_list->value.string)); 
             }
             else if (!strcmp (key_list->key, "dynParams")) {
                assert (key_list->kind == GML_STRING);
@@ -528,37 +866,117 @@ namespace netevo {
       return 0;
    }
 
-   void System::randomGraph (double edgeProb, int numOfNodes, bool selfLoops, bool undirected) {
-      randomGraph(edgeProb, numOfNodes, selfLoops, "NoNodeDynamic", "NoArcDynamic", undirected);
+   // ---------- Graph generators ----------
+   
+   /** Nodes (or arcs) generated from each random number stream. Fixed rather than split by 
+    *  thread so that a generated topology only depends on the seed. */
+   static const int GEN_BLOCK = 4096;
+   
+   /** Arcs found by each block of a generator (as pairs of node IDs) */
+   typedef vector< vector< pair<int,int> > > gen_arcs_t;
+   
+   /** Threads to use for a number of blocks */
+   static int genThreads (int threads, int blocks) {
+#ifdef _OPENMP
+      if (threads <= 0) { threads = omp_get_max_threads(); }
+      return max(1, min(threads, blocks));
+#else
+      return 1;
+#endif
+   }
+   
+   /** Seeds for the random number stream of each block (drawn in order from rnd) */
+   static vector<int> genSeeds (Random &rnd, long blocks) {
+      vector<int> seeds(blocks);
+      for (long b=0; b<blocks; ++b) { seeds[b] = rnd.integer(2147483647); }
+      return seeds;
+   }
+   
+   /** Number of failures before the next success of trials with log(1 - p) = logq (logq < 0), 
+    *  clamped to limit so that the cast is always defined */
+   static inline long geometricSkip (Random &rnd, double logq, long limit) {
+      double skip = floor(log(1.0 - rnd()) / logq);
+      return (skip < (double)limit) ? (long)skip : limit;
+   }
+   
+   /** Drop arcs that repeat earlier ones (in block order) and, if asked, self-loops */
+   static void dropRepeats (gen_arcs_t &found, int n, bool undirected, bool dropLoops) {
+      size_t total = 0;
+      for (size_t b=0; b<found.size(); ++b) { total += found[b].size(); }
+      unordered_set<uint64_t> seen(total);
+      for (size_t b=0; b<found.size(); ++b) {
+         vector< pair<int,int> > &arcs = found[b];
+         size_t k = 0;
+         for (size_t i=0; i<arcs.size(); ++i) {
+            int u = arcs[i].first, v = arcs[i].second;
+            if (dropLoops && u == v) { continue; }
+            if (undirected && v < u) { swap(u, v); }
+            if (!seen.insert((uint64_t)u * n + v).second) { continue; }
+            arcs[k++] = arcs[i];
+         }
+         arcs.resize(k);
+      }
+   }
+   
+   /** Add the arcs found by a generator in block order (in both directions if undirected, 
+    *  except for self-loops which are added once) */
+   static void addFoundArcs (System &sys, gen_arcs_t &found, ArcDynamic *dyn, bool undirected) {
+      size_t total = 0;
+      for (size_t b=0; b<found.size(); ++b) { total += found[b].size() * (undirected ? 2 : 1); }
+      vector< pair<Node,Node> > arcs;
+      arcs.reserve(total);
+      for (size_t b=0; b<found.size(); ++b) {
+         for (size_t i=0; i<found[b].size(); ++i) {
+            Node u = sys.getNode(found[b][i].first), v = sys.getNode(found[b][i].second);
+            arcs.push_back(make_pair(u, v));
+            if (undirected && u != v) { arcs.push_back(make_pair(v, u)); }
+         }
+         vector< pair<int,int> >().swap(found[b]);
+      }
+      sys.addArcs(arcs, dyn);
+   }
+
+   void System::randomGraph (double edgeProb, int numOfNodes, bool selfLoops, bool undirected, int threads) {
+      randomGraph(edgeProb, numOfNodes, selfLoops, "NoNodeDynamic", "NoArcDynamic", undirected, threads);
    }
 
-   void System::randomGraph (double edgeProb, int numOfNodes, bool selfLoops, string defNodeDyn, string defEdgeDyn, bool undirected) {
-      // Clear any existing structure
+   void System::randomGraph (double edgeProb, int numOfNodes, bool selfLoops, string defNodeDyn, string defEdgeDyn, 
+                             bool undirected, int threads) {
+      // Clear any existing structure (a bulk change, so listeners are not notified)
+      SuspendListeners quiet(*this);
       clear();
       
       // Create the required number of nodes 
-      for (int i=0; i<numOfNodes; ++i) {
-         addNode(defNodeDyn);
-      }
-      
-      // Loop through all possible edges and add with given probability
-      for (System::NodeIt n1(*this); n1 != INVALID; ++n1) {
-         for (System::NodeIt n2(*this); n2 != INVALID; ++n2) {
-            if ((n1 == n2 && selfLoops) || n1 != n2) {
-               if (mRnd() <= edgeProb) {
-                  if (undirected) {
-                     // Check to make sure arc in other direction does not already exist
-                     if (findArc(*this, n1, n2) == INVALID) {
-                        addArc(n1, n2, defEdgeDyn);
-                        addArc(n2, n1, defEdgeDyn);
-                     }
-                  }
-                  else {
-                     addArc(n1, n2, defEdgeDyn);
-                  }
+      NodeDynamic *nDyn = findNodeDynamic(defNodeDyn);
+      ArcDynamic *eDyn = findArcDynamic(defEdgeDyn);
+      addNodes(numOfNodes, nDyn);
+      
+      // Gaps between the arcs added are geometric (and always 0 if every arc is added). A 
+      // probability too small to change 1 - p adds no arcs.
+      double logq = (edgeProb > 0.0) ? log1p(-min(edgeProb, 1.0)) : 0.0;
+      if (logq < 0.0) {
+         int blocks = (numOfNodes + GEN_BLOCK - 1) / GEN_BLOCK;
+         vector<int> seeds = genSeeds(mRnd, blocks);
+         gen_arcs_t found(blocks);
+#ifdef _OPENMP
+         #pragma omp parallel for schedule(dynamic) num_threads(genThreads(threads, blocks))
+#endif
+         for (int b=0; b<blocks; ++b) {
+            Random rnd;
+            rnd.seed(seeds[b]);
+            int last = min(numOfNodes, (b + 1) * GEN_BLOCK);
+            for (int u=b*GEN_BLOCK; u<last; ++u) {
+               // Possible targets of u (only later nodes if undirected so each pair is tried once)
+               long v = (undirected ? (selfLoops ? u : u + 1) : 0) - 1;
+               while (true) {
+                  v += 1 + geometricSkip(rnd, logq, numOfNodes);
+                  if (v >= numOfNodes) { break; }
+                  if (v == u && !selfLoops) { continue; }
+                  found[b].push_back(make_pair(u, (int)v));
                }
             }
          }
+         addFoundArcs(*this, found, eDyn, undirected);
       }
       
       // Update the state ID mapping
@@ -572,39 +990,147 @@ namespace netevo {
    void System::ringGraph (int numOfNodes, int neighbours, string defNodeDyn, string defEdgeDyn, bool undirected) {
       int i, j;
       
-      // Clear any existing structure
+      // Clear any existing structure (a bulk change, so listeners are not notified)
+      SuspendListeners quiet(*this);
       clear();
       
       // Create the required number of nodes 
-      for (int i=0; i<numOfNodes; ++i) {
-         addNode(defNodeDyn);
-      }
+      NodeDynamic *nDyn = findNodeDynamic(defNodeDyn);
+      ArcDynamic *eDyn = findArcDynamic(defEdgeDyn);
+      addNodes(numOfNodes, nDyn);
+      reserveArc(numOfNodes * neighbours * (undirected ? 2 : 1));
       
-      i = 0;
-      for (System::NodeIt v(*this); v != INVALID; ++v) {
+      // Connect each node to its neighbours (by ID)
+      for (i=0; i<numOfNodes; ++i) {
+         Node v = getNode(i);
          for (j=i+1; j<=i+neighbours; ++j) {
             if (undirected) {
-               addEdge(v, getNode(j%numOfNodes), defEdgeDyn);
+               addEdge(v, getNode(j%numOfNodes), eDyn);
             }
             else {
-               addArc(v, getNode(j%numOfNodes), defEdgeDyn);
+               addArc(v, getNode(j%numOfNodes), eDyn);
             }
          }
-         ++i;
       }
       
       // Update the state ID mapping
       refreshStateIDs();
    }
 
+   void System::smallWorldGraph (int numOfNodes, int neighbours, double rewireProb, bool undirected, int threads) {
+      smallWorldGraph(numOfNodes, neighbours, rewireProb, "NoNodeDynamic", "NoArcDynamic", undirected, threads);
+   }
+   
+   void System::smallWorldGraph (int numOfNodes, int neighbours, double rewireProb, string defNodeDyn, 
+                                 string defEdgeDyn, bool undirected, int threads) {
+      // Clear any existing structure (a bulk change, so listeners are not notified)
+      SuspendListeners quiet(*this);
+      clear();
+      
+      // Create the required number of nodes 
+      NodeDynamic *nDyn = findNodeDynamic(defNodeDyn);
+      ArcDynamic *eDyn = findArcDynamic(defEdgeDyn);
+      addNodes(numOfNodes, nDyn);
+      
+      // Rewiring needs a free node to move each arc to
+      bool rewire = (rewireProb > 0.0 && neighbours + 1 < numOfNodes);
+      int blocks = (numOfNodes + GEN_BLOCK - 1) / GEN_BLOCK;
+      vector<int> seeds = genSeeds(mRnd, blocks);
+      gen_arcs_t found(blocks);
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic) num_threads(genThreads(threads, blocks))
+#endif
+      for (int b=0; b<blocks; ++b) {
+         Random rnd;
+         rnd.seed(seeds[b]);
+         vector<int> made;
+         int last = min(numOfNodes, (b + 1) * GEN_BLOCK);
+         found[b].reserve((size_t)(last - b * GEN_BLOCK) * max(neighbours, 0));
+         for (int u=b*GEN_BLOCK; u<last; ++u) {
+            // Arcs to the next neighbours nodes around the ring (as ringGraph)
+            made.clear();
+            for (int j=1; j<=neighbours; ++j) {
+               int v = (u + j) % numOfNodes;
+               if (rewire && rnd() < rewireProb) {
+                  do {
+                     v = rnd.integer(numOfNodes);
+                  } while (v == u || find(made.begin(), made.end(), v) != made.end());
+               }
+               made.push_back(v);
+               found[b].push_back(make_pair(u, v));
+            }
+         }
+      }
+      dropRepeats(found, numOfNodes, undirected, false);
+      addFoundArcs(*this, found, eDyn, undirected);
+      
+      // Update the state ID mapping
+      refreshStateIDs();
+   }
+   
+   void System::scaleFreeGraph (int numOfNodes, int arcsPerNode, bool undirected, int threads) {
+      scaleFreeGraph(numOfNodes, arcsPerNode, "NoNodeDynamic", "NoArcDynamic", undirected, threads);
+   }
+   
+   void System::scaleFreeGraph (int numOfNodes, int arcsPerNode, string defNodeDyn, string defEdgeDyn, 
+                                bool undirected, int threads) {
+      // Clear any existing structure (a bulk change, so listeners are not notified)
+      SuspendListeners quiet(*this);
+      clear();
+      
+      // Create the required number of nodes 
+      NodeDynamic *nDyn = findNodeDynamic(defNodeDyn);
+      ArcDynamic *eDyn = findArcDynamic(defEdgeDyn);
+      addNodes(numOfNodes, nDyn);
+      
+      /* Arc k (made by node k / arcsPerNode) has end points 2k and 2k+1 in the list of all end 
+         points. Its target is the node at an end point drawn uniformly from 0..2k, which is 
+         found by following earlier targets back to a source. Drawing the end points needs no 
+         knowledge of the others so they are drawn in parallel. */
+      long m = max(arcsPerNode, 0);
+      long arcs = (long)numOfNodes * m;
+      long blocks = (arcs + GEN_BLOCK - 1) / GEN_BLOCK;
+      vector<int> seeds = genSeeds(mRnd, blocks);
+      vector<long> pos(arcs);
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(static) num_threads(genThreads(threads, blocks))
+#endif
+      for (long b=0; b<blocks; ++b) {
+         Random rnd;
+         rnd.seed(seeds[b]);
+         long last = min(arcs, (b + 1) * GEN_BLOCK);
+         for (long k=b*GEN_BLOCK; k<last; ++k) { pos[k] = rnd.integer(2 * k + 1); }
+      }
+      
+      gen_arcs_t found(blocks);
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(static) num_threads(genThreads(threads, blocks))
+#endif
+      for (long b=0; b<blocks; ++b) {
+         long last = min(arcs, (b + 1) * GEN_BLOCK);
+         found[b].reserve(last - b * GEN_BLOCK);
+         for (long k=b*GEN_BLOCK; k<last; ++k) {
+            long p = pos[k];
+            while (p & 1) { p = pos[(p - 1) / 2]; }
+            found[b].push_back(make_pair((int)(k / m), (int)((p / 2) / m)));
+         }
+      }
+      vector<long>().swap(pos);
+      dropRepeats(found, numOfNodes, undirected, true);
+      addFoundArcs(*this, found, eDyn, undirected);
+      
+      // Update the state ID mapping
+      refreshStateIDs();
+   }
+
    void System::makeUndirected () {
       for (System::ArcIt e(*this); e != INVALID; ++e) {
          // Check to make sure arc in other direction does not already exist
          if (findArc(*this, target(e), source(e)) == INVALID) {
             // Create the arc and copy the data
             Arc eNew = addArc(target(e), source(e));
-            ArcData &eData = (*mArcData)[e];
-            ArcData &eNewData = (*mArcData)[eNew];
+            ArcData &eData = mArcData[e];
+            ArcData &eNewData = mArcData[eNew];
             eNewData.name = eData.name;
             eNewData.weight = eData.weight;
             eNewData.properties = eData.properties;
@@ -691,8 +1217,67 @@ namespace netevo {
       return pair<VectorXcd, MatrixXcd>(es.eigenvalues(), es.eigenvectors());
    }
 
+   void System::sparseLaplacian (SparseMatrixXd &L) {
+      if (!mValidNodeIDs) { refreshStateIDs(); }
+      int n = nodeCount();
+      vector< Triplet<double> > t;
+      t.reserve(arcCount() + n);
+      
+      // Off diagonal terms (self-loops are covered by the diagonal)
+      for (System::ArcIt a(*this); a != INVALID; ++a) {
+         int i = nodeID(source(a)), j = nodeID(target(a));
+         if (i != j) { t.push_back(Triplet<double>(i, j, 1.0)); }
+      }
+      
+      // Diagonal terms
+      for (System::NodeIt v(*this); v != INVALID; ++v) {
+         int i = nodeID(v);
+         t.push_back(Triplet<double>(i, i, -countOutArcs(*this, v)));
+      }
+      
+      // Repeated arcs give a single entry (as for the dense matrix)
+      L.resize(n, n);
+      L.setFromTriplets(t.begin(), t.end(), [] (const double &a, const double &b) { return b; });
+   }
+   
+   void System::sparseAdjacency (SparseMatrixXd &A) {
+      if (!mValidNodeIDs) { refreshStateIDs(); }
+      int n = nodeCount();
+      vector< Triplet<double> > t;
+      t.reserve(arcCount());
+      for (System::ArcIt a(*this); a != INVALID; ++a) {
+         t.push_back(Triplet<double>(nodeID(source(a)), nodeID(target(a)), 1.0));
+      }
+      A.resize(n, n);
+      A.setFromTriplets(t.begin(), t.end(), [] (const double &a, const double &b) { return b; });
+   }
+   
+   VectorXd System::extremeEigenvalues (int k, bool largest, int mType) {
+      SparseMatrixXd A;
+      if (mType == 0) {
+         sparseLaplacian(A);
+      }
+      else {
+         sparseAdjacency(A);
+      }
+      LanczosSolver solver;
+      if (solver.compute(A, k, largest) < 0) { return VectorXd(); }
+      return solver.eigenvalues();
+   }
+   
+   double System::eigenratio () {
+      // The laplacian eigenvalues are all <= 0, so lambda_2 is the second largest and lambda_N 
+      // the smallest
+      VectorXd top = extremeEigenvalues(2, true);
+      VectorXd bottom = extremeEigenvalues(1, false);
+      if (top.size() < 2 || bottom.size() < 1) { return numeric_limits<double>::infinity(); }
+      double l2 = fabs(top(1)), ln = fabs(bottom(0));
+      if (l2 < 1e-10 * ln) { return numeric_limits<double>::infinity(); }
+      return ln / l2;
+   }
+   
    bool System::validStateIDs () {
-      return (mValidNodeIDs && mValidArcIDs);
+      return (mValidNodeIDs && mValidArcIDs && (!mUseCompiled || mValidCompiled));
    }
 
    void System::refreshStateIDs () {
@@ -701,8 +1286,10 @@ namespace netevo {
       // Update node IDs
       if (!mValidNodeIDs) {
          i = 0;
+         mIDNodes.clear();
          for (NodeIt v(*this); v != INVALID; ++v) {
-            (*mNodeIDs)[v] = i;
+            mNodeIDs[v] = i;
+            mIDNodes.push_back(v);
             ++i;
          }
       }
@@ -710,19 +1297,124 @@ namespace netevo {
       // Update arc IDs
       if (!mValidArcIDs) {
          i = 0;
+         mIDArcs.clear();
          for (ArcIt e(*this); e != INVALID; ++e) {
-            (*mArcIDs)[e] = i;
+            mArcIDs[e] = i;
+            mIDArcs.push_back(e);
             ++i;
          }
       }
+      mValidNodeIDs = true;
+      mValidArcIDs = true;
+      
+      // Update the compiled form
+      if (mUseCompiled && !mValidCompiled) {
+         if (mCompiled == NULL) { mCompiled = new CompiledSystem(); }
+         mCompiled->threads = mThreads;
+         mCompiled->blockWork = mBlockWork;
+         mCompiled->compile(*this);
+         mValidCompiled = true;
+      }
+   }
+   
+   void System::compile () {
+      if (mCompiled == NULL) { mCompiled = new CompiledSystem(); }
+      mUseCompiled = true;
+      mValidCompiled = false;
+      refreshStateIDs();
+   }
+   
+   void System::uncompile () {
+      mUseCompiled = false;
+      mValidCompiled = false;
+   }
+   
+   void System::setThreads (int threads, int blockWork) {
+      mThreads = threads;
+      if (blockWork != mBlockWork) {
+         // Blocks are cut when compiling
+         mBlockWork = blockWork;
+         mValidCompiled = false;
+      }
+      if (mCompiled != NULL) { mCompiled->threads = mThreads; }
+   }
+   
+   void System::reorderRCM () {
+      int i, k;
+      if (!mValidNodeIDs || !mValidArcIDs) { refreshStateIDs(); }
+      int n = (int)mIDNodes.size();
+      
+      // Undirected degree of each node (by current ID)
+      vector<int> degree(n, 0);
+      for (ArcIt e(*this); e != INVALID; ++e) {
+         ++degree[nodeID(source(e))];
+         ++degree[nodeID(target(e))];
+      }
+      
+      // Breadth first search of each component from a node of lowest degree, visiting the 
+      // neighbours of each node in order of increasing degree
+      auto byDegree = [&] (int a, int b) -> bool {
+         return (degree[a] != degree[b]) ? (degree[a] < degree[b]) : (a < b);
+      };
+      vector<int> start(n);
+      for (i=0; i<n; ++i) { start[i] = i; }
+      sort(start.begin(), start.end(), byDegree);
+      vector<char> visited(n, 0);
+      vector<int> order;
+      order.reserve(n);
+      vector<int> next;
+      for (k=0; k<n; ++k) {
+         if (visited[start[k]]) { continue; }
+         visited[start[k]] = 1;
+         order.push_back(start[k]);
+         for (size_t q=order.size()-1; q<order.size(); ++q) {
+            Node v = mIDNodes[order[q]];
+            next.clear();
+            for (OutArcIt e(*this, v); e != INVALID; ++e) {
+               int u = nodeID(target(e));
+               if (!visited[u]) { visited[u] = 1; next.push_back(u); }
+            }
+            for (InArcIt e(*this, v); e != INVALID; ++e) {
+               int u = nodeID(source(e));
+               if (!visited[u]) { visited[u] = 1; next.push_back(u); }
+            }
+            sort(next.begin(), next.end(), byDegree);
+            order.insert(order.end(), next.begin(), next.end());
+         }
+      }
+      
+      // Reverse the ordering to reduce the bandwidth further
+      vector<Node> nodes(n);
+      for (i=0; i<n; ++i) { nodes[i] = mIDNodes[order[n-1-i]]; }
+      mIDNodes = nodes;
+      for (i=0; i<n; ++i) { mNodeIDs[mIDNodes[i]] = i; }
+      
+      // Arcs follow the in-arcs of each node in turn
+      vector<pair<pair<int,int>,int> > arcs;
+      arcs.reserve(mIDArcs.size());
+      for (i=0; i<(int)mIDArcs.size(); ++i) {
+         Arc e = mIDArcs[i];
+         arcs.push_back(make_pair(make_pair(nodeID(target(e)), nodeID(source(e))), i));
+      }
+      sort(arcs.begin(), arcs.end());
+      vector<Arc> arcIDs(arcs.size());
+      for (i=0; i<(int)arcs.size(); ++i) { arcIDs[i] = mIDArcs[arcs[i].second]; }
+      mIDArcs = arcIDs;
+      for (i=0; i<(int)mIDArcs.size(); ++i) { mArcIDs[mIDArcs[i]] = i; }
+      
+      // The compiled form depends on the IDs
+      if (mUseCompiled) {
+         mValidCompiled = false;
+         refreshStateIDs();
+      }
    }
 
    int System::stateID (Node v) {
-      return (mNodeStates * (*mNodeIDs)[v]);
+      return (mNodeStates * mNodeIDs[v]);
    }
 
 	int System::stateID (Arc e) {
-		return ((mNodeStates * countNodes(*this)) + (mArcStates * (*mArcIDs)[e]));
+		return ((mNodeStates * nodeCount()) + (mArcStates * mArcIDs[e]));
 	}
    
    void ChangeLogSet::addChangeLog (ChangeLog *logger) {
@@ -730,61 +1422,67 @@ namespace netevo {
    }
    
    void ChangeLogSet::addNode (System &sys, Node n) {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->addNode(sys, n);
       }
    }
    
    void ChangeLogSet::addArc (System &sys, Node source, Node target) {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->addArc(sys, source, target);
       }
    }
    
    void ChangeLogSet::erase (System &sys, Node n) {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->erase(sys, n);
       }
    }
    
    void ChangeLogSet::erase (System &sys, Arc e) {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->erase(sys, e);
       }
    }
    
    void ChangeLogSet::update (System &sys, Node n) {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->update(sys, n);
       }
    }
    
    void ChangeLogSet::update (System &sys, Arc e) {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->update(sys, e);
       }
    }
    
    void ChangeLogSet::newState (System &sys, const State &newState) {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->newState(sys, newState);
       }
    }
    
+   void ChangeLogSet::stateDelta (System &sys, const State &newState, const vector<int> &changed) {
+      for (int i=0; i<mLoggers.size(); ++i) {
+         mLoggers[i]->stateDelta(sys, newState, changed);
+      }
+   }
+   
    void ChangeLogSet::endStep (step_type_e stepType) {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->endStep(stepType);
       }
    }
    
    void ChangeLogSet::rollback () {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->rollback();
       }
    }
    
    void ChangeLogSet::commit () {
-      for (int i=0; mLoggers.size(); ++i) {
+      for (int i=0; i<mLoggers.size(); ++i) {
          mLoggers[i]->commit();
       }
    }
@@ -845,6 +1543,25 @@ namespace netevo {
       }
    }
    
+   void ChangeLogToStream::stateDelta (System &sys, const State &newState, const vector<int> &changed) {
+      int i, k, stateIndex;
+      
+      // Arc states are not tracked by the delta so are always output in full
+      if (sys.arcStates() > 0) {
+         this->newState(sys, newState);
+         return;
+      }
+      for (k=0; k<(int)changed.size(); ++k) {
+         Node n = sys.getNode(changed[k]);
+         buffer << "NS," << sys.nodeData(n).key;
+         stateIndex = sys.stateID(n);
+         for (i=0; i<sys.nodeStates(); ++i) {
+            buffer << "," << newState[stateIndex + i];
+         }
+         buffer << endl;
+      }
+   }
+   
    void ChangeLogToStream::endStep (step_type_e stepType) { 
       switch (stepType) {
          case INIT_STEP:
@@ -872,10 +1589,78 @@ namespace netevo {
    void ChangeLogToStream::commit () { 
       
       // Write the buffer to the output
-      mOut << buffer.str(); 
+      string out = buffer.str();
+      NE_PROFILE_COUNT(PROF_BYTES_LOGGED, out.size());
+      mOut << out;
       
       // Reset (clear) the buffer
       rollback();
    }
    
+   void ChangeLogDelta::addNode (System &sys, Node n) {
+      mLogger.addNode(sys, n);
+   }
+   
+   void ChangeLogDelta::addArc (System &sys, Node source, Node target) {
+      mLogger.addArc(sys, source, target);
+   }
+   
+   void ChangeLogDelta::erase (System &sys, Node n) {
+      mLogger.erase(sys, n);
+   }
+   
+   void ChangeLogDelta::erase (System &sys, Arc e) {
+      mLogger.erase(sys, e);
+   }
+   
+   void ChangeLogDelta::update (System &sys, Node n) {
+      sys.recordUpdate(n);
+      mLogger.update(sys, n);
+   }
+   
+   void ChangeLogDelta::update (System &sys, Arc e) {
+      sys.recordUpdate(e);
+      mLogger.update(sys, e);
+   }
+   
+   void ChangeLogDelta::newState (System &sys, const State &newState) {
+      mLogger.newState(sys, newState);
+   }
+   
+   void ChangeLogDelta::stateDelta (System &sys, const State &newState, const vector<int> &changed) {
+      mLogger.stateDelta(sys, newState, changed);
+   }
+   
+   void ChangeLogDelta::endStep (step_type_e stepType) {
+      mLogger.endStep(stepType);
+   }
+   
+   void ChangeLogDelta::rollback () {
+      mLogger.rollback();
+   }
+   
+   void ChangeLogDelta::commit () {
+      mLogger.commit();
+   }
+   
+   SystemPool::~SystemPool () {
+      for (int i=0; i<(int)mFree.size(); ++i) { delete mFree[i]; }
+   }
+   
+   System * SystemPool::acquire () {
+      if (mFree.empty()) { return new System(); }
+      System *sys = mFree.back();
+      mFree.pop_back();
+      return sys;
+   }
+   
+   void SystemPool::release (System *sys) {
+      if ((int)mFree.size() >= mMaxFree) {
+         delete sys;
+         return;
+      }
+      sys->reset();
+      mFree.push_back(sys);
+   }
+   
 } // netevo namespace
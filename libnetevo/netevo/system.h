@@ -25,12 +25,14 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <memory>
 #include <iostream>
 #include <fstream>
 #include <lemon/list_graph.h>
 #include <lemon/random.h>
 #include <lemon/connectivity.h>
 #include <Eigen/Eigenvalues>
+#include "spectral.h"
 
 using namespace std;
 using namespace lemon;
@@ -46,16 +48,44 @@ namespace netevo {
    typedef pair<Arc, Arc> Edge;
    // Pre-define the system
    class System;
+   // Pre-define the compiled (flat) form of a system
+   class CompiledSystem;
+   // Pre-define the interleaved form of an ensemble of systems
+   class CompiledEnsemble;
+   class ChangeLog;
+   /** Non-zero entry of a Jacobian, the derivative of dx[row] with respect to x[col] (both state 
+    *  indexes). Entries with the same row and column are summed. */
+   typedef struct {
+      int    row;
+      int    col;
+      double value;
+   } jacobian_entry_t;
    /** State used for system dynamics (nodes and edges) */
    typedef vector<double> State;
     
-   /** Virtual class defining an interface for node dynamics. */
+   /** Virtual class defining an interface for node dynamics. 
+    *  Dynamics may optionally provide a batched version of fn that is used once a System has been
+    *  compiled (see System::compile). This updates a whole range of nodes in a single call using the
+    *  flat arrays of a CompiledSystem rather than the System itself. An ensemble version (fnEnsemble)
+    *  may also be provided that updates every member of an ensemble at once (see SimulateEnsemble). */
    class NodeDynamic {
    public:
       virtual string getName   () = 0;
       virtual int    getStates () = 0;
       virtual void   setDefaultParams (Node v, System &sys) = 0;
       virtual void   fn (Node v, System &sys, const State &x, State &dx, const double t) = 0;
+      /** Whether fnBatch is implemented (by default it is not and fn is called for each node). */
+      virtual bool   hasBatch () { return false; }
+      /** Update the nodes with IDs first to last-1 of a compiled System. */
+      virtual void   fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t) { }
+      /** Whether fnEnsemble is implemented (by default it is not and each member is updated alone). */
+      virtual bool   hasEnsemble () { return false; }
+      /** Update the nodes with IDs first to last-1 of every member of an interleaved ensemble. */
+      virtual void   fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t) { }
+      /** Whether jacobian is implemented (by default it is not and it is found by finite differences). */
+      virtual bool   hasJacobian () { return false; }
+      /** Append the derivatives of the node's dx with respect to any states it depends on (see SparseJacobian). */
+      virtual void   jacobian (Node v, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J) { }
    };
     
    /** Virtual class defining an interface for arc dynamics */
@@ -65,6 +95,18 @@ namespace netevo {
       virtual int    getStates () = 0;
       virtual void   setDefaultParams (Arc e, System &sys) = 0;
       virtual void   fn (Arc e, System &sys, const State &x, State &dx, const double t) = 0;
+      /** Whether fnBatch is implemented (by default it is not and fn is called for each arc). */
+      virtual bool   hasBatch () { return false; }
+      /** Update the arcs with IDs first to last-1 of a compiled System. */
+      virtual void   fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t) { }
+      /** Whether fnEnsemble is implemented (by default it is not and each member is updated alone). */
+      virtual bool   hasEnsemble () { return false; }
+      /** Update the arcs with IDs first to last-1 of every member of an interleaved ensemble. */
+      virtual void   fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t) { }
+      /** Whether jacobian is implemented (by default it is not and it is found by finite differences). */
+      virtual bool   hasJacobian () { return false; }
+      /** Append the derivatives of the arc's dx with respect to any states it depends on (see SparseJacobian). */
+      virtual void   jacobian (Arc e, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J) { }
    };
     
    /** Default null node dynamics */
@@ -73,6 +115,12 @@ namespace netevo {
       int    getStates () { return 0; };
       void   setDefaultParams (Node v, System &sys) { };
       void   fn (Node v, System &sys, const State &x, State &dx, const double t) { };
+      bool   hasBatch () { return true; }
+      void   fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t) { };
+      bool   hasEnsemble () { return true; }
+      void   fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t) { };
+      bool   hasJacobian () { return true; }
+      void   jacobian (Node v, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J) { };
    };
 
    /** Default null arc dynamics */
@@ -81,6 +129,12 @@ namespace netevo {
       int    getStates () { return 0; };
       void   setDefaultParams (Arc e, System &sys) { };
       void   fn (Arc e, System &sys, const State &x, State &dx, const double t) { };
+      bool   hasBatch () { return true; }
+      void   fnBatch (const CompiledSystem &cs, int first, int last, const State &x, State &dx, const double t) { };
+      bool   hasEnsemble () { return true; }
+      void   fnEnsemble (const CompiledEnsemble &ce, int first, int last, const State &x, State &dx, const double t) { };
+      bool   hasJacobian () { return true; }
+      void   jacobian (Arc e, System &sys, const State &x, const double t, vector<jacobian_entry_t> &J) { };
    };
 
    /** 3D position structure */
@@ -109,13 +163,40 @@ namespace netevo {
       vector<double>  dynamicParams;
    };
 
+   /** Types of change that can be recorded in a System delta */
+   typedef enum delta_type_e {
+      DELTA_ADD_NODE    = 0,
+      DELTA_ADD_ARC     = 1,
+      DELTA_ERASE_NODE  = 2,
+      DELTA_ERASE_ARC   = 3,
+      DELTA_UPDATE_NODE = 4,
+      DELTA_UPDATE_ARC  = 5
+   };
+   
+   /** A single change recorded in a System delta. Nodes and arcs are referred to by ID as their 
+    *  handles may change when a delta is rolled back. */
+   typedef struct {
+      delta_type_e type;    /**< Type of change */
+      int          ID;      /**< ID of the node or arc changed */
+      int          source;  /**< ID of the source node (erased arcs only) */
+      int          target;  /**< ID of the target node (erased arcs only) */
+      int          data;    /**< Index of the saved node or arc data (erase and update only) */
+   } delta_change_t;
+
+   /** Library of the dynamics that a System can use (by name). Libraries are shared between a 
+    *  System and its copies and only copied when dynamics are added to one of them. */
+   struct DynamicsLibrary {
+      std::map<string, NodeDynamic*> nodes;
+      std::map<string, ArcDynamic*>  arcs;
+   };
+
    class System : public ListDigraph {
    private:
       /** The parent type for systems */
       typedef ListDigraph Parent;
 
       /** Digraphs are not copy constructible. Use copySystem instead. */
-      System(const System &) : ListDigraph() { }
+      System(const System &) : ListDigraph(), mNodeIDs(*this), mArcIDs(*this), mNodeData(*this), mArcData(*this) { }
       /** Assignment of a digraph to another one is not allowed. Use copySystem instead. */
       void operator=(const System &) { }
       
@@ -131,79 +212,132 @@ namespace netevo {
       
       /** Mapping of Node to int ID (0..max nodes)
        *  Used to find the start index of a node in a simulation state vector. */
-      NodeMap<int> *mNodeIDs;
+      NodeMap<int> mNodeIDs;
        /** Mapping of Arc to int ID (0..max arcs)
         *  Used to find the start index of an arc in a simulation state vector. */
-      ArcMap<int>  *mArcIDs;
+      ArcMap<int>  mArcIDs;
+      /** Node for each ID (inverse of mNodeIDs) */
+      vector<Node> mIDNodes;
+      /** Arc for each ID (inverse of mArcIDs) */
+      vector<Arc>  mIDArcs;
       
       /** Flag specifying if node IDs mapping (mNodeIDs) is up to date */
       bool mValidNodeIDs;
       /** Flag specifying if arc IDs mapping (mArcIDs) is up to date */
       bool mValidArcIDs;
       
+      /** Compiled (flat) form of the System used to evaluate the dynamics */
+      CompiledSystem *mCompiled;
+      /** Flag specifying if the compiled form should be used for the dynamics */
+      bool mUseCompiled;
+      /** Flag specifying if the compiled form (mCompiled) is up to date */
+      bool mValidCompiled;
+      /** Threads used by the compiled form to evaluate the dynamics (see setThreads) */
+      int mThreads;
+      /** Work in each block of the compiled form (see setThreads) */
+      int mBlockWork;
+      
       /** Node map holding all node properties (name, properties, dynamics) */
-      NodeMap<NodeData> *mNodeData;
+      NodeMap<NodeData> mNodeData;
       /** Arc map holding all arc properties (name, weight, properties, dynamics) */
-      ArcMap<ArcData>   *mArcData;
+      ArcMap<ArcData>   mArcData;
 
-      /** Internal node dynamics library */
-      std::map<string, NodeDynamic*> mNodeDynamics;
-      /** Internal arc dynamics library */
-      std::map<string, ArcDynamic*>  mArcDynamics;
+      /** Node and arc dynamics library (shared with copies, see DynamicsLibrary) */
+      shared_ptr<DynamicsLibrary> mDynamics;
       
-      /** Null node dynamics (used as default when dynamics not specified) */
+      /** Null node dynamics (used as default when dynamics not specified, shared by all Systems) */
       NoNodeDynamic *noNodeDyn;
-      /** Null arc dynamics (used as default when dynamics not specified) */
+      /** Null arc dynamics (used as default when dynamics not specified, shared by all Systems) */
       NoArcDynamic *noArcDyn;
       
+      /** Library holding only the null dynamics (shared by new Systems) */
+      static shared_ptr<DynamicsLibrary> defaultLibrary ();
+      /** Make sure the dynamics library is not shared before changing it */
+      void ownLibrary ();
+      
       int mNextKey;
       
+      /** Objects notified of all nodes and arcs added or erased (see attach) */
+      vector<ChangeLog*> mListeners;
+      
+      /** Holds back the listeners for the duration of a bulk operation (see attach) */
+      class SuspendListeners {
+      private:
+         System             &mSys;
+         vector<ChangeLog*>  mSaved;
+      public:
+         SuspendListeners (System &sys) : mSys(sys) { mSaved.swap(sys.mListeners); }
+         ~SuspendListeners () { mSys.mListeners.swap(mSaved); }
+      };
+      
+      /** Flag specifying if changes are being recorded (see beginDelta) */
+      bool mInDelta;
+      /** Changes recorded since beginDelta (in the order they were made) */
+      vector<delta_change_t> mDelta;
+      /** Node data saved by the recorded changes */
+      vector<NodeData> mDeltaNodeData;
+      /** Arc data saved by the recorded changes */
+      vector<ArcData>  mDeltaArcData;
+      /** Next node key when beginDelta was called */
+      int mDeltaNextKey;
+      
       Random mRnd;
       
    public:
       /** System constructor
-       *  Creates an empty System with no node or arcs. Initialises internal mappings and adds
-       *  the null node and arc dynamics to the internal dynamics library. */
-      System () : Parent () {
+       *  Creates an empty System with no node or arcs. Initialises internal mappings and starts 
+       *  from the shared library holding only the null node and arc dynamics, so nothing is 
+       *  allocated for the dynamics until more are added. */
+      System () : Parent (), mNodeIDs(*this), mArcIDs(*this), mNodeData(*this), mArcData(*this) {
          mNodeStates = 0;
          mArcStates = 0;
-         mNodeData = new NodeMap<NodeData>(*this);
-         mArcData  = new ArcMap<ArcData>(*this);
-         mNodeIDs = new NodeMap<int>(*this);
-         mArcIDs  = new ArcMap<int>(*this);
          mValidNodeIDs = true;
          mValidArcIDs = true;
+         mCompiled = NULL;
+         mUseCompiled = false;
+         mValidCompiled = false;
+         mThreads = 1;
+         mBlockWork = 16384;
          // We include no dynamics as default types for all systems
-         noNodeDyn = new NoNodeDynamic();
-         noArcDyn = new NoArcDynamic();
-         addNodeDynamic(noNodeDyn);
-         addArcDynamic(noArcDyn);
+         mDynamics = defaultLibrary();
+         noNodeDyn = static_cast<NoNodeDynamic *>(mDynamics->nodes["NoNodeDynamic"]);
+         noArcDyn = static_cast<NoArcDynamic *>(mDynamics->arcs["NoArcDynamic"]);
          mNextKey = 0;
+         mInDelta = false;
          mRnd.seed();
       }
       
       /** System destructor */
-      ~System () {
-         delete noNodeDyn;
-         delete noArcDyn;
-         delete mNodeData;
-         delete mArcData;
-         delete mNodeIDs;
-         delete mArcIDs;
-      }
+      ~System ();
       
       void clear () {
          Parent::clear();
          
-         // State IDs are now invalid
-         mValidNodeIDs = false;
-         mValidArcIDs = false;
+         // Any delta being recorded can no longer be rolled back
+         mInDelta = false;
+         mDelta.clear();
+         mDeltaNodeData.clear();
+         mDeltaArcData.clear();
+         
+         // State IDs are trivially valid for an empty System
+         mIDNodes.clear();
+         mIDArcs.clear();
+         mValidNodeIDs = true;
+         mValidArcIDs = true;
+         mValidCompiled = false;
          
          // Reset our node keys
          mNextKey = 0;
       }
       
+      /** Empty the System so that it can be used again (see SystemPool). As clear, but listeners 
+       *  are detached and the System returns to the null dynamics and default settings of a new 
+       *  System. The storage of the graph, its maps, the state IDs and the compiled form is kept. */
+      void reset ();
+      
       void copyDigraph (const Digraph &from) {
+         SuspendListeners quiet(*this);
+         
          // Clear the existing System
          clear();
 
@@ -216,28 +350,31 @@ namespace netevo {
          copyDigraph(from);
          
          // Set the dynamics for every node
+         NodeDynamic *nDyn = findNodeDynamic(defNodeDyn);
          for (NodeIt v(*this); v != INVALID; ++v) {
-            NodeDynamic *nDyn = mNodeDynamics[defNodeDyn];
-            (*mNodeData)[v].dynamic = nDyn;
-            (*mNodeData)[v].dynamicParams.clear();
+            mNodeData[v].dynamic = nDyn;
+            mNodeData[v].dynamicParams.clear();
             nDyn->setDefaultParams(v, *this);
          }
          
          // Set the dynamics for every arc
+         ArcDynamic *eDyn = findArcDynamic(defArcDyn);
          for (ArcIt e(*this); e != INVALID; ++e) {
-            ArcDynamic *eDyn = mArcDynamics[defArcDyn];
-            (*mArcData)[e].dynamic = eDyn;
-            (*mArcData)[e].dynamicParams.clear();
+            mArcData[e].dynamic = eDyn;
+            mArcData[e].dynamicParams.clear();
             eDyn->setDefaultParams(e, *this);
          }
          mValidNodeIDs = false;
          mValidArcIDs = false;
+         mValidCompiled = false;
       }
       
       void copyDigraph (const Digraph &from, string defNodeDyn, string defArcDyn, 
                         Digraph::NodeMap< Digraph::Node >  &refNodeMap,
                         Digraph::ArcMap< Digraph::Arc >    &refArcMap
                         ) {
+         SuspendListeners quiet(*this);
+         
          // Clear the existing System
          clear();
          
@@ -248,22 +385,23 @@ namespace netevo {
          .run();
          
          // Set the dynamics for every node
+         NodeDynamic *nDyn = findNodeDynamic(defNodeDyn);
          for (NodeIt v(*this); v != INVALID; ++v) {
-            NodeDynamic *nDyn = mNodeDynamics[defNodeDyn];
-            (*mNodeData)[v].dynamic = nDyn;
-            (*mNodeData)[v].dynamicParams.clear();
+            mNodeData[v].dynamic = nDyn;
+            mNodeData[v].dynamicParams.clear();
             nDyn->setDefaultParams(v, *this);
          }
          
          // Set the dynamics for every arc
+         ArcDynamic *eDyn = findArcDynamic(defArcDyn);
          for (ArcIt e(*this); e != INVALID; ++e) {
-            ArcDynamic *eDyn = mArcDynamics[defArcDyn];
-            (*mArcData)[e].dynamic = eDyn;
-            (*mArcData)[e].dynamicParams.clear();
+            mArcData[e].dynamic = eDyn;
+            mArcData[e].dynamicParams.clear();
             eDyn->setDefaultParams(e, *this);
          }
          mValidNodeIDs = false;
          mValidArcIDs = false;
+         mValidCompiled = false;
       }
 
       /** Copy one System to another
@@ -274,16 +412,16 @@ namespace netevo {
          Arc  newE;
          NodeMap<Node> nr(from);
          ArcMap<Arc> acr(from);
+         SuspendListeners quiet(*this);
          
          // Clear the existing System
          clear();
          
          // Copy the graph structure
-         digraphCopy(from, *this).nodeRef(nr).arcCrossRef(acr).run();
+         digraphCopy(from, *this).nodeRef(nr).arcRef(acr).run();
 
-         // Copy the dynamics library
-         mNodeDynamics = *from.getNodeDynamicsMap();
-         mArcDynamics = *from.getArcDynamicsMap();
+         // Share the dynamics library (copied if either System adds to it)
+         mDynamics = from.mDynamics;
 
          // Copy the node data using the mapping
          for (NodeIt v(from); v != INVALID; ++v) {
@@ -312,9 +450,31 @@ namespace netevo {
             toArcData.properties = fromArcData.properties;
          }
          
-         // Invalidate IDs
-         mValidNodeIDs = false;
-         mValidArcIDs = false;
+         // Keep the IDs of the original so that state vectors are interchangeable
+         if (from.mValidNodeIDs && from.mValidArcIDs) {
+            mIDNodes.resize(from.mIDNodes.size());
+            for (NodeIt v(from); v != INVALID; ++v) {
+               int ID = from.nodeID(v);
+               mIDNodes[ID] = nr[v];
+               mNodeIDs[nr[v]] = ID;
+            }
+            mIDArcs.resize(from.mIDArcs.size());
+            for (ArcIt e(from); e != INVALID; ++e) {
+               int ID = from.arcID(e);
+               mIDArcs[ID] = acr[e];
+               mArcIDs[acr[e]] = ID;
+            }
+         }
+         else {
+            mValidNodeIDs = false;
+            mValidArcIDs = false;
+         }
+         
+         // The copy uses the compiled form if the original did
+         mUseCompiled = from.mUseCompiled;
+         mValidCompiled = false;
+         mThreads = from.mThreads;
+         mBlockWork = from.mBlockWork;
          
          // Copy the dynamic states
          mNodeStates = from.nodeStates();
@@ -333,39 +493,151 @@ namespace netevo {
       int nextKey () { return mNextKey; }
       void resetKeys ();
       
-      NodeData & nodeData (Node v) { return (*mNodeData)[v]; }
-      ArcData &  arcData  (Arc e) { return (*mArcData)[e]; }
+      NodeData & nodeData (Node v) { return mNodeData[v]; }
+      ArcData &  arcData  (Arc e) { return mArcData[e]; }
+      
+      /** Value of a dynamic parameter of a node (zero if not set) */
+      double nodeParam (Node v, int slot);
+      /** Value of a dynamic parameter of an arc (zero if not set) */
+      double arcParam  (Arc e, int slot);
+      /** Set a dynamic parameter of a node. Unlike changing nodeData directly this also updates
+       *  the parameter store of the compiled form, so compile does not need to be called again. */
+      void setNodeParam (Node v, int slot, double value);
+      /** Set a dynamic parameter of an arc (also updating the compiled form). */
+      void setArcParam  (Arc e, int slot, double value);
 
-      // Getter methods for the node and arc dynamics library (don't think this is required)
-      std::map<string, NodeDynamic*> * getNodeDynamicsMap () { return &mNodeDynamics; }
-      std::map<string, ArcDynamic*> * getArcDynamicsMap () { return &mArcDynamics; }
-      
-      void addNodeDynamic (NodeDynamic *nodeDynamic);
-      void addArcDynamic  (ArcDynamic  *arcDynamic);
+      // Getter methods for the node and arc dynamics library (no longer shared as it may be changed)
+      std::map<string, NodeDynamic*> * getNodeDynamicsMap () { ownLibrary(); return &mDynamics->nodes; }
+      std::map<string, ArcDynamic*> * getArcDynamicsMap () { ownLibrary(); return &mDynamics->arcs; }
+      
+      /** Add dynamics to the library. Returns a handle for the dynamics (those already in the 
+       *  library if the name is taken) that adds nodes without looking up the name. */
+      NodeDynamic * addNodeDynamic (NodeDynamic *nodeDynamic);
+      /** Add dynamics to the library (returning a handle as for addNodeDynamic). */
+      ArcDynamic *  addArcDynamic  (ArcDynamic  *arcDynamic);
+      /** Handle of the node dynamics with the given name (NULL if not in the library) */
+      NodeDynamic * findNodeDynamic (const string &name);
+      /** Handle of the arc dynamics with the given name (NULL if not in the library) */
+      ArcDynamic *  findArcDynamic  (const string &name);
 
-      Node addNode () { return addNode("NoNodeDynamic"); }
-      Node addNode (string dynamic);
-      Node addNode (string name, string dynamic);
+      Node addNode () { return addNode(noNodeDyn); }
+      Node addNode (NodeDynamic *dynamic);
+      Node addNode (const string &dynamic);
+      Node addNode (const string &name, const string &dynamic);
+      /** Add n nodes with the same dynamics, reserving the storage first. The new nodes take 
+       *  consecutive IDs (if the IDs are valid). */
+      void addNodes (int n, NodeDynamic *dynamic);
 
-      Arc addArc (Node u, Node v) { return addArc(u, v, "NoArcDynamic"); }
-      Arc addArc (Node u, Node v, string dynamic);
-      Arc addArc (Node u, Node v, string name, string dynamic);
+      Arc addArc (Node u, Node v) { return addArc(u, v, noArcDyn); }
+      Arc addArc (Node u, Node v, ArcDynamic *dynamic);
+      Arc addArc (Node u, Node v, const string &dynamic);
+      Arc addArc (Node u, Node v, const string &name, const string &dynamic);
+      /** Add an arc from the first to the second node of each pair with the same dynamics, 
+       *  reserving the storage first. */
+      void addArcs (const vector< pair<Node,Node> > &arcs, ArcDynamic *dynamic);
 
       // Add arcs in both directions (useful for undirected edges)
       Edge addEdge (Node u, Node v) { Arc a1 = addArc(v,u); Arc a2 = addArc(u,v); return pair<Arc,Arc>(a1,a2); }
-      Edge addEdge (Node u, Node v, string dynamic);
-      Edge addEdge (Node u, Node v, string name, string dynamic);
-      
+      Edge addEdge (Node u, Node v, ArcDynamic *dynamic);
+      Edge addEdge (Node u, Node v, const string &dynamic);
+      Edge addEdge (Node u, Node v, const string &name, const string &dynamic);
+      
+      /** Remove a node (and its arcs) from the System
+       *  The node with the largest ID takes over the ID of the removed node (likewise for arcs). */
+      void erase (Node v);
+      /** Remove an arc from the System
+       *  The arc with the largest ID takes over the ID of the removed arc. */
+      void erase (Arc e);
+      
+      /** Node with a given ID (0..nodes-1)
+       *  IDs are assigned in the order nodes are added and are kept up to date as nodes are
+       *  removed, so need not follow the NodeIt order. */
       Node getNode (int ID);
+      /** Arc with a given ID (0..arcs-1)
+       *  IDs are assigned in the order arcs are added and are kept up to date as arcs are
+       *  removed, so need not follow the ArcIt order. */
       Arc  getArc  (int ID);
       
+      /** ID (0..nodes-1) of a node, as used for getNode and to order the state vector */
+      int nodeID (Node v) { return mNodeIDs[v]; }
+      /** ID (0..arcs-1) of an arc, as used for getArc and to order the state vector */
+      int arcID  (Arc e)  { return mArcIDs[e]; }
+      
+      /** Number of nodes in the System (constant time when the state IDs are valid) */
+      int nodeCount () { return mValidNodeIDs ? (int)mIDNodes.size() : countNodes(*this); }
+      /** Number of arcs in the System (constant time when the state IDs are valid) */
+      int arcCount ()  { return mValidArcIDs ? (int)mIDArcs.size() : countArcs(*this); }
+      
+      /** Attach a listener to the System
+       *  The listener is notified through its ChangeLog methods of every node and arc added (after
+       *  the change is made) or erased (before the change is made), including those made to roll 
+       *  back a delta. Updates to node or arc data are notified by recordUpdate (before the change 
+       *  is made) and when rolled back (after the data is restored). Bulk operations that replace 
+       *  the whole System (clear, copySystem, copyDigraph, openBinary, reset and the graph 
+       *  generators) send no events at all, not even for the nodes and arcs they add, so a 
+       *  listener must be reset after them (e.g. SystemHash::reset). Listeners stay attached 
+       *  through these operations, except reset which detaches them, and are not copied with 
+       *  the System. */
+      void attach (ChangeLog *listener);
+      /** Detach a listener from the System */
+      void detach (ChangeLog *listener);
+      
+      /** Start recording a delta
+       *  All nodes and arcs added or erased from now on are recorded so that the System can be 
+       *  returned to its current state (including all IDs) by rollbackDelta, or the changes kept 
+       *  by commitDelta, without making a copy. Changes to node or arc data are only recorded if 
+       *  recordUpdate is called before they are made (ChangeLogDelta does this for ChangeLog 
+       *  updates). Bulk operations that clear the System (e.g. copySystem) end the delta. */
+      void beginDelta ();
+      /** Undo all changes recorded since beginDelta. Returns 0 if successful. */
+      int  rollbackDelta ();
+      /** Keep all changes recorded since beginDelta. Returns 0 if successful. */
+      int  commitDelta ();
+      /** Whether a delta is being recorded */
+      bool inDelta () { return mInDelta; }
+      /** Save the data of a node before it is changed (so the change can be rolled back) and 
+       *  notify any listeners of the update */
+      void recordUpdate (Node v);
+      /** Save the data of an arc before it is changed (so the change can be rolled back) and 
+       *  notify any listeners of the update */
+      void recordUpdate (Arc e);
+      
       /** Whether the current state IDs are valid */
       bool validStateIDs ();
-      /** Force a recalculation of the state IDs */
+      /** Force a recalculation of the state IDs (and the compiled form if one is being used) */
       void refreshStateIDs ();
       
+      /** Compile the System into a flat form (CompiledSystem) that is used to evaluate the dynamics.
+       *  The compiled form is a snapshot of the topology, weights and dynamic parameters. It is rebuilt 
+       *  automatically by refreshStateIDs after nodes or arcs are added or removed. Dynamic parameters
+       *  changed using setNodeParam or setArcParam are kept up to date, but compile must be called 
+       *  again if node or arc data is changed directly. */
+      void compile ();
+      /** Stop using the compiled form to evaluate the dynamics. */
+      void uncompile ();
+      /** Whether the compiled form is being used to evaluate the dynamics */
+      bool isCompiled () { return mUseCompiled; }
+      /** The compiled form of the System (NULL if it has never been compiled) */
+      CompiledSystem * compiled () { return mCompiled; }
+      
+      /** Evaluate the dynamics of the compiled form using several threads (OpenMP).
+       *  The nodes and arcs are split into blocks of around blockWork nodes plus in-arcs (or arcs) 
+       *  which are handed out to the threads as they become free. Setting threads to 0 uses the 
+       *  OpenMP default and 1 (the default) evaluates serially. The simulators also parallelise 
+       *  their vector operations when threads is not 1. Only worthwhile for large Systems; the fn 
+       *  of node and arc dynamics without a batched implementation must be thread safe. */
+      void setThreads (int threads, int blockWork = 16384);
+      /** Threads used to evaluate the dynamics of the compiled form (see setThreads) */
+      int threads () { return mThreads; }
+      
+      /** Renumber the nodes using the reverse Cuthill-McKee ordering of the (undirected) graph.
+       *  Connected nodes are given nearby IDs so that their states sit close together in memory, 
+       *  and arcs are numbered by target and then source. The new IDs are kept until nodes or arcs 
+       *  are next added or erased; any existing state vectors must be reordered to match. */
+      void reorderRCM ();
+      
       /** Total number of states to simulate this System. */
-      int totalStates () { return ((mNodeStates * countNodes(*this)) + (mArcStates * countArcs(*this))); }
+      int totalStates () { return ((mNodeStates * nodeCount()) + (mArcStates * arcCount())); }
       
       /** State ID for a given node
        *  Calculates the index for the node in any dynamical state vector. */
@@ -383,6 +655,29 @@ namespace netevo {
        *  GML file was not saved directly from NetEvo then some features such as dynamics and
        *  properties may not be loaded and defaults will instead be used. */
       int openFromGML (string filename);
+      /** Open a System from a GML file (fast)
+       *  Loads the same files as openFromGML in a single pass over the memory mapped file, adding 
+       *  nodes and arcs as they are read rather than building the whole GML tree first. Nested 
+       *  lists other than node graphics are skipped. Every node must have an id that no other node 
+       *  has. Returns 0 if successful, 1 if the file could not be opened and 2 if it is not valid 
+       *  GML, in which case the System is left unchanged. */
+      int openFromGMLFast (string filename);
+      
+      /** Save a System to a binary snapshot
+       *  A compact versioned format (see snapshot.h) holding the topology in CSR form, the node 
+       *  and arc data packed by ID and a table of the names and dynamics used. This is much faster 
+       *  to save and load than GML and keeps the node and arc IDs. Returns 0 if successful. */
+      int saveBinary (string filename);
+      /** Save a binary snapshot to a buffer in memory (replacing its contents). */
+      void saveBinary (vector<char> &buffer);
+      /** Open a System from a binary snapshot
+       *  Replaces the contents of the System (listeners are not notified). The dynamics used must 
+       *  already have been added, unknown ones are replaced by no dynamics. The file is memory 
+       *  mapped and read in place. Returns 0 if successful, 1 if the file could not be opened and 
+       *  2 if it is not a valid snapshot. */
+      int openBinary (string filename);
+      /** Open a System from a binary snapshot in memory. */
+      int openBinary (const char *data, size_t bytes);
       
       /** Seed the internal random number generator with a specific seed. */
       void seedRnd (int seed) { mRnd.seed(seed); }
@@ -392,14 +687,42 @@ namespace netevo {
       Random & getRandom() { return mRnd; }
       
       /** Generate a random topology with no dynamics. */
-      void randomGraph (double edgeProb, int numOfNodes, bool selfLoops, bool undirected);
-      /** Generate a random topology with user specific node and edge dynamics. */
-      void randomGraph (double edgeProb, int numOfNodes, bool selfLoops, string defNodeDyn, string defEdgeDyn, bool undirected);
+      void randomGraph (double edgeProb, int numOfNodes, bool selfLoops, bool undirected, int threads = 0);
+      /** Generate a random topology with user specific node and edge dynamics.
+       *  Each possible arc (or edge joining a pair of nodes if undirected) is added with probability 
+       *  edgeProb. Only the arcs added are visited (the gap to the next is drawn from a geometric 
+       *  distribution), so this takes time proportional to the number of nodes and arcs. Nodes 
+       *  are split into fixed blocks each with its own random number stream (seeded from the 
+       *  System's generator), which are generated on threads threads (0 = OpenMP default). The 
+       *  topology then depends only on the seed. */
+      void randomGraph (double edgeProb, int numOfNodes, bool selfLoops, string defNodeDyn, string defEdgeDyn, 
+                        bool undirected, int threads = 0);
       
       void ringGraph (int numOfNodes, int neighbours, bool undirected);
       
       void ringGraph (int numOfNodes, int neighbours, string defNodeDyn, string defEdgeDyn, bool undirected);
       
+      /** Generate a Watts-Strogatz small world topology with no dynamics. */
+      void smallWorldGraph (int numOfNodes, int neighbours, double rewireProb, bool undirected, int threads = 0);
+      /** Generate a Watts-Strogatz small world topology with user specific node and edge dynamics.
+       *  Starts from ringGraph and moves the far end of each arc to a node chosen uniformly at 
+       *  random with probability rewireProb (avoiding self-loops and arcs already made from the same
+       *  node). The few rewired arcs that repeat another are dropped. Generated in parallel as for 
+       *  randomGraph. */
+      void smallWorldGraph (int numOfNodes, int neighbours, double rewireProb, string defNodeDyn, 
+                            string defEdgeDyn, bool undirected, int threads = 0);
+      
+      /** Generate a Barabasi-Albert scale free topology with no dynamics. */
+      void scaleFreeGraph (int numOfNodes, int arcsPerNode, bool undirected, int threads = 0);
+      /** Generate a Barabasi-Albert scale free topology with user specific node and edge dynamics.
+       *  Nodes are added in turn, each making arcsPerNode arcs to earlier nodes chosen with 
+       *  probability proportional to their degree (using the list of arc end points of Batagelj and
+       *  Brandes, so this takes time proportional to the number of arcs). Arcs are directed from 
+       *  the new node. The self-loops and repeated arcs that the method can produce are dropped, so a 
+       *  few nodes make fewer arcs. The end points are drawn in parallel as for randomGraph. */
+      void scaleFreeGraph (int numOfNodes, int arcsPerNode, string defNodeDyn, string defEdgeDyn, 
+                           bool undirected, int threads = 0);
+      
       /** Will ensure that all arc (u->v) have a matching arc (v->u) for all u and v. */
       void makeUndirected ();
       
@@ -412,6 +735,40 @@ namespace netevo {
        *  Allows the eigensystem of the network to be generated using the laplacian or adjacency matrix */
       pair<VectorXcd, MatrixXcd> eigensystem (int mType = 0);
       
+      /** Sparse laplacian matrix (of the same form used by eigenvalues), indexed by node ID */
+      void sparseLaplacian (SparseMatrixXd &L);
+      /** Sparse adjacency matrix, indexed by node ID */
+      void sparseAdjacency (SparseMatrixXd &A);
+      /** Calculate the k algebraically largest (or smallest) eigenvalues for the network
+       *  Uses the sparse laplacian (mType = 0) or adjacency matrix and a partial iterative 
+       *  eigensolver (see LanczosSolver), so is suitable for large networks. The matrix must be 
+       *  symmetric (i.e. the network undirected). Returns an empty vector if this fails. */
+      VectorXd extremeEigenvalues (int k, bool largest, int mType = 0);
+      /** Eigenratio lambda_N / lambda_2 of the laplacian (a measure of synchronisability), found 
+       *  using extremeEigenvalues. Returns infinity if the network is not connected. */
+      double eigenratio ();
+      
+   };
+   
+   /** Pool of empty Systems kept for reuse. A System acquired from the pool is an ordinary heap 
+    *  allocated System (it may also be deleted rather than released). Released Systems are reset 
+    *  (see System::reset) and keep their storage, so copying another System into one that has 
+    *  held a System of a similar size allocates little or nothing. Not thread safe. */
+   class SystemPool {
+   private:
+      vector<System *> mFree;
+      int              mMaxFree;
+   public:
+      /** Pool holding at most maxFree Systems (others released are deleted) */
+      SystemPool (int maxFree = 64) : mMaxFree(maxFree) { }
+      ~SystemPool ();
+      
+      /** An empty System (reused if possible) */
+      System * acquire ();
+      /** Return a System to the pool */
+      void     release (System *sys);
+      /** Number of Systems held */
+      int      size () { return (int)mFree.size(); }
    };
    
    /** Types of step that can occur. */
@@ -434,6 +791,11 @@ namespace netevo {
       virtual void update   (System &sys, Arc e) { };
       
       virtual void newState (System &sys, const State &newState) { };
+      /** New state in which only the nodes with IDs in changed differ from the last state logged. 
+       *  By default the whole state is logged using newState. */
+      virtual void stateDelta (System &sys, const State &newState, const vector<int> &changed) { 
+         this->newState(sys, newState); 
+      };
       
       virtual void endStep  (step_type_e stepType) { };
       
@@ -441,7 +803,7 @@ namespace netevo {
       virtual void commit   () { };
    };
    
-   class ChangeLogSet : ChangeLog {
+   class ChangeLogSet : public ChangeLog {
    private:
       vector<ChangeLog*> mLoggers;
    public:
@@ -458,6 +820,7 @@ namespace netevo {
       void update   (System &sys, Arc e);
       
       void newState (System &sys, const State &newState);
+      void stateDelta (System &sys, const State &newState, const vector<int> &changed);
       
       void endStep  (step_type_e stepType);
       
@@ -465,6 +828,8 @@ namespace netevo {
       void commit   ();
    };
    
+   /** Writes all changes to a stream as text. States logged using stateDelta only list the 
+    *  nodes that changed (readers should keep the last state of any node not listed). */
    class ChangeLogToStream : public ChangeLog {
    private:
       ostream &mOut;
@@ -481,6 +846,32 @@ namespace netevo {
       void update   (System &sys, Arc e);
       
       void newState (System &sys, const State &newState);
+      void stateDelta (System &sys, const State &newState, const vector<int> &changed);
+      
+      void endStep  (step_type_e stepType);
+      
+      void rollback ();
+      void commit   ();
+   };
+   
+   /** Passes all changes on to another ChangeLog, first recording node and arc updates in the delta 
+    *  of the System (see System::beginDelta) so that they can be rolled back. */
+   class ChangeLogDelta : public ChangeLog {
+   private:
+      ChangeLog &mLogger;
+   public:
+      ChangeLogDelta (ChangeLog &logger) : mLogger(logger) { }
+      
+      void addNode  (System &sys, Node n);
+      void addArc   (System &sys, Node source, Node target);
+      void erase    (System &sys, Node n);
+      void erase    (System &sys, Arc e);
+      
+      void update   (System &sys, Node n);
+      void update   (System &sys, Arc e);
+      
+      void newState (System &sys, const State &newState);
+      void stateDelta (System &sys, const State &newState, const vector<int> &changed);
       
       void endStep  (step_type_e stepType);
       
@@ -0,0 +1,348 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "trajectory.h"
+#include "profile.h"
+#include <cstring>
+#include <limits>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+namespace netevo {
+   
+   const char     TRAJ_MAGIC[8]   = { 'N', 'E', 'T', 'E', 'V', 'O', 'T', 'R' };
+   const uint32_t TRAJ_BYTE_ORDER = 0x01020304;
+   const uint32_t TRAJ_VERSION    = 1;
+   const uint32_t TRAJ_COMPRESSED = 1;
+   
+   // ---------- TrajectoryWriter ----------
+   
+   int TrajectoryWriter::open (const string &filename, int states, traj_precision_e precision, 
+                               int chunkSteps, bool compress) {
+      close();
+      if (states < 0 || chunkSteps < 1 || (precision != TRAJ_FLOAT64 && precision != TRAJ_FLOAT32)) {
+         cerr << "Invalid trajectory layout (TrajectoryWriter::open)" << endl;
+         return -1;
+      }
+#ifndef HAVE_LIBZ
+      if (compress) {
+         cerr << "Compression not available, chunks will be stored uncompressed (TrajectoryWriter::open)" << endl;
+         compress = false;
+      }
+#endif
+      mOut.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+      if (!mOut.is_open()) {
+         cerr << "Could not open file: " << filename << " (TrajectoryWriter::open)" << endl;
+         return -1;
+      }
+      memset(&mHeader, 0, sizeof(traj_header_t));
+      memcpy(mHeader.magic, TRAJ_MAGIC, 8);
+      mHeader.byteOrder = TRAJ_BYTE_ORDER;
+      mHeader.version = TRAJ_VERSION;
+      mHeader.precision = precision;
+      mHeader.states = states;
+      mHeader.chunkSteps = chunkSteps;
+      mHeader.flags = compress ? TRAJ_COMPRESSED : 0;
+      mCompress = compress;
+      mSteps = 0;
+      mFailed = false;
+      mIndex.clear();
+      
+      // Storage for a full chunk (by column) so that observing never allocates
+      mTimes.resize(chunkSteps);
+      mData.resize((size_t)chunkSteps * states);
+      mBuffer.resize((size_t)chunkSteps * (8 + states * precision));
+#ifdef HAVE_LIBZ
+      if (compress) { mZipped.resize(compressBound(mBuffer.size())); }
+#endif
+      
+      // The header is rewritten with the final counts on close
+      mOut.write((const char *)&mHeader, sizeof(traj_header_t));
+      return 0;
+   }
+   
+   void TrajectoryWriter::operator() (const State &x, double t) {
+      if (!mOut.is_open() || mFailed) { return; }
+      int i, states = mHeader.states;
+      if ((int)x.size() != states) {
+         cerr << "Incorrect number of states (TrajectoryWriter)" << endl;
+         mFailed = true;
+         return;
+      }
+      mTimes[mSteps] = t;
+      for (i=0; i<states; ++i) {
+         mData[(size_t)i * mHeader.chunkSteps + mSteps] = x[i];
+      }
+      if (++mSteps == (int)mHeader.chunkSteps) { writeChunk(); }
+   }
+   
+   void TrajectoryWriter::writeChunk () {
+      int i, j, n = mSteps, states = mHeader.states;
+      size_t bytes = 0;
+      char *raw = &mBuffer[0];
+      traj_chunk_t chunk;
+      
+      // Pack the columns (only the filled part of each)
+      memcpy(raw, &mTimes[0], n * 8);
+      bytes = n * 8;
+      for (i=0; i<states; ++i) {
+         const double *col = &mData[(size_t)i * mHeader.chunkSteps];
+         if (mHeader.precision == TRAJ_FLOAT64) {
+            memcpy(raw + bytes, col, n * 8);
+         }
+         else {
+            float *out = (float *)(raw + bytes);
+            for (j=0; j<n; ++j) { out[j] = (float)col[j]; }
+         }
+         bytes += (size_t)n * mHeader.precision;
+      }
+      
+      const char *out = raw;
+      chunk.offset = mOut.tellp();
+      chunk.first = mHeader.steps;
+      chunk.steps = n;
+      chunk.compressed = 0;
+#ifdef HAVE_LIBZ
+      // Compress into a separate buffer, keeping the chunk raw if it does not get any smaller
+      if (mCompress) {
+         uLongf zBytes = mZipped.size();
+         if (compress2((Bytef *)&mZipped[0], &zBytes, (const Bytef *)raw, bytes, Z_DEFAULT_COMPRESSION) == Z_OK && 
+             zBytes < bytes) {
+            out = &mZipped[0];
+            bytes = zBytes;
+            chunk.compressed = 1;
+         }
+      }
+#endif
+      chunk.bytes = bytes;
+      mOut.write(out, bytes);
+      
+      // Pad to keep every chunk (and the index) aligned for direct access
+      static const char pad[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+      if (bytes % 8 != 0) { mOut.write(pad, 8 - (bytes % 8)); }
+      NE_PROFILE_COUNT(PROF_BYTES_LOGGED, (bytes + 7) & ~(size_t)7);
+      if (!mOut.good()) {
+         cerr << "Could not write chunk (TrajectoryWriter)" << endl;
+         mFailed = true;
+      }
+      
+      mIndex.push_back(chunk);
+      mHeader.steps += n;
+      mHeader.chunks++;
+      mSteps = 0;
+   }
+   
+   int TrajectoryWriter::close () {
+      if (!mOut.is_open()) { return 0; }
+      if (mSteps > 0 && !mFailed) { writeChunk(); }
+      mHeader.indexOffset = mOut.tellp();
+      if (!mIndex.empty()) {
+         mOut.write((const char *)&mIndex[0], mIndex.size() * sizeof(traj_chunk_t));
+      }
+      mOut.seekp(0);
+      mOut.write((const char *)&mHeader, sizeof(traj_header_t));
+      bool ok = mOut.good() && !mFailed;
+      mOut.close();
+      mIndex.clear();
+      if (!ok) {
+         cerr << "Error writing trajectory (TrajectoryWriter::close)" << endl;
+         return -1;
+      }
+      return 0;
+   }
+   
+   // ---------- TrajectoryReader ----------
+   
+   int TrajectoryReader::open (const string &filename) {
+      close();
+      if (mFile.open(filename) != 0) { return -1; }
+      if (mFile.size() < sizeof(traj_header_t)) {
+         cerr << "File too small to be a trajectory: " << filename << " (TrajectoryReader::open)" << endl;
+         close();
+         return -1;
+      }
+      memcpy(&mHeader, mFile.data(), sizeof(traj_header_t));
+      if (memcmp(mHeader.magic, TRAJ_MAGIC, 8) != 0 || mHeader.version != TRAJ_VERSION) {
+         cerr << "Not a trajectory file (or unknown version): " << filename << " (TrajectoryReader::open)" << endl;
+         close();
+         return -1;
+      }
+      if (mHeader.byteOrder != TRAJ_BYTE_ORDER) {
+         cerr << "Trajectory written with a different byte order: " << filename << " (TrajectoryReader::open)" << endl;
+         close();
+         return -1;
+      }
+      uint64_t size = mFile.size();
+      if (mHeader.indexOffset > size || mHeader.indexOffset % 8 != 0 || 
+          mHeader.chunks > (size - mHeader.indexOffset) / sizeof(traj_chunk_t)) {
+         cerr << "Trajectory file is truncated: " << filename << " (TrajectoryReader::open)" << endl;
+         close();
+         return -1;
+      }
+      mIndex = (const traj_chunk_t *)(mFile.data() + mHeader.indexOffset);
+      if (!validLayout(size)) {
+         cerr << "Trajectory file is corrupt: " << filename << " (TrajectoryReader::open)" << endl;
+         close();
+         return -1;
+      }
+      return 0;
+   }
+   
+   bool TrajectoryReader::validLayout (uint64_t size) {
+      const traj_header_t &h = mHeader;
+      if ((h.precision != TRAJ_FLOAT64 && h.precision != TRAJ_FLOAT32) || h.chunkSteps < 1 || 
+          h.states > INT32_MAX || h.steps > INT32_MAX) { 
+         return false; 
+      }
+      
+      // A full chunk must fit in memory (it bounds the cache used for compressed chunks)
+      uint64_t row = 8 + (uint64_t)h.states * h.precision, total = 0;
+      if (row > numeric_limits<size_t>::max() / h.chunkSteps) { return false; }
+      uint64_t chunkBytes = row * h.chunkSteps;
+      
+      // Every chunk but the last is full (chunkOf relies on this) and the chunks cover the steps
+      for (uint64_t k=0; k<h.chunks; ++k) {
+         const traj_chunk_t &c = mIndex[k];
+         bool lastChunk = (k + 1 == h.chunks);
+         if (c.steps < 1 || c.steps > h.chunkSteps || (!lastChunk && c.steps != h.chunkSteps) || 
+             c.first != total) { 
+            return false; 
+         }
+         total += c.steps;
+         
+         // The data must lie after the header and within the file (raw chunks aligned for direct 
+         // access and holding every value, compressed ones no more than zlib can expand to: 1032:1)
+         if (c.offset < sizeof(traj_header_t) || c.offset > size || c.bytes > size - c.offset) { 
+            return false; 
+         }
+         uint64_t raw = row * c.steps;
+         if (c.compressed ? (raw > chunkBytes || raw / 1032 > c.bytes) : 
+                            (c.offset % 8 != 0 || c.bytes != raw)) { 
+            return false; 
+         }
+      }
+      return total == h.steps;
+   }
+   
+   void TrajectoryReader::close () {
+      mFile.close();
+      memset(&mHeader, 0, sizeof(traj_header_t));
+      mIndex = NULL;
+      mCache.clear();
+      mCached = -1;
+   }
+   
+   const char * TrajectoryReader::chunkData (int chunk) {
+      if (chunk < 0 || (uint64_t)chunk >= mHeader.chunks) {
+         cerr << "Chunk out of range (TrajectoryReader)" << endl;
+         return NULL;
+      }
+      const traj_chunk_t &c = mIndex[chunk];
+      if (!c.compressed) { return mFile.data() + c.offset; }
+      if (mCached == chunk) { return &mCache[0]; }
+#ifdef HAVE_LIBZ
+      uLongf raw = (uLongf)c.steps * (8 + (uLongf)mHeader.states * mHeader.precision), bytes = raw;
+      mCache.resize(raw);
+      // A chunk that expands to less than the full size would leave part of the cache unset
+      if (uncompress((Bytef *)&mCache[0], &bytes, (const Bytef *)(mFile.data() + c.offset), c.bytes) == Z_OK && 
+          bytes == raw) {
+         mCached = chunk;
+         return &mCache[0];
+      }
+      cerr << "Could not decompress chunk (TrajectoryReader)" << endl;
+#else
+      cerr << "Trajectory is compressed but compression is not available (TrajectoryReader)" << endl;
+#endif
+      return NULL;
+   }
+   
+   const double * TrajectoryReader::column (int chunk, int stateID) {
+      if (mHeader.precision != TRAJ_FLOAT64) { 
+         cerr << "Trajectory is not stored as doubles (TrajectoryReader::column)" << endl;
+         return NULL; 
+      }
+      if (stateID < 0 || stateID >= (int)mHeader.states) {
+         cerr << "State out of range (TrajectoryReader::column)" << endl;
+         return NULL;
+      }
+      const char *data = chunkData(chunk);
+      if (data == NULL) { return NULL; }
+      return (const double *)(data + (size_t)mIndex[chunk].steps * (8 + (size_t)stateID * 8));
+   }
+   
+   const float * TrajectoryReader::columnFloat (int chunk, int stateID) {
+      if (mHeader.precision != TRAJ_FLOAT32) { 
+         cerr << "Trajectory is not stored as floats (TrajectoryReader::columnFloat)" << endl;
+         return NULL; 
+      }
+      if (stateID < 0 || stateID >= (int)mHeader.states) {
+         cerr << "State out of range (TrajectoryReader::columnFloat)" << endl;
+         return NULL;
+      }
+      const char *data = chunkData(chunk);
+      if (data == NULL) { return NULL; }
+      return (const float *)(data + (size_t)mIndex[chunk].steps * (8 + (size_t)stateID * 4));
+   }
+   
+   double TrajectoryReader::time (int step) {
+      if (step < 0 || step >= steps()) { return 0.0; }
+      int chunk = chunkOf(step);
+      const double *t = times(chunk);
+      return (t == NULL) ? 0.0 : t[step - mIndex[chunk].first];
+   }
+   
+   double TrajectoryReader::value (int step, int stateID) {
+      if (step < 0 || step >= steps()) { return 0.0; }
+      int chunk = chunkOf(step), i = step - chunkStart(chunk);
+      if (mHeader.precision == TRAJ_FLOAT64) {
+         const double *col = column(chunk, stateID);
+         return (col == NULL) ? 0.0 : col[i];
+      }
+      const float *col = columnFloat(chunk, stateID);
+      return (col == NULL) ? 0.0 : col[i];
+   }
+   
+   int TrajectoryReader::slice (int step, State &x) {
+      if (step < 0 || step >= steps()) {
+         cerr << "Observation out of range (TrajectoryReader::slice)" << endl;
+         return -1;
+      }
+      int chunk = chunkOf(step), i = step - chunkStart(chunk), n = chunkSteps(chunk), s;
+      const char *data = chunkData(chunk);
+      if (data == NULL) { return -1; }
+      x.resize(mHeader.states);
+      if (mHeader.precision == TRAJ_FLOAT64) {
+         const double *cols = (const double *)(data + (size_t)n * 8);
+         for (s=0; s<(int)mHeader.states; ++s) { x[s] = cols[(size_t)s * n + i]; }
+      }
+      else {
+         const float *cols = (const float *)(data + (size_t)n * 8);
+         for (s=0; s<(int)mHeader.states; ++s) { x[s] = cols[(size_t)s * n + i]; }
+      }
+      return 0;
+   }
+   
+} // netevo namespace
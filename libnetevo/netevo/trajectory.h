@@ -0,0 +1,156 @@
+/*===========================================================================
+ NetEvo Library
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ---------------------------------------------------------------------------- 
+ NetEvo is a computing framework designed to allow researchers to investigate 
+ evolutionary aspects of dynamical complex networks. By providing tools to 
+ easily integrate each of these factors in a coherent way, it is hoped a 
+ greater understanding can be gained of key attributes and features displayed 
+ by complex systems.
+ 
+ NetEvo is open-source software released under the Open Source Initiative 
+ (OSI) approved Non-Profit Open Software License ("Non-Profit OSL") 3.0. 
+ Detailed information about this licence can be found in the COPYING file 
+ included as part of the source distribution.
+ 
+ This library is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ ============================================================================*/
+
+#ifndef NE_TRAJECTORY_H
+#define NE_TRAJECTORY_H
+
+#include "system.h"
+#include "simulate.h"
+#include "mapped_file.h"
+#include <stdint.h>
+
+using namespace std;
+
+namespace netevo {
+   
+   /** Precision of the states stored in a trajectory file (times are always stored as doubles). */
+   enum traj_precision_e {
+      TRAJ_FLOAT64 = 8, /** 8 byte doubles */
+      TRAJ_FLOAT32 = 4  /** 4 byte floats */
+   };
+   
+   /** Header at the start of a trajectory file. The file is a header followed by chunks of up to 
+    *  chunkSteps observations and an index of the chunks (at indexOffset). Each chunk is stored 
+    *  by column: the times of its observations followed by the values of each state in turn (in 
+    *  state ID order), so the values of one state over a chunk are contiguous. A chunk may be 
+    *  compressed with zlib. Values are written in the byte order of the machine, which is 
+    *  recorded so that a mismatch can be detected. */
+   typedef struct {
+      char     magic[8];
+      uint32_t byteOrder;
+      uint32_t version;
+      uint32_t precision;
+      uint32_t states;
+      uint32_t chunkSteps;
+      uint32_t flags;
+      uint64_t steps;
+      uint64_t chunks;
+      uint64_t indexOffset;
+   } traj_header_t;
+   
+   /** Entry for a chunk in the trajectory file index. */
+   typedef struct {
+      uint64_t offset;
+      uint64_t bytes;
+      uint64_t first;
+      uint32_t steps;
+      uint32_t compressed;
+   } traj_chunk_t;
+   
+   /** Observer that writes a trajectory to a binary file (see traj_header_t). Observations are 
+    *  gathered into a preallocated chunk that is written when full, so nothing is allocated 
+    *  while observing. The file is complete once close is called (or the writer destroyed). */
+   class TrajectoryWriter : public SimObserver {
+   private:
+      ofstream             mOut;
+      traj_header_t        mHeader;
+      vector<traj_chunk_t> mIndex;
+      vector<double>       mTimes;
+      vector<double>       mData;
+      vector<char>         mBuffer;
+      vector<char>         mZipped;
+      bool                 mCompress;
+      int                  mSteps;
+      bool                 mFailed;
+      
+      void writeChunk ();
+      
+   public:
+      TrajectoryWriter () : mCompress(false), mSteps(0), mFailed(false) { }
+      ~TrajectoryWriter () { close(); }
+      
+      /** Create a file for a trajectory with the given number of states. If compress is set each 
+       *  chunk is compressed (only possible when built with zlib, otherwise chunks are stored 
+       *  uncompressed). Returns 0 if successful, -1 otherwise. */
+      int open (const string &filename, int states, traj_precision_e precision = TRAJ_FLOAT64, 
+                int chunkSteps = 1024, bool compress = false);
+      /** Write any remaining observations and the index. Returns 0 if successful, -1 otherwise. */
+      int close ();
+      
+      void operator() (const State &x, double t);
+   };
+   
+   /** Reader for trajectory files written by TrajectoryWriter. The file is memory mapped so that 
+    *  for uncompressed chunks the time and state columns are read with no copying. Compressed 
+    *  chunks are expanded into a buffer (the most recently used chunk is kept). */
+   class TrajectoryReader {
+   private:
+      MappedFile           mFile;
+      traj_header_t        mHeader;
+      const traj_chunk_t  *mIndex;
+      vector<char>         mCache;
+      int                  mCached;
+      
+      const char * chunkData (int chunk);
+      /** Check the header and every index entry against the size of the file */
+      bool validLayout (uint64_t size);
+      
+   public:
+      TrajectoryReader () { close(); }
+      
+      /** Open a trajectory file. Returns 0 if successful, -1 otherwise. */
+      int open (const string &filename);
+      void close ();
+      
+      /** Number of observations. */
+      int steps () { return mHeader.steps; }
+      /** Number of states in each observation. */
+      int states () { return mHeader.states; }
+      /** Precision of the stored states. */
+      traj_precision_e precision () { return (traj_precision_e)mHeader.precision; }
+      /** Number of chunks. */
+      int chunks () { return mHeader.chunks; }
+      /** Chunk holding an observation. */
+      int chunkOf (int step) { return step / mHeader.chunkSteps; }
+      /** First observation in a chunk. */
+      int chunkStart (int chunk) { return mIndex[chunk].first; }
+      /** Number of observations in a chunk. */
+      int chunkSteps (int chunk) { return mIndex[chunk].steps; }
+      
+      /** Times of the observations in a chunk. */
+      const double * times (int chunk) { return (const double *)chunkData(chunk); }
+      /** Values of a state (by state ID, see System::stateID) over a chunk (TRAJ_FLOAT64 only). */
+      const double * column (int chunk, int stateID);
+      /** Values of a state (by state ID, see System::stateID) over a chunk (TRAJ_FLOAT32 only). */
+      const float * columnFloat (int chunk, int stateID);
+      
+      /** Time of an observation. */
+      double time (int step);
+      /** Value of a state (by state ID) at an observation. */
+      double value (int step, int stateID);
+      /** Copy all of the states at an observation into x (resized if necessary). Returns 0 if 
+       *  successful, -1 otherwise. */
+      int slice (int step, State &x);
+   };
+   
+} // netevo namespace
+
+#endif // NE_TRAJECTORY_H
@@ -0,0 +1,40 @@
+/*===========================================================================
+ NetEvo Tests
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ Minimal checks shared by the tests run by "make check". A test reports each
+ failed check and returns the number of failures from main, so any failure
+ gives a non-zero exit status.
+ ============================================================================*/
+
+#ifndef NE_TESTS_CHECK_H
+#define NE_TESTS_CHECK_H
+
+#include <iostream>
+#include <cmath>
+
+static int neCheckFailures = 0;
+
+/** Report a failure (with its location) if cond is false */
+#define NE_CHECK(cond) \
+   do { \
+      if (!(cond)) { \
+         std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+         neCheckFailures++; \
+      } \
+   } while (0)
+
+/** Report a failure if a and b differ by more than tol (relative to the larger of 1, |a| and |b|) */
+#define NE_CHECK_CLOSE(a, b, tol) \
+   do { \
+      double neA = (a), neB = (b); \
+      double neScale = std::fmax(1.0, std::fmax(std::fabs(neA), std::fabs(neB))); \
+      if (!(std::fabs(neA - neB) <= (tol) * neScale)) { \
+         std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #a " = " << neA \
+                   << ", " #b " = " << neB << std::endl; \
+         neCheckFailures++; \
+      } \
+   } while (0)
+
+#endif // NE_TESTS_CHECK_H
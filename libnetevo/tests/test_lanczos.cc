@@ -0,0 +1,63 @@
+/*===========================================================================
+ NetEvo Tests
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ LanczosSolver: the extreme eigenvalues of the Laplacian of a network and of
+ its adjacency matrix with a random diagonal (large enough that the basis must
+ be restarted) must match those found by Eigen's dense symmetric
+ eigensolver, and each Ritz vector returned must be an eigenvector.
+ ============================================================================*/
+
+#include <netevo.h>
+#include "check.h"
+
+using namespace lemon;
+using namespace netevo;
+using namespace std;
+
+static void checkExtreme (const SparseMatrixXd &A, int k, bool largest) {
+   MatrixXd dense = MatrixXd(A);
+   SelfAdjointEigenSolver<MatrixXd> exact(dense, EigenvaluesOnly);
+   const VectorXd &all = exact.eigenvalues(); // Ascending
+   int n = all.size();
+   double norm = max(fabs(all(0)), fabs(all(n-1)));
+
+   LanczosSolver solver;
+   NE_CHECK(solver.compute(A, k, largest) == 0);
+   NE_CHECK(solver.converged());
+   const VectorXd &values = solver.eigenvalues();
+   const MatrixXd &vectors = solver.eigenvectors();
+   NE_CHECK(values.size() == k);
+   NE_CHECK(vectors.cols() >= k && vectors.rows() == n);
+   if (values.size() != k || vectors.cols() < k || vectors.rows() != n) { return; }
+
+   for (int i=0; i<k; ++i) {
+      // From the wanted end of the spectrum inwards
+      double expected = largest ? all(n-1-i) : all(i);
+      NE_CHECK_CLOSE(values(i), expected, 1e-8 * norm);
+      VectorXd v = vectors.col(i);
+      NE_CHECK_CLOSE(v.norm(), 1.0, 1e-8);
+      NE_CHECK((A * v - values(i) * v).norm() <= 1e-6 * norm);
+   }
+}
+
+int main () {
+   System sys;
+   sys.seedRnd(1);
+   sys.smallWorldGraph(400, 3, 0.1, true);
+
+   SparseMatrixXd L, A;
+   sys.sparseLaplacian(L);
+   sys.sparseAdjacency(A);
+
+   // Random self terms split any repeated eigenvalues of the adjacency matrix
+   for (int i=0; i<A.rows(); ++i) { A.coeffRef(i, i) = sys.rnd(); }
+
+   checkExtreme(L, 4, true);
+   checkExtreme(L, 4, false);
+   checkExtreme(A, 4, true);
+   checkExtreme(A, 4, false);
+
+   return neCheckFailures;
+}
@@ -0,0 +1,89 @@
+/*===========================================================================
+ NetEvo Tests
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ Listeners (see System::attach): bulk operations that replace a System
+ (copySystem, copyDigraph, clear, openBinary and the graph generators) must
+ send no events, and a SystemHash reset after them must stay consistent with
+ a hash calculated from scratch as the System is then changed.
+ ============================================================================*/
+
+#include <netevo.h>
+#include "check.h"
+
+using namespace lemon;
+using namespace netevo;
+using namespace std;
+
+/** Counts every event it is sent */
+class CountingListener : public ChangeLog {
+public:
+   int events;
+   CountingListener () : events(0) { }
+   void addNode (System &sys, Node n) { events++; }
+   void addArc  (System &sys, Node source, Node target) { events++; }
+   void erase   (System &sys, Node n) { events++; }
+   void erase   (System &sys, Arc e) { events++; }
+   void update  (System &sys, Node n) { events++; }
+   void update  (System &sys, Arc e) { events++; }
+};
+
+int main () {
+   KuramotoOscillator kuramoto;
+
+   System from;
+   from.addNodeDynamic(&kuramoto);
+   from.seedRnd(1);
+   from.smallWorldGraph(30, 2, 0.1, "KuramotoOscillator", "NoArcDynamic", true);
+
+   System sys;
+   sys.addNodeDynamic(&kuramoto);
+   sys.seedRnd(2);
+   sys.smallWorldGraph(20, 2, 0.3, "KuramotoOscillator", "NoArcDynamic", true);
+
+   CountingListener count;
+   sys.attach(&count);
+   SystemHash hash;
+   hash.reset(&sys);
+   NE_CHECK(hash.value() == SystemHash::hash(sys));
+
+   // A copy sends no events (not even for the nodes and arcs it adds)
+   sys.copySystem(from);
+   NE_CHECK(count.events == 0);
+   hash.reset(&sys);
+   NE_CHECK(hash.value() == SystemHash::hash(sys));
+   NE_CHECK(hash.value() == SystemHash::hash(from));
+
+   // Both listeners are still attached and follow later changes
+   Node u = sys.addNode("KuramotoOscillator");
+   Arc e = sys.addArc(sys.getNode(0), u);
+   NE_CHECK(count.events == 2);
+   NE_CHECK(hash.value() == SystemHash::hash(sys));
+   sys.recordUpdate(u);
+   sys.nodeData(u).dynamicParams[0] = 3.0;
+   sys.recordUpdate(e);
+   sys.arcData(e).weight = 0.5;
+   NE_CHECK(count.events == 4);
+   NE_CHECK(hash.value() == SystemHash::hash(sys));
+   sys.erase(u);
+   NE_CHECK(count.events == 6);
+   NE_CHECK(hash.value() == SystemHash::hash(sys));
+   NE_CHECK(hash.value() == SystemHash::hash(from));
+
+   // Nor do any of the other bulk operations
+   count.events = 0;
+   sys.clear();
+   sys.copyDigraph(from);
+   sys.smallWorldGraph(25, 2, 0.2, "KuramotoOscillator", "NoArcDynamic", true);
+   vector<char> buffer;
+   from.saveBinary(buffer);
+   NE_CHECK(sys.openBinary(&buffer[0], buffer.size()) == 0);
+   NE_CHECK(count.events == 0);
+   hash.reset(&sys);
+   NE_CHECK(hash.value() == SystemHash::hash(from));
+
+   hash.reset(NULL);
+   sys.detach(&count);
+   return neCheckFailures;
+}
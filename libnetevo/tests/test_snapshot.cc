@@ -0,0 +1,113 @@
+/*===========================================================================
+ NetEvo Tests
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ Binary snapshots (see System::saveBinary): a System is saved and opened
+ again (from memory and from a file) and every node and arc must come back
+ with the same ID, key, data and dynamics. Truncated snapshots and snapshots
+ that repeat an arc ID must be rejected.
+ ============================================================================*/
+
+#include <netevo.h>
+#include "check.h"
+
+using namespace lemon;
+using namespace netevo;
+using namespace std;
+
+/** Compare every node and arc of two Systems by ID */
+static void checkSame (System &a, System &b) {
+   NE_CHECK(a.nodeCount() == b.nodeCount());
+   NE_CHECK(a.arcCount() == b.arcCount());
+   if (a.nodeCount() != b.nodeCount() || a.arcCount() != b.arcCount()) { return; }
+
+   for (int i=0; i<a.nodeCount(); ++i) {
+      NodeData &x = a.nodeData(a.getNode(i));
+      NodeData &y = b.nodeData(b.getNode(i));
+      NE_CHECK(x.key == y.key);
+      NE_CHECK(x.name == y.name);
+      NE_CHECK(x.position.x == y.position.x && x.position.y == y.position.y && x.position.z == y.position.z);
+      NE_CHECK(x.properties == y.properties);
+      NE_CHECK(x.dynamicParams == y.dynamicParams);
+      NE_CHECK(x.dynamic->getName() == y.dynamic->getName());
+   }
+   for (int i=0; i<a.arcCount(); ++i) {
+      Arc e = a.getArc(i), f = b.getArc(i);
+      NE_CHECK(a.nodeID(a.source(e)) == b.nodeID(b.source(f)));
+      NE_CHECK(a.nodeID(a.target(e)) == b.nodeID(b.target(f)));
+      ArcData &x = a.arcData(e);
+      ArcData &y = b.arcData(f);
+      NE_CHECK(x.name == y.name);
+      NE_CHECK(x.weight == y.weight);
+      NE_CHECK(x.properties == y.properties);
+      NE_CHECK(x.dynamicParams == y.dynamicParams);
+      NE_CHECK(x.dynamic->getName() == y.dynamic->getName());
+   }
+}
+
+int main () {
+   KuramotoOscillator kuramoto;
+
+   // Directed topology with data in every field of the snapshot
+   System sys;
+   sys.addNodeDynamic(&kuramoto);
+   sys.seedRnd(1);
+   sys.smallWorldGraph(60, 2, 0.2, "KuramotoOscillator", "NoArcDynamic", false);
+   for (System::NodeIt v(sys); v != INVALID; ++v) {
+      NodeData &d = sys.nodeData(v);
+      d.name = (d.key % 3 == 0) ? "" : "node" + to_string(d.key % 7);
+      d.position.x = d.key * 0.5;
+      d.position.y = -d.key;
+      d.position.z = 1.0 / (d.key + 1);
+      for (int k=0; k<d.key % 3; ++k) { d.properties.push_back(d.key + 0.25 * k); }
+      d.dynamicParams[0] = sys.rnd();
+   }
+   int count = 0;
+   for (System::ArcIt e(sys); e != INVALID; ++e, ++count) {
+      ArcData &d = sys.arcData(e);
+      d.weight = sys.rnd();
+      d.name = (count % 2 == 0) ? "arc" : "";
+      if (count % 4 == 0) { d.properties.push_back(count); }
+      if (count % 5 == 0) { d.dynamicParams.push_back(-count); }
+   }
+
+   // Erasing a node leaves a gap in the keys and renumbers the IDs
+   sys.erase(sys.getNode(10));
+   sys.refreshStateIDs();
+
+   // Round trip in memory
+   vector<char> buffer;
+   sys.saveBinary(buffer);
+   NE_CHECK(!buffer.empty());
+   System copy;
+   copy.addNodeDynamic(&kuramoto);
+   NE_CHECK(copy.openBinary(&buffer[0], buffer.size()) == 0);
+   checkSame(sys, copy);
+
+   // Round trip through a file
+   NE_CHECK(sys.saveBinary("test_snapshot.bin") == 0);
+   System fromFile;
+   fromFile.addNodeDynamic(&kuramoto);
+   NE_CHECK(fromFile.openBinary("test_snapshot.bin") == 0);
+   checkSame(sys, fromFile);
+
+   // Truncated snapshots are rejected
+   System bad;
+   size_t sizes[] = { 0, 16, buffer.size() / 2, buffer.size() - 8 };
+   for (int i=0; i<4; ++i) {
+      NE_CHECK(bad.openBinary(&buffer[0], sizes[i]) == 2);
+   }
+
+   // An arc ID repeated in the out arcs (leaving another ID with no end points) is rejected
+   vector<char> repeated(buffer);
+   snapshot_header_t *h = (snapshot_header_t *)&repeated[0];
+   NE_CHECK(h->arcs >= 2);
+   if (h->arcs >= 2) {
+      uint32_t *outArc = (uint32_t *)&repeated[h->offset[SNAP_OUT_ARC]];
+      outArc[1] = outArc[0];
+      NE_CHECK(bad.openBinary(&repeated[0], repeated.size()) == 2);
+   }
+
+   return neCheckFailures;
+}
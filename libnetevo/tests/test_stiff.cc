@@ -0,0 +1,101 @@
+/*===========================================================================
+ NetEvo Tests
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ SimulateOdeStiff: trajectories of a network of nonlinear oscillators, with
+ an analytic and with a finite difference Jacobian, and of a stiff linear
+ network must match those of SimulateOdeAdaptive (run at a much tighter
+ tolerance) and be observed at every output step.
+ ============================================================================*/
+
+#include <netevo.h>
+#include "check.h"
+
+using namespace lemon;
+using namespace netevo;
+using namespace std;
+
+/** Kuramoto oscillator without a Jacobian (so SparseJacobian uses finite differences) */
+class KuramotoNoJacobian : public KuramotoOscillator {
+public:
+   string getName     () { return "KuramotoNoJacobian"; }
+   bool   hasBatch    () { return false; }
+   bool   hasEnsemble () { return false; }
+   bool   hasJacobian () { return false; }
+};
+
+/** Keeps the times observed */
+class TimesObserver : public SimObserver {
+public:
+   vector<double> times;
+   void operator() (const State &x, double t) { times.push_back(t); }
+};
+
+static void checkAgainstAdaptive (System &sys, const State &initial, double tMax, double outputStep,
+                                  bool analytic) {
+   ChangeLog logger;
+
+   State stiffX(initial);
+   TimesObserver obs;
+   SimulateOdeStiff stiff(ROSENBROCK_23, 1e-8, 1e-8, outputStep);
+   stiff.simulate(sys, tMax, stiffX, obs, logger);
+   NE_CHECK(stiff.jacobian().analytic() == analytic);
+   NE_CHECK(stiff.steps() > 0);
+
+   State exactX(initial);
+   SimObserver none;
+   SimulateOdeAdaptive adaptive(RK_DOPRI_5, 1e-12, 1e-12, outputStep / 100.0);
+   adaptive.simulate(sys, tMax, exactX, none, logger);
+
+   double scale = 0.0, error = 0.0;
+   for (int i=0; i<(int)initial.size(); ++i) {
+      scale = max(scale, fabs(exactX[i]));
+      error = max(error, fabs(stiffX[i] - exactX[i]));
+   }
+   NE_CHECK(error <= 1e-4 * max(scale, 1.0));
+
+   // The initial state and every output step are observed
+   int outputs = (int)floor(tMax / outputStep + 1e-9);
+   NE_CHECK((int)obs.times.size() == outputs + 1);
+   for (int k=0; k<(int)obs.times.size(); ++k) {
+      NE_CHECK_CLOSE(obs.times[k], k * outputStep, 1e-12);
+   }
+}
+
+int main () {
+   KuramotoOscillator kuramoto;
+   KuramotoNoJacobian kuramotoFD;
+   DiffusiveCoupling diffusive;
+
+   // Nonlinear oscillators with a spread of natural frequencies
+   for (int fd=0; fd<2; ++fd) {
+      System sys;
+      sys.addNodeDynamic(&kuramoto);
+      sys.addNodeDynamic(&kuramotoFD);
+      sys.seedRnd(1);
+      sys.smallWorldGraph(40, 2, 0.1, fd ? "KuramotoNoJacobian" : "KuramotoOscillator", "NoArcDynamic", true);
+      State initial(sys.totalStates());
+      for (System::NodeIt v(sys); v != INVALID; ++v) {
+         sys.nodeData(v).dynamicParams[0] = sys.rnd();
+         sys.nodeData(v).dynamicParams[1] = 0.5;
+         initial[sys.stateID(v)] = 2.0 * M_PI * sys.rnd();
+      }
+      checkAgainstAdaptive(sys, initial, 2.0, 0.1, fd == 0);
+   }
+
+   // Consensus with fast decay at some nodes (time scales differ by 10^3)
+   System sys;
+   sys.addNodeDynamic(&diffusive);
+   sys.seedRnd(2);
+   sys.smallWorldGraph(40, 2, 0.1, "DiffusiveCoupling", "NoArcDynamic", true);
+   State initial(sys.totalStates());
+   for (System::NodeIt v(sys); v != INVALID; ++v) {
+      sys.nodeData(v).dynamicParams[0] = (sys.nodeData(v).key % 5 == 0) ? -1000.0 : 0.0;
+      sys.nodeData(v).dynamicParams[1] = 1.0;
+      initial[sys.stateID(v)] = sys.rnd() - 0.5;
+   }
+   checkAgainstAdaptive(sys, initial, 1.0, 0.05, true);
+
+   return neCheckFailures;
+}
@@ -0,0 +1,146 @@
+/*===========================================================================
+ NetEvo Tests
+ Copyright (C) 2011 Thomas E. Gorochowski <tgorochowski@me.com>
+ Bristol Centre for Complexity Sciences, University of Bristol, Bristol, UK
+ ----------------------------------------------------------------------------
+ Trajectory files (see TrajectoryWriter and TrajectoryReader): observations
+ written in each precision, with and without compression, must be read back
+ by step, by chunk and by column. Truncated files, files with a corrupt
+ index and compressed chunks too small for their steps must be rejected.
+ ============================================================================*/
+
+#include <netevo.h>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include "check.h"
+
+using namespace lemon;
+using namespace netevo;
+using namespace std;
+
+static const int STATES = 5;
+static const int STEPS = 30;
+static const int CHUNK = 7;
+
+static double stateValue (int step, int id) { return step * 0.1 + id * 1.5 - 2.0; }
+static double stepTime (int step) { return step * 0.25; }
+
+/** Write a trajectory of STEPS observations */
+static int writeTrajectory (const string &filename, traj_precision_e precision, bool compress) {
+   TrajectoryWriter writer;
+   if (writer.open(filename, STATES, precision, CHUNK, compress) != 0) { return -1; }
+   State x(STATES);
+   for (int s=0; s<STEPS; ++s) {
+      for (int i=0; i<STATES; ++i) { x[i] = stateValue(s, i); }
+      writer(x, stepTime(s));
+   }
+   return writer.close();
+}
+
+static void checkRoundTrip (traj_precision_e precision, bool compress) {
+   string filename = "test_trajectory.ntj";
+   NE_CHECK(writeTrajectory(filename, precision, compress) == 0);
+
+   TrajectoryReader reader;
+   NE_CHECK(reader.open(filename) == 0);
+   NE_CHECK(reader.steps() == STEPS);
+   NE_CHECK(reader.states() == STATES);
+   NE_CHECK(reader.precision() == precision);
+   NE_CHECK(reader.chunks() == (STEPS + CHUNK - 1) / CHUNK);
+   if (reader.steps() != STEPS || reader.states() != STATES) { return; }
+
+   // Values are only exact to the precision stored
+   double tol = (precision == TRAJ_FLOAT32) ? 1e-6 : 0.0;
+
+   // By step
+   State x;
+   for (int s=0; s<STEPS; ++s) {
+      NE_CHECK(reader.time(s) == stepTime(s));
+      NE_CHECK(reader.slice(s, x) == 0);
+      NE_CHECK((int)x.size() == STATES);
+      for (int i=0; i<STATES && i<(int)x.size(); ++i) {
+         NE_CHECK_CLOSE(reader.value(s, i), stateValue(s, i), tol);
+         NE_CHECK_CLOSE(x[i], stateValue(s, i), tol);
+      }
+   }
+
+   // By chunk and column
+   int total = 0;
+   for (int c=0; c<reader.chunks(); ++c) {
+      int first = reader.chunkStart(c), steps = reader.chunkSteps(c);
+      NE_CHECK(first == total);
+      NE_CHECK(reader.chunkOf(first) == c);
+      const double *t = reader.times(c);
+      NE_CHECK(t != NULL);
+      for (int i=0; i<STATES; ++i) {
+         const double *col = (precision == TRAJ_FLOAT64) ? reader.column(c, i) : NULL;
+         const float *colFloat = (precision == TRAJ_FLOAT32) ? reader.columnFloat(c, i) : NULL;
+         NE_CHECK(col != NULL || colFloat != NULL);
+         for (int k=0; k<steps; ++k) {
+            if (i == 0 && t != NULL) { NE_CHECK(t[k] == stepTime(first + k)); }
+            if (col != NULL) { NE_CHECK(col[k] == stateValue(first + k, i)); }
+            if (colFloat != NULL) { NE_CHECK_CLOSE(colFloat[k], stateValue(first + k, i), tol); }
+         }
+      }
+      total += steps;
+   }
+   NE_CHECK(total == STEPS);
+   reader.close();
+}
+
+/** Write a copy of a file changed by edit and check that it can not be opened */
+template <class Edit>
+static void checkRejected (const vector<char> &file, Edit edit) {
+   vector<char> bad(file);
+   edit(bad);
+   string filename = "test_trajectory_bad.ntj";
+   ofstream out(filename.c_str(), ios::binary | ios::trunc);
+   if (!bad.empty()) { out.write(&bad[0], bad.size()); }
+   out.close();
+   TrajectoryReader reader;
+   NE_CHECK(reader.open(filename) == -1);
+}
+
+int main () {
+   checkRoundTrip(TRAJ_FLOAT64, false);
+   checkRoundTrip(TRAJ_FLOAT32, false);
+   // Chunks are stored uncompressed when built without zlib, which must read back the same
+   checkRoundTrip(TRAJ_FLOAT64, true);
+   checkRoundTrip(TRAJ_FLOAT32, true);
+
+   // Corrupt files
+   NE_CHECK(writeTrajectory("test_trajectory.ntj", TRAJ_FLOAT64, false) == 0);
+   ifstream in("test_trajectory.ntj", ios::binary);
+   vector<char> file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+   in.close();
+   NE_CHECK(file.size() > sizeof(traj_header_t));
+   if (file.size() <= sizeof(traj_header_t)) { return neCheckFailures; }
+   traj_header_t h;
+   memcpy(&h, &file[0], sizeof(traj_header_t));
+
+   // Truncated (the index is at the end of the file)
+   checkRejected(file, [] (vector<char> &f) { f.resize(f.size() - 1); });
+   checkRejected(file, [] (vector<char> &f) { f.resize(sizeof(traj_header_t) / 2); });
+   // Index outside the file
+   checkRejected(file, [] (vector<char> &f) { ((traj_header_t *)&f[0])->indexOffset = ~(uint64_t)0; });
+   // More chunks than the index holds
+   checkRejected(file, [] (vector<char> &f) { ((traj_header_t *)&f[0])->chunks = (uint64_t)1 << 61; });
+   // More steps than the chunks hold
+   checkRejected(file, [] (vector<char> &f) { ((traj_header_t *)&f[0])->steps += 1; });
+   // Chunk data outside the file
+   checkRejected(file, [&h] (vector<char> &f) {
+      ((traj_chunk_t *)&f[h.indexOffset])[1].offset = f.size();
+   });
+   // Chunk smaller than its steps need
+   checkRejected(file, [&h] (vector<char> &f) {
+      ((traj_chunk_t *)&f[h.indexOffset])[0].bytes -= 8;
+   });
+   // Compressed chunks that would have to expand by far more than zlib can
+   checkRejected(file, [&h] (vector<char> &f) {
+      ((traj_header_t *)&f[0])->states = INT32_MAX;
+      for (uint64_t k=0; k<h.chunks; ++k) { ((traj_chunk_t *)&f[h.indexOffset])[k].compressed = 1; }
+   });
+
+   return neCheckFailures;
+}